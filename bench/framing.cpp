@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "RCP_Target/framing.h"
+
+// Byte streams for the framing benchmarks: typical telemetry, which has a few zeros, and worst cases either way
+static std::vector<uint8_t> makePacket(size_t length, int zeroEvery) {
+    std::vector<uint8_t> packet(length);
+    uint32_t seed = 12345;
+    for(size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        packet[i] = zeroEvery != 0 && i % zeroEvery == 0 ? 0 : (seed >> 16) | 1;
+    }
+    return packet;
+}
+
+// range(0) is the packet length, range(1) puts a zero every that many bytes (0 for none)
+static void BM_CobsEncode(benchmark::State& state) {
+    std::vector<uint8_t> packet = makePacket(state.range(0), state.range(1));
+    std::vector<uint8_t> frame(RCP::cobsEncodedSize(packet.size()));
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(RCP::cobsEncode(packet.data(), packet.size(), frame.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * packet.size()));
+}
+BENCHMARK(BM_CobsEncode)->Args({11, 8})->Args({23, 8})->Args({65, 8})->Args({65, 0})->Args({65, 1})->Args({4096, 64});
+
+// Decodes a stream of 64 frames of range(0) bytes, fed in chunks of range(1) bytes as a UART driver would hand them
+static void BM_CobsDecode(benchmark::State& state) {
+    std::vector<uint8_t> packet = makePacket(state.range(0), 8);
+    std::vector<uint8_t> stream;
+    for(int i = 0; i < 64; i++) {
+        std::vector<uint8_t> frame(RCP::cobsEncodedSize(packet.size()));
+        frame.resize(RCP::cobsEncode(packet.data(), packet.size(), frame.data()));
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    static RCP::CobsDecoder<4096> decoder;
+    size_t chunk = state.range(1);
+    size_t decoded = 0;
+    for(auto _ : state) {
+        for(size_t i = 0; i < stream.size(); i += chunk) {
+            size_t count = stream.size() - i < chunk ? stream.size() - i : chunk;
+            decoder.decode(stream.data() + i, count, [&decoded](const uint8_t*, size_t length) {
+                decoded += length;
+                return true;
+            });
+        }
+    }
+
+    benchmark::DoNotOptimize(decoded);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stream.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 64));
+}
+BENCHMARK(BM_CobsDecode)->Args({11, 1})->Args({11, 20})->Args({65, 1})->Args({65, 20})->Args({65, 256})
+        ->Args({4096, 256});
@@ -0,0 +1,38 @@
+#include "hooks.h"
+
+#include "RCP_Target/RCP_Target.h"
+
+namespace Bench {
+    size_t bytesWritten = 0;
+    uint32_t time = 0;
+
+    static const uint8_t* input = nullptr;
+    static size_t inputLength = 0;
+    static size_t inputPos = 0;
+    static size_t available = 0;
+
+    void setInput(const uint8_t* pattern, size_t length) {
+        input = pattern;
+        inputLength = length;
+        inputPos = 0;
+        available = 0;
+    }
+
+    void feed(size_t bytes) { available += bytes; }
+} // namespace Bench
+
+namespace RCP {
+    void write([[maybe_unused]] const void* data, uint8_t length) { Bench::bytesWritten += length; }
+
+    uint8_t readAvail() { return Bench::available > 255 ? 255 : Bench::available; }
+
+    uint8_t read() {
+        if(Bench::available == 0 || Bench::inputLength == 0) return 0;
+        Bench::available--;
+        uint8_t val = Bench::input[Bench::inputPos++];
+        if(Bench::inputPos == Bench::inputLength) Bench::inputPos = 0;
+        return val;
+    }
+
+    uint32_t systime() { return Bench::time; }
+} // namespace RCP
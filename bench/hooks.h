@@ -0,0 +1,17 @@
+#ifndef BENCH_HOOKS_H
+#define BENCH_HOOKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// RCP hooks for the benchmarks. Written bytes are counted and thrown away, and read() replays a byte pattern.
+namespace Bench {
+    extern size_t bytesWritten;
+    extern uint32_t time;
+
+    // read() returns pattern over and over, readAvail() reports up to available bytes
+    void setInput(const uint8_t* pattern, size_t length);
+    void feed(size_t available);
+} // namespace Bench
+
+#endif // BENCH_HOOKS_H
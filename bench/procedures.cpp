@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include <type_traits>
+#include <utility>
+
+#include "RCP_Target/procedures.h"
+
+// Never finishes, so every tick reaches all the leaves a node would run
+class Spin : public Test::Procedure {
+public:
+    unsigned long ticks = 0;
+
+    void execute() override { ticks++; }
+    bool isFinished() override { return false; }
+};
+
+// Builds a tree of Node with WIDTH children per node, depth levels deep, with Spin leaves
+template<typename Node, size_t WIDTH>
+static Test::Procedure* makeTree(int depth);
+
+template<typename Node, size_t... I>
+static Test::Procedure* makeNode(std::index_sequence<I...>, int depth) {
+    constexpr size_t WIDTH = sizeof...(I);
+    if constexpr(std::is_same_v<Node, Test::ParallelDeadlineProcedure>) {
+        return new Node(makeTree<Node, WIDTH>(depth - 1), ((void) I, makeTree<Node, WIDTH>(depth - 1))...);
+    }
+    else {
+        return new Node(((void) I, makeTree<Node, WIDTH>(depth - 1))...);
+    }
+}
+
+template<typename Node, size_t WIDTH>
+static Test::Procedure* makeTree(int depth) {
+    if(depth == 0) return new Spin();
+    return makeNode<Node>(std::make_index_sequence<WIDTH>(), depth);
+}
+
+// Cost of one execute() of the root. range(0) is the depth of the tree.
+template<typename Node, size_t WIDTH>
+static void BM_ProcedureTick(benchmark::State& state) {
+    Test::Procedure* root = makeTree<Node, WIDTH>(static_cast<int>(state.range(0)));
+    root->initialize();
+
+    for(auto _ : state) {
+        root->execute();
+        benchmark::ClobberMemory();
+    }
+
+    root->end(true);
+    delete root;
+    state.SetItemsProcessed(state.iterations());
+}
+
+#define PROCEDURE_BENCHMARKS(NODE)                                                                                     \
+    BENCHMARK(BM_ProcedureTick<Test::NODE, 2>)->DenseRange(1, 4);                                                      \
+    BENCHMARK(BM_ProcedureTick<Test::NODE, 4>)->DenseRange(1, 3);                                                      \
+    BENCHMARK(BM_ProcedureTick<Test::NODE, 8>)->DenseRange(1, 2)
+
+PROCEDURE_BENCHMARKS(SequentialProcedure);
+PROCEDURE_BENCHMARKS(ParallelProcedure);
+PROCEDURE_BENCHMARKS(ParallelDeadlineProcedure);
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include "hooks.h"
+
+#include "RCP_Target/RCP_Target.h"
+
+// Packet mixes for the parse benchmark. Every packet is addressed to channel zero.
+static const uint8_t QUERIES[] = {0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY};
+static const uint8_t ACTUATOR_WRITES[] = {0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x03, RCP_SIMPLE_ACTUATOR_ON};
+static const uint8_t STEPPER_WRITES[] = {0x06, RCP_DEVCLASS_STEPPER, 0x01, RCP_STEPPER_ABSOLUTE_POS_CONTROL,
+                                         0x00, 0x00, 0x48, 0x42};
+static const uint8_t SENSOR_READS[] = {0x01, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x02};
+static const uint8_t MIXED[] = {0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY,
+                                0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x03, RCP_SIMPLE_ACTUATOR_ON,
+                                0x06, RCP_DEVCLASS_STEPPER, 0x01, RCP_STEPPER_ABSOLUTE_POS_CONTROL,
+                                0x00, 0x00, 0x48, 0x42,
+                                0x01, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x02,
+                                0x41, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY};
+
+struct PacketMix {
+    const char* name;
+    const uint8_t* bytes;
+    size_t length;
+    int packets;
+};
+
+static const PacketMix MIXES[] = {
+    {"queries", QUERIES, sizeof(QUERIES), 1},
+    {"actuator_writes", ACTUATOR_WRITES, sizeof(ACTUATOR_WRITES), 1},
+    {"stepper_writes", STEPPER_WRITES, sizeof(STEPPER_WRITES), 1},
+    {"sensor_reads", SENSOR_READS, sizeof(SENSOR_READS), 1},
+    {"mixed", MIXED, sizeof(MIXED), 5},
+};
+
+// Feeds one repetition of the mix per iteration and yields until all of it is parsed
+static void BM_YieldParse(benchmark::State& state) {
+    const PacketMix& mix = MIXES[state.range(0)];
+    state.SetLabel(mix.name);
+    RCP::init();
+    Bench::setInput(mix.bytes, mix.length);
+
+    for(auto _ : state) {
+        Bench::feed(mix.length);
+        for(int i = 0; i < mix.packets; i++) RCP::yield();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * mix.length));
+    state.SetItemsProcessed(state.iterations() * mix.packets);
+}
+BENCHMARK(BM_YieldParse)->DenseRange(0, sizeof(MIXES) / sizeof(PacketMix) - 1);
+
+static void BM_SendOneFloat(benchmark::State& state) {
+    float val = 1.5f;
+    for(auto _ : state) {
+        RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 1, val);
+        benchmark::DoNotOptimize(val);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SendOneFloat);
+
+static void BM_SendTwoFloat(benchmark::State& state) {
+    const float vals[2] = {1.5f, 2.5f};
+    for(auto _ : state) RCP::sendTwoFloat(RCP_DEVCLASS_POWERMON, 1, vals);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SendTwoFloat);
+
+static void BM_SendThreeFloat(benchmark::State& state) {
+    const float vals[3] = {1.5f, 2.5f, 3.5f};
+    for(auto _ : state) RCP::sendThreeFloat(RCP_DEVCLASS_ACCELEROMETER, 1, vals);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SendThreeFloat);
+
+static void BM_SendFourFloat(benchmark::State& state) {
+    const float vals[4] = {1.5f, 2.5f, 3.5f, 4.5f};
+    for(auto _ : state) RCP::sendFourFloat(RCP_DEVCLASS_GPS, 1, vals);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SendFourFloat);
@@ -0,0 +1,25 @@
+#include <benchmark/benchmark.h>
+
+#include "RCP_Target/redlines.h"
+
+// Checking one sample against a table of rules, of which only the four for the sampled sensor match it
+static void BM_EvaluateRedlines(benchmark::State& state) {
+    static RCP::Redline redlines[256];
+    auto rules = static_cast<uint16_t>(state.range(0));
+    for(uint16_t i = 0; i < rules; i++) {
+        redlines[i] = {RCP_DEVCLASS_PRESSURE_TRANSDUCER, static_cast<uint8_t>(i / 4), static_cast<uint8_t>(i % 4),
+                       RCP_REDLINE_ABOVE, 1000, 10, 3, RCP_REDLINE_ESTOP};
+    }
+    RCP::setRedlines(redlines, rules);
+
+    const float values[4] = {1.5f, 2.5f, 3.5f, 4.5f};
+    uint8_t id = 0;
+    for(auto _ : state) {
+        RCP::evaluateRedlines(RCP_DEVCLASS_PRESSURE_TRANSDUCER, id, values, 4);
+        id = (id + 1) % (rules / 4);
+    }
+
+    RCP::setRedlines(nullptr, 0);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EvaluateRedlines)->Arg(4)->Arg(32)->Arg(128)->Arg(256);
@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+
+#include "RCP_Target/LRIRingBuf.h"
+
+template<size_t SIZE>
+static void BM_RingBufPushPop(benchmark::State& state) {
+    static LRI::RingBuf<uint8_t, SIZE> buf;
+    uint8_t val = 0;
+    for(auto _ : state) {
+        for(size_t i = 0; i < SIZE; i++) buf.push(static_cast<uint8_t>(i));
+        for(size_t i = 0; i < SIZE; i++) buf.pop(val);
+        benchmark::DoNotOptimize(val);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * SIZE * 2));
+}
+BENCHMARK(BM_RingBufPushPop<16>);
+BENCHMARK(BM_RingBufPushPop<128>);
+BENCHMARK(BM_RingBufPushPop<1024>);
+
+template<size_t SIZE>
+static void BM_RingBufPeek(benchmark::State& state) {
+    static LRI::RingBuf<uint8_t, SIZE> buf;
+    buf.clear();
+    // Leave the read index in the middle so peeks wrap around
+    uint8_t val = 0;
+    for(size_t i = 0; i < SIZE; i++) buf.push(static_cast<uint8_t>(i));
+    for(size_t i = 0; i < SIZE / 2; i++) buf.pop(val);
+    for(size_t i = 0; i < SIZE / 2; i++) buf.push(static_cast<uint8_t>(i));
+
+    for(auto _ : state) {
+        for(size_t i = 0; i < SIZE; i++) buf.peek(val, i);
+        benchmark::DoNotOptimize(val);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * SIZE));
+}
+BENCHMARK(BM_RingBufPeek<16>);
+BENCHMARK(BM_RingBufPeek<128>);
+BENCHMARK(BM_RingBufPeek<1024>);
@@ -0,0 +1,75 @@
+# Builds tools/footprint.cpp against the library in a few feature configurations (see src/RCP_Target/config.h) and
+# reports the flash and RAM each one takes. Run through the RCPT_Footprint target, which passes:
+#   SOURCE  repository root
+#   BIN     directory for the firmware images and footprint.csv
+#   CXX     compiler, normally a cross compiler
+#   SIZE    the matching size tool
+#   FLAGS   target flags, as a ;-list
+
+set(SOURCES
+        src/RCPTarget.cpp src/procedures.cpp src/coprocedures.cpp src/bytecode.cpp src/executor.cpp
+        src/diagnostics.cpp src/redlines.cpp src/stats.cpp src/trace.cpp src/transports.cpp src/framing.cpp
+        src/aggregation.cpp src/router.cpp tools/footprint.cpp
+)
+list(TRANSFORM SOURCES PREPEND ${SOURCE}/)
+
+# Our smallest boards: simple actuators and pressure transducers only
+set(SMALL "RCPT_STEPPERS=0 RCPT_ANGLED_ACTUATORS=0 RCPT_MOTORS=0 RCPT_DISCRETE_ACTUATORS=0 RCPT_TWO_FLOAT_SENSORS=0 \
+RCPT_THREE_FLOAT_SENSORS=0 RCPT_FOUR_FLOAT_SENSORS=0 RCPT_BOOL_SENSORS=0 RCPT_PROMPTS=0")
+
+# name|space separated definitions
+set(CONFIGS
+        "full|"
+        "no-stats|RCPT_STATS=0"
+        "no-procedures|RCPT_PROCEDURES=0"
+        "valves-and-pts|${SMALL}"
+        "links-and-channels|RCPT_TRANSPORTS=2 RCPT_AGGREGATION_MTU=128 RCPT_ROUTER=1 RCPT_CHANNELS=4"
+        "valves-and-pts-bare|${SMALL} RCPT_PROCEDURES=0 RCPT_STATS=0"
+)
+
+file(MAKE_DIRECTORY ${BIN})
+set(CSV "config,text,data,bss,flash,ram\n")
+message(STATUS "Footprint with ${CXX} ${FLAGS}")
+message(STATUS "")
+message(STATUS "  configuration            flash    ram")
+
+foreach(CONFIG ${CONFIGS})
+    string(REGEX MATCH "^([^|]*)\\|(.*)$" PARTS "${CONFIG}")
+    set(NAME ${CMAKE_MATCH_1})
+    separate_arguments(DEFS UNIX_COMMAND "${CMAKE_MATCH_2}")
+    list(TRANSFORM DEFS PREPEND -D)
+
+    set(ELF ${BIN}/footprint-${NAME}.elf)
+    execute_process(
+            COMMAND ${CXX} ${FLAGS} -std=c++17 -Os -ffunction-sections -fdata-sections -fno-exceptions -fno-rtti
+            -Wl,--gc-sections ${DEFS} -I${SOURCE}/src ${SOURCES} -o ${ELF}
+            RESULT_VARIABLE RESULT
+            ERROR_VARIABLE ERRORS
+    )
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "Building the ${NAME} configuration failed:\n${ERRORS}")
+    endif()
+
+    # Berkeley format: a header line, then text data bss dec hex filename
+    execute_process(COMMAND ${SIZE} -B ${ELF} OUTPUT_VARIABLE SIZES RESULT_VARIABLE RESULT)
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "${SIZE} failed on ${ELF}")
+    endif()
+
+    string(REGEX MATCH "\n[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" LINE "${SIZES}")
+    set(TEXT ${CMAKE_MATCH_1})
+    set(DATA ${CMAKE_MATCH_2})
+    set(BSS ${CMAKE_MATCH_3})
+    math(EXPR FLASH "${TEXT} + ${DATA}")
+    math(EXPR RAM "${DATA} + ${BSS}")
+
+    string(APPEND CSV "${NAME},${TEXT},${DATA},${BSS},${FLASH},${RAM}\n")
+    string(LENGTH "${NAME}" LEN)
+    math(EXPR PAD "25 - ${LEN}")
+    string(REPEAT " " ${PAD} SPACES)
+    message(STATUS "  ${NAME}${SPACES}${FLASH}    ${RAM}")
+endforeach()
+
+file(WRITE ${BIN}/footprint.csv "${CSV}")
+message(STATUS "")
+message(STATUS "Written to ${BIN}/footprint.csv")
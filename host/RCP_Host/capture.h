@@ -0,0 +1,138 @@
+#ifndef RCP_CAPTURE_H
+#define RCP_CAPTURE_H
+
+/*
+ * A binary capture format for the byte streams a target receives and sends, so field issues can be replayed on the
+ * host (see replay.h).
+ *
+ * A capture is a FileHeader, then chunks, then an index and a Trailer. All fields are little endian. Each chunk is a
+ * ChunkHeader followed by its bytes, padded to a multiple of 8 so every header is aligned when the file is mapped. The
+ * index has an entry for every indexInterval-th chunk, which lets a reader start from any point in time without
+ * scanning the whole capture. A capture whose writer never closed it has no index or trailer; readers then scan the
+ * chunks from the start.
+ *
+ * Writer records chunks to a file. attach() installs it as the RCP::setCaptureTap() tap, which records what read()
+ * returned and what was passed to write(), timestamped with RCP::systimeMicros(). Reader maps a capture into memory,
+ * so captures of any size can be read without loading them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace RCPCapture {
+    constexpr char MAGIC[8] = {'R', 'C', 'P', 'C', 'A', 'P', 'T', 'R'};
+    constexpr uint32_t VERSION = 1;
+
+    typedef enum {
+        CAPTURE_RX = 0x00,
+        CAPTURE_TX = 0x01,
+    } Direction;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t indexInterval;
+    };
+
+    struct ChunkHeader {
+        // Microseconds
+        uint64_t time;
+        uint32_t length;
+        uint8_t direction;
+        uint8_t reserved[3];
+    };
+
+    struct IndexEntry {
+        uint64_t time;
+        // File offset of the chunk's header
+        uint64_t offset;
+    };
+
+    struct Trailer {
+        uint64_t indexOffset;
+        uint64_t indexCount;
+        uint64_t chunkCount;
+        char magic[8];
+    };
+
+    static_assert(sizeof(FileHeader) == 16 && sizeof(ChunkHeader) == 16 && sizeof(IndexEntry) == 16 &&
+                  sizeof(Trailer) == 32, "Capture structures must have no padding");
+
+    class Writer {
+        FILE* file;
+        uint64_t offset;
+        uint64_t chunks;
+        uint32_t indexInterval;
+        std::vector<IndexEntry> index;
+
+        // systimeMicros() wraps after about 71 minutes, captures do not
+        uint32_t lastMicros;
+        uint64_t tapTime;
+
+    public:
+        explicit Writer(const std::string& path, uint32_t indexInterval = 1024);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool isOpen() const;
+        void record(Direction direction, uint64_t time, const void* data, uint32_t length);
+        // Writes the index and trailer. Called by the destructor.
+        void close();
+
+        // Records the target's byte streams until detach() or destruction
+        void attach();
+        void detach();
+        static void tap(bool transmit, const void* data, uint8_t length);
+    };
+
+    struct Chunk {
+        uint64_t time;
+        Direction direction;
+        const uint8_t* data;
+        uint32_t length;
+    };
+
+    class Reader {
+        const uint8_t* base;
+        size_t size;
+        uint64_t dataEnd;
+        const IndexEntry* index;
+        uint64_t indexCount;
+        uint64_t chunks;
+
+    public:
+        class Cursor {
+            const Reader* reader;
+            uint64_t offset;
+
+        public:
+            Cursor(const Reader* reader, uint64_t offset);
+
+            // Fills chunk and moves on. Returns false at the end of the capture.
+            bool next(Chunk& chunk);
+        };
+
+        explicit Reader(const std::string& path);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        bool isOpen() const;
+        // False if the capture was never closed. Its chunks are still readable.
+        bool isIndexed() const;
+        // Number of chunks, counted by scanning if the capture has no trailer
+        uint64_t chunkCount() const;
+
+        Cursor begin() const;
+        // A cursor at the first chunk at or after time
+        Cursor seek(uint64_t time) const;
+    };
+} // namespace RCPCapture
+
+#endif // RCP_CAPTURE_H
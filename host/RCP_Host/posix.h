@@ -0,0 +1,93 @@
+#ifndef RCP_POSIX_H
+#define RCP_POSIX_H
+
+/*
+ * Linux transport for running a target on a single board computer, over a serial tty, a pty or a UNIX stream socket.
+ *
+ * Linking RCPT_Posix provides the write/readAvail/read/systime/systimeMicros RCP hooks, so it can not be linked
+ * together with RCPT_Sim or RCPT_Replay. Open a file descriptor with one of the open functions (or any other stream
+ * fd), then call start() before RCP::init(). systime() and systimeMicros() count CLOCK_MONOTONIC from program start.
+ *
+ * The fd is non-blocking and watched with epoll. write() only copies packets into a transmit ring, which is sent with
+ * one writev() per batch: at the start of the next yield(), from flush() and wait(), or when the ring fills up. A
+ * main loop that sends a burst of telemetry each iteration therefore makes one system call for all of it. If the link
+ * fails (the peer closed a socket, a USB serial adapter was unplugged) or takes nothing for Options::txTimeoutMs while
+ * write() or flush() waits on it, the pending output is dropped and counted instead of blocking the target.
+ *
+ * With Options::ioThread a dedicated thread does the reads and writes as soon as the link allows. write() then only
+ * copies into the ring and wakes the thread if it was idle, and readAvail() takes what the thread has received. This
+ * keeps system calls out of the main loop, at the cost of a thread switch per batch.
+ *
+ * start() can also take a shared memory link to a host process on the same machine (see shm.h). write() then copies
+ * each packet straight into the link, readAvail() takes from it, and nothing makes a system call unless one side has
+ * to wait for the other. Options::ioThread and the buffer sizes do not apply; a packet that does not fit waits for
+ * room up to txTimeoutMs and is dropped whole after that.
+ *
+ *     RCPPosix::Options options;
+ *     options.ioThread = true;
+ *     RCPPosix::start(RCPPosix::openTty("/dev/ttyACM0", 115200), options);
+ *     RCP::init();
+ *     while(true) {
+ *         RCPPosix::wait(1);
+ *         RCP::yield();
+ *         RCP::runTest();
+ *     }
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "shm.h"
+
+namespace RCPPosix {
+    struct Options {
+        // Do the reads and writes on a dedicated thread
+        bool ioThread = false;
+        // Bytes queued for sending before write() has to wait for the link
+        size_t txBufferSize = 65536;
+        // Bytes the I/O thread reads ahead of yield()
+        size_t rxBufferSize = 65536;
+        // How long write() and flush() wait for a link that takes nothing before dropping what is pending
+        uint32_t txTimeoutMs = 1000;
+    };
+
+    // Counted since start()
+    struct Stats {
+        uint64_t rxBytes;
+        uint64_t txBytes;
+        // System calls that moved data. Always 0 on a shared memory link, see RCPShm::Link::getStats().
+        uint64_t reads;
+        uint64_t writes;
+        // Times write() found the transmit ring full and had to wait for the link
+        uint64_t txStalls;
+        // Bytes discarded because the link failed or stalled
+        uint64_t txDropped;
+    };
+
+    // Opens a serial port in raw mode at one of the standard baud rates. Returns the fd, or -1 with errno set.
+    int openTty(const char* path, uint32_t baud);
+    // Opens a raw mode pty. The target uses the returned master fd; the host opens peerPath like a serial port.
+    int openPty(std::string& peerPath);
+    // Connects to a listening UNIX stream socket at path
+    int connectUnix(const char* path);
+    // Listens on a UNIX stream socket at path, which must not exist yet, and waits for one connection
+    int acceptUnix(const char* path);
+
+    // Makes fd the link used by the RCP hooks. The caller keeps ownership of fd, and closes it after stop().
+    bool start(int fd, const Options& options = {});
+    // Makes an open shared memory link the one used by the RCP hooks. It has to stay open until stop().
+    bool start(RCPShm::Link& link, const Options& options = {});
+    // Sends what the link takes right away of what is pending, then stops the I/O thread. Call flush() first to wait
+    // for all of it.
+    void stop();
+    // Waits until everything written so far has been sent, or dropped after a failure or txTimeoutMs stall
+    void flush();
+    // Sends what is pending, then waits up to timeoutMs (-1 forever) for input. Returns true if input is available.
+    // A main loop with nothing else to do can call this instead of spinning on yield().
+    bool wait(int timeoutMs);
+    Stats getStats();
+} // namespace RCPPosix
+
+#endif // RCP_POSIX_H
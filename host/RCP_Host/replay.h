@@ -0,0 +1,54 @@
+#ifndef RCP_REPLAY_H
+#define RCP_REPLAY_H
+
+/*
+ * Replays the received side of a capture (see capture.h) into RCP::yield(), to reproduce what a target did with a
+ * recorded byte stream.
+ *
+ * Linking RCPT_Replay provides the read/write/systime RCP hooks, so it can not be linked together with RCPT_Sim.
+ * The target's clock follows the capture timestamps, so timeouts and heartbeats behave as they did when it was
+ * recorded. Each received chunk is fed in and yield() is called until every complete packet has been parsed, with
+ * runTest() after each call if runTests is set. Actuator and sensor callbacks are the weak defaults, or whatever the
+ * program linking RCPT_Replay defines.
+ *
+ * At REPLAY_MAX_SPEED the capture is fed as fast as yield() takes it, which makes replay a parse throughput
+ * benchmark on real traffic. REPLAY_REAL_TIME waits until each chunk's original time.
+ */
+
+#include <stdint.h>
+
+#include "RCP_Host/capture.h"
+#include "RCP_Target/RCP_Target.h"
+
+namespace RCPReplay {
+    typedef enum {
+        REPLAY_MAX_SPEED = 0x00,
+        REPLAY_REAL_TIME = 0x01,
+    } Speed;
+
+    struct Options {
+        Speed speed = REPLAY_MAX_SPEED;
+        bool runTests = true;
+        RCP_Channel channel = RCP_CH_ZERO;
+        // Start at the first chunk at or after this capture time
+        uint64_t from = 0;
+    };
+
+    struct Result {
+        uint64_t chunks;
+        uint64_t rxBytes;
+        uint64_t yields;
+        // Bytes the target sent during the replay, and bytes it sent when the capture was recorded
+        uint64_t txBytes;
+        uint64_t recordedTxBytes;
+        // Wall clock time taken by the replay
+        double seconds;
+
+        double bytesPerSecond() const;
+    };
+
+    // Calls RCP::init() and replays capture into it
+    Result replay(const RCPCapture::Reader& capture, const Options& options = {});
+} // namespace RCPReplay
+
+#endif // RCP_REPLAY_H
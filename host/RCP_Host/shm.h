@@ -0,0 +1,108 @@
+#ifndef RCP_SHM_H
+#define RCP_SHM_H
+
+/*
+ * Shared memory link between two processes on the same Linux machine, for a target and the ground station software
+ * running side by side. The link is a region holding two single producer single consumer byte rings, one per
+ * direction, with head and tail counters on their own cache lines. Sending and receiving are plain copies into and out
+ * of the rings, so a busy link moves packets without any system calls.
+ *
+ * A side with nothing to do can wait for the other. On a machine with more than one CPU it first spins for a few
+ * microseconds. Then it sets a flag and sleeps on a futex in the shared region. The other side only makes the futex
+ * wake call when it sees that flag set, so wakeups cost a system call only when a peer was actually asleep.
+ * getStats() counts both.
+ *
+ * One side creates the link, the other opens it by name (a POSIX shared memory object), or attaches to the memfd of
+ * an anonymous one, inherited over fork() or passed over a UNIX socket. RCPPosix::start(link) (see posix.h) makes a
+ * link the one used by the RCP hooks:
+ *
+ *     RCPShm::Link link;
+ *     link.create("/rcp_target");
+ *     RCPPosix::start(link);
+ *     RCP::init();
+ *
+ *     // In the ground station process
+ *     RCPShm::Link link;
+ *     link.open("/rcp_target");
+ *     link.send(packet, sizeof(packet));
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace RCPShm {
+    struct Stats {
+        uint64_t sent;
+        uint64_t received;
+        // futex calls: sleeps while waiting, and wakeups of a peer that was asleep
+        uint64_t sleeps;
+        uint64_t wakeups;
+    };
+
+    class Link {
+        struct Counter;
+        struct Ring;
+        struct Region;
+
+        Region* region = nullptr;
+        size_t mapped = 0;
+        int memFd = -1;
+        // 0 for the side that created the region, 1 for the one that opened it
+        uint8_t side = 0;
+        char name[64] = {};
+        std::atomic<uint64_t> sleeps{0};
+        std::atomic<uint64_t> wakeups{0};
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> received{0};
+
+        bool map(int fd, size_t size);
+        uint8_t* data(uint8_t ring) const;
+        void notify(Counter& counter);
+        template<typename Ready>
+        bool waitOn(Counter& counter, Ready ready, int timeoutMs);
+
+    public:
+        Link() = default;
+        ~Link();
+        Link(const Link&) = delete;
+        Link& operator=(const Link&) = delete;
+
+        // Creates a link with rings of ringSize bytes each, rounded up to a power of two. With a name it is a POSIX
+        // shared memory object that must not exist yet, removed again by close(). Without one it is an anonymous
+        // memfd, see fd().
+        bool create(const char* name = nullptr, size_t ringSize = 65536);
+        bool open(const char* name);
+        // Attaches to a link created without a name, through its fd in this or a child process. fd stays the
+        // caller's.
+        bool attach(int fd);
+        // Marks this side closed, which the peer sees in peerClosed(), and unmaps the region
+        void close();
+
+        bool isOpen() const { return region != nullptr; }
+        bool peerClosed() const;
+        int fd() const { return memFd; }
+
+        // Copies as much of data as there is room for and returns how many bytes that was. Never blocks.
+        size_t send(const void* data, size_t length);
+        // Copies up to length received bytes into data and returns how many. Never blocks.
+        size_t receive(void* data, size_t length);
+        // Bytes waiting to be received
+        size_t available() const;
+        // Bytes send() has room for
+        size_t space() const;
+        // Bytes sent that the peer has not received yet
+        size_t pending() const;
+
+        // Wait up to timeoutMs (-1 forever) for input, for room to send, or for the peer to have received everything.
+        // All of them return early with false once the peer has closed its side.
+        bool waitReadable(int timeoutMs);
+        bool waitWritable(size_t bytes, int timeoutMs);
+        bool waitSent(int timeoutMs);
+
+        Stats getStats() const;
+    };
+} // namespace RCPShm
+
+#endif // RCP_SHM_H
@@ -0,0 +1,231 @@
+#ifndef RCP_SIM_H
+#define RCP_SIM_H
+
+/*
+ * Host side simulator for validating procedures without hardware or wall clock time.
+ *
+ * Linking RCPT_Sim provides every RCP hook (read/write/systime and the *_CLBK callbacks), so a firmware's
+ * Test::getTests() can be run on the host as is. The simulator owns a virtual millisecond clock. Each step it calls
+ * RCP::yield() and RCP::runTest(), then jumps straight to the next thing that can change the system: a deadline
+ * reported through RCP::scheduleWakeup(), a plant model event, or an injected host packet. This means a 10 minute
+ * sequence of WaitProcedures simulates in microseconds.
+ *
+ * Device behaviour comes from plant models. The defaults respond instantly; pass your own subclasses to the
+ * simulator to model valve travel time, stepper motion, sensor responses, etc.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "RCP_Target/RCP_Target.h"
+
+namespace RCPSim {
+    constexpr uint32_t NO_EVENT = UINT32_MAX;
+
+    class Plant {
+    public:
+        virtual ~Plant() = default;
+
+        // Bring the model's state up to time now
+        virtual void advance(uint32_t now);
+
+        // The next time after now at which the model changes state on its own, or NO_EVENT. Models that change
+        // continuously (e.g. a tank pressure) should return their sample period, otherwise procedures waiting on
+        // them are only polled at the next scheduled deadline.
+        virtual uint32_t nextEvent(uint32_t now);
+    };
+
+    // Simple actuators that reach their commanded state travelTime ms after the command
+    class SimpleActuatorPlant : public Plant {
+        struct Actuator {
+            RCP_SimpleActuatorState state;
+            RCP_SimpleActuatorState target;
+            uint32_t arrival;
+        };
+
+        const uint32_t travelTime;
+        Actuator actuators[256];
+
+    public:
+        explicit SimpleActuatorPlant(uint32_t travelTime = 0);
+
+        virtual RCP_SimpleActuatorState write(uint8_t id, RCP_SimpleActuatorState state, uint32_t now);
+        virtual RCP_SimpleActuatorState read(uint8_t id);
+
+        void advance(uint32_t now) override;
+        uint32_t nextEvent(uint32_t now) override;
+    };
+
+    // Steppers that move towards their target position at most maxSpeed units per second. Speed control mode
+    // runs the stepper continuously at the given speed.
+    class StepperPlant : public Plant {
+        struct Stepper {
+            float position;
+            float speed;
+            float target;
+            bool positionControl;
+        };
+
+        const float maxSpeed;
+        uint32_t lastUpdate;
+        Stepper steppers[256];
+
+    public:
+        explicit StepperPlant(float maxSpeed = 1000.0f);
+
+        virtual RCP::Floats2 write(uint8_t id, RCP_StepperControlMode mode, float value, uint32_t now);
+        virtual RCP::Floats2 read(uint8_t id);
+
+        void advance(uint32_t now) override;
+        uint32_t nextEvent(uint32_t now) override;
+    };
+
+    // Motors whose output slews towards the commanded value at slewRate units per second. A slewRate of 0 means
+    // the motor responds instantly.
+    class MotorPlant : public Plant {
+        struct Motor {
+            float value;
+            float target;
+        };
+
+        const float slewRate;
+        uint32_t lastUpdate;
+        Motor motors[256];
+
+    public:
+        explicit MotorPlant(float slewRate = 0);
+
+        virtual float write(uint8_t id, float value, uint32_t now);
+        virtual float read(uint8_t id);
+
+        void advance(uint32_t now) override;
+        uint32_t nextEvent(uint32_t now) override;
+    };
+
+    // Angled and discrete actuators are simple value stores
+    class ValuePlant : public Plant {
+        float angles[256] = {0};
+        uint8_t discretes[256] = {0};
+
+    public:
+        virtual float writeAngled(uint8_t id, float value, uint32_t now);
+        virtual float readAngled(uint8_t id);
+        virtual uint8_t writeDiscrete(uint8_t id, uint8_t state, uint32_t now);
+        virtual uint8_t readDiscrete(uint8_t id);
+    };
+
+    // Sensors read as zero by default. Subclass to model sensors in terms of the other plants and time.
+    class SensorPlant : public Plant {
+    public:
+        virtual RCP::Floats4 read(RCP_DeviceClass devclass, uint8_t id, uint32_t now);
+        virtual bool readBool(uint8_t id, uint32_t now);
+    };
+
+    struct Plants {
+        SimpleActuatorPlant* simpleActuators = nullptr;
+        StepperPlant* steppers = nullptr;
+        MotorPlant* motors = nullptr;
+        ValuePlant* values = nullptr;
+        SensorPlant* sensors = nullptr;
+    };
+
+    struct TimelineEvent {
+        uint32_t time;
+        std::string text;
+    };
+
+    struct Result {
+        // True if the test stopped on its own, false if the time limit was reached first
+        bool finished;
+        RCP_TestRunningState finalState;
+        uint32_t endTime;
+        uint32_t steps;
+    };
+
+    class Simulator {
+        Plants plants;
+        SimpleActuatorPlant defaultSimpleActuators;
+        StepperPlant defaultSteppers;
+        MotorPlant defaultMotors;
+        ValuePlant defaultValues;
+        SensorPlant defaultSensors;
+
+        uint32_t now;
+        uint32_t maxStep;
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> wakeups;
+
+        struct Injection {
+            uint32_t time;
+            std::vector<uint8_t> bytes;
+        };
+
+        std::deque<Injection> injections;
+        std::deque<uint8_t> rx;
+        std::vector<uint8_t> tx;
+        std::vector<TimelineEvent> timeline;
+
+        bool autoPrompt;
+        RCP::PromptData promptResponse;
+        uint32_t promptDelay;
+        RCP_PromptDataType promptType;
+
+        RCP_TestRunningState reportedState;
+        uint32_t runsReported;
+
+        void processTx();
+        void advanceTo(uint32_t time);
+        uint32_t nextTime();
+        void deliverInjections();
+
+    public:
+        explicit Simulator(const Plants& plants = {});
+        ~Simulator();
+
+        Simulator(const Simulator&) = delete;
+        Simulator& operator=(const Simulator&) = delete;
+
+        // Reinitializes RCP and clears the clock, timeline and queues. Plant state is not touched.
+        void reset();
+
+        // How far the clock moves when nothing at all is scheduled. This is the polling period of procedures like
+        // BoolWaiter that do not report a wakeup time. Defaults to 10 ms.
+        void setMaxStep(uint32_t ms);
+
+        // Answer every prompt automatically with response after delay ms
+        void setAutoPrompt(RCP::PromptData response, uint32_t delay = 0);
+
+        // Queue a raw packet from the host, delivered delay ms from now
+        void inject(const std::vector<uint8_t>& packet, uint32_t delay = 0);
+        void startTest(uint8_t testNum, uint32_t delay = 0);
+        void stopTest(uint32_t delay = 0);
+
+        // Run one yield()/runTest() iteration and advance the clock to the next event
+        void step();
+
+        // Step until the clock reaches now + duration
+        void runFor(uint32_t duration);
+
+        // Start testNum and step until it stops or timeLimit ms pass
+        Result runTest(uint8_t testNum, uint32_t timeLimit);
+
+        uint32_t time() const;
+        const std::vector<TimelineEvent>& getTimeline() const;
+        void note(const std::string& text);
+        void printTimeline(FILE* out = stdout) const;
+
+        // Used by the hook implementations
+        static Simulator* active();
+        Plants& getPlants();
+        void wakeAt(uint32_t time);
+        uint8_t rxAvailable() const;
+        uint8_t rxRead();
+        void txWrite(const void* data, uint8_t length);
+    };
+} // namespace RCPSim
+
+#endif // RCP_SIM_H
@@ -0,0 +1,183 @@
+#include "RCP_Host/capture.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "RCP_Target/RCP_Target.h"
+
+namespace RCPCapture {
+    static Writer* attached = nullptr;
+
+    static uint32_t padded(uint32_t length) { return (length + 7) & ~7u; }
+
+    Writer::Writer(const std::string& path, uint32_t indexInterval) :
+        file(fopen(path.c_str(), "wb")), offset(0), chunks(0), indexInterval(indexInterval == 0 ? 1 : indexInterval),
+        lastMicros(0), tapTime(0) {
+        if(file == nullptr) return;
+
+        FileHeader header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.indexInterval = this->indexInterval;
+        fwrite(&header, sizeof(header), 1, file);
+        offset = sizeof(header);
+    }
+
+    Writer::~Writer() {
+        detach();
+        close();
+    }
+
+    bool Writer::isOpen() const { return file != nullptr; }
+
+    void Writer::record(Direction direction, uint64_t time, const void* data, uint32_t length) {
+        if(file == nullptr) return;
+        if(chunks % indexInterval == 0) index.push_back({time, offset});
+
+        ChunkHeader header{};
+        header.time = time;
+        header.length = length;
+        header.direction = direction;
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(data, 1, length, file);
+
+        static const uint8_t padding[8] = {0};
+        fwrite(padding, 1, padded(length) - length, file);
+
+        offset += sizeof(header) + padded(length);
+        chunks++;
+    }
+
+    void Writer::close() {
+        if(file == nullptr) return;
+
+        Trailer trailer{};
+        trailer.indexOffset = offset;
+        trailer.indexCount = index.size();
+        trailer.chunkCount = chunks;
+        memcpy(trailer.magic, MAGIC, sizeof(MAGIC));
+        fwrite(index.data(), sizeof(IndexEntry), index.size(), file);
+        fwrite(&trailer, sizeof(trailer), 1, file);
+
+        fclose(file);
+        file = nullptr;
+    }
+
+    void Writer::attach() {
+        attached = this;
+        lastMicros = RCP::systimeMicros();
+        RCP::setCaptureTap(&Writer::tap);
+    }
+
+    void Writer::detach() {
+        if(attached != this) return;
+        attached = nullptr;
+        RCP::setCaptureTap(nullptr);
+    }
+
+    void Writer::tap(bool transmit, const void* data, uint8_t length) {
+        if(attached == nullptr) return;
+        uint32_t now = RCP::systimeMicros();
+        attached->tapTime += now - attached->lastMicros;
+        attached->lastMicros = now;
+        attached->record(transmit ? CAPTURE_TX : CAPTURE_RX, attached->tapTime, data, length);
+    }
+
+    Reader::Reader(const std::string& path) :
+        base(nullptr), size(0), dataEnd(0), index(nullptr), indexCount(0), chunks(UINT64_MAX) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+
+        struct stat info {};
+        if(fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(FileHeader)) {
+            void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map != MAP_FAILED) {
+                base = static_cast<const uint8_t*>(map);
+                size = info.st_size;
+            }
+        }
+
+        ::close(fd);
+        if(base == nullptr) return;
+
+        if(memcmp(base, MAGIC, sizeof(MAGIC)) != 0) {
+            munmap(const_cast<uint8_t*>(base), size);
+            base = nullptr;
+            return;
+        }
+
+        madvise(const_cast<uint8_t*>(base), size, MADV_SEQUENTIAL);
+        dataEnd = size;
+
+        if(size < sizeof(FileHeader) + sizeof(Trailer)) return;
+        Trailer trailer;
+        memcpy(&trailer, base + size - sizeof(Trailer), sizeof(Trailer));
+        if(memcmp(trailer.magic, MAGIC, sizeof(MAGIC)) != 0) return;
+        if(trailer.indexOffset + trailer.indexCount * sizeof(IndexEntry) + sizeof(Trailer) != size) return;
+
+        dataEnd = trailer.indexOffset;
+        index = reinterpret_cast<const IndexEntry*>(base + trailer.indexOffset);
+        indexCount = trailer.indexCount;
+        chunks = trailer.chunkCount;
+    }
+
+    Reader::~Reader() {
+        if(base != nullptr) munmap(const_cast<uint8_t*>(base), size);
+    }
+
+    bool Reader::isOpen() const { return base != nullptr; }
+
+    bool Reader::isIndexed() const { return index != nullptr; }
+
+    uint64_t Reader::chunkCount() const {
+        if(chunks != UINT64_MAX) return chunks;
+
+        uint64_t count = 0;
+        Chunk chunk{};
+        Cursor cursor = begin();
+        while(cursor.next(chunk)) count++;
+        return count;
+    }
+
+    Reader::Cursor Reader::begin() const { return {this, sizeof(FileHeader)}; }
+
+    Reader::Cursor Reader::seek(uint64_t time) const {
+        uint64_t start = sizeof(FileHeader);
+        if(index != nullptr) {
+            // The last indexed chunk before time
+            const IndexEntry* entry = std::lower_bound(
+                index, index + indexCount, time, [](const IndexEntry& e, uint64_t t) { return e.time < t; });
+            if(entry != index) start = (entry - 1)->offset;
+        }
+
+        Cursor cursor(this, start);
+        while(true) {
+            Cursor here = cursor;
+            Chunk chunk{};
+            if(!cursor.next(chunk) || chunk.time >= time) return here;
+        }
+    }
+
+    Reader::Cursor::Cursor(const Reader* reader, uint64_t offset) : reader(reader), offset(offset) {}
+
+    bool Reader::Cursor::next(Chunk& chunk) {
+        if(reader->base == nullptr || offset + sizeof(ChunkHeader) > reader->dataEnd) return false;
+
+        ChunkHeader header;
+        memcpy(&header, reader->base + offset, sizeof(header));
+        // A chunk cut short by a crash ends the capture
+        if(offset + sizeof(header) + header.length > reader->dataEnd) return false;
+
+        chunk.time = header.time;
+        chunk.direction = static_cast<Direction>(header.direction);
+        chunk.data = reader->base + offset + sizeof(header);
+        chunk.length = header.length;
+        offset += sizeof(header) + padded(header.length);
+        return true;
+    }
+} // namespace RCPCapture
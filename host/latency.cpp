@@ -0,0 +1,292 @@
+/*
+ * Command to echo round trip latency harness. The target library runs its main loop on one thread behind the
+ * RCPT_Posix transport (see RCP_Host/posix.h) over a socketpair, a pty or a shared memory link, and the main thread
+ * acts as the host: it sends simple actuator writes and waits for the sendSimpleActuatorState() echo.
+ *
+ *     RCPT_LatencyHarness [--transport socketpair|pty|shm] [--io-thread] [--commands N] [--window N] [--duration S]
+ *                         [--telemetry HZ]
+ *
+ * The latency phase sends --commands writes one at a time and reports p50/p99/p99.9 of the round trip. The throughput
+ * phase keeps --window writes in flight for --duration seconds and reports sustained commands per second. Meanwhile
+ * the target streams --telemetry four float sensor packets per second, competing with the echoes for the link.
+ */
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RCP_Host/posix.h"
+#include "RCP_Target/RCP_Target.h"
+
+using Clock = std::chrono::steady_clock;
+
+typedef enum {
+    TRANSPORT_SOCKETPAIR,
+    TRANSPORT_PTY,
+    TRANSPORT_SHM,
+} Transport;
+
+static const char* const TRANSPORT_NAMES[] = {"socketpair", "pty", "shm"};
+
+struct Options {
+    Transport transport = TRANSPORT_SOCKETPAIR;
+    bool ioThread = false;
+    int commands = 10000;
+    int window = 16;
+    double duration = 2;
+    double telemetry = 0;
+};
+
+static int targetFd = -1;
+static RCPShm::Link targetLink;
+static std::atomic<bool> running{true};
+static RCP_SimpleActuatorState actuators[256];
+
+namespace RCP {
+    RCP_SimpleActuatorState readSimpleActuator(uint8_t id) { return actuators[id]; }
+
+    RCP_SimpleActuatorState simpleActuatorWrite_CLBK(uint8_t id, RCP_SimpleActuatorState state) {
+        actuators[id] = state;
+        return state;
+    }
+} // namespace RCP
+
+static void targetLoop(const Options& options) {
+    RCP::init();
+    RCP::setReady(true);
+
+    const float vals[4] = {1, 2, 3, 4};
+    const auto period = options.telemetry > 0 ? std::chrono::nanoseconds(static_cast<int64_t>(1e9 / options.telemetry))
+                                              : std::chrono::nanoseconds(0);
+    Clock::time_point next = Clock::now();
+
+    while(running) {
+        RCP::yield();
+        RCP::runTest();
+
+        if(period.count() == 0 || Clock::now() < next) continue;
+        RCP::sendFourFloat(RCP_DEVCLASS_GPS, 0, vals);
+        next += period;
+        // Don't try to make up for a long stall with a burst
+        if(Clock::now() - next > period * 100) next = Clock::now();
+    }
+}
+
+// The host end of the link, an fd or a shared memory link. Splits the byte stream into packets and counts what it
+// sees.
+class Host {
+    int fd;
+    RCPShm::Link* link;
+    std::vector<uint8_t> buf;
+
+public:
+    uint64_t echoes = 0;
+    uint64_t telemetry = 0;
+
+    Host(int fd, RCPShm::Link* link) : fd(fd), link(link) {}
+
+    void send(uint8_t id, RCP_SimpleActuatorState state) {
+        const uint8_t pkt[] = {0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, id, static_cast<uint8_t>(state)};
+        size_t sent = 0;
+        while(sent < sizeof(pkt)) {
+            if(link != nullptr) {
+                sent += link->send(pkt + sent, sizeof(pkt) - sent);
+                if(sent < sizeof(pkt)) link->waitWritable(sizeof(pkt) - sent, 1000);
+                continue;
+            }
+
+            ssize_t written = ::write(fd, pkt + sent, sizeof(pkt) - sent);
+            if(written > 0) sent += written;
+        }
+    }
+
+    // Reads until at least one more echo has arrived. Returns false on timeout.
+    bool waitEcho() {
+        uint64_t start = echoes;
+        while(echoes == start) {
+            uint8_t chunk[512];
+            ssize_t len;
+            if(link != nullptr) {
+                if(!link->waitReadable(1000)) return false;
+                len = link->receive(chunk, sizeof(chunk));
+            }
+
+            else {
+                pollfd pfd = {fd, POLLIN, 0};
+                if(poll(&pfd, 1, 1000) <= 0) return false;
+                len = ::read(fd, chunk, sizeof(chunk));
+            }
+
+            if(len <= 0) return false;
+            buf.insert(buf.end(), chunk, chunk + len);
+            parse();
+        }
+
+        return true;
+    }
+
+private:
+    void parse() {
+        size_t pos = 0;
+        while(pos < buf.size()) {
+            size_t len = (buf[pos] & ~RCP_CHANNEL_MASK) + 2;
+            if(pos + len > buf.size()) break;
+            if(buf[pos + 1] == RCP_DEVCLASS_SIMPLE_ACTUATOR) echoes++;
+            else if(buf[pos + 1] == RCP_DEVCLASS_GPS) telemetry++;
+            pos += len;
+        }
+
+        buf.erase(buf.begin(), buf.begin() + pos);
+    }
+};
+
+static bool openTransport(const Options& options, int& hostFd, RCPShm::Link& hostLink) {
+    RCPPosix::Options posix;
+    posix.ioThread = options.ioThread;
+
+    switch(options.transport) {
+    case TRANSPORT_SOCKETPAIR: {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+        hostFd = fds[0];
+        targetFd = fds[1];
+        break;
+    }
+
+    case TRANSPORT_PTY: {
+        std::string peer;
+        targetFd = RCPPosix::openPty(peer);
+        if(targetFd < 0) return false;
+        hostFd = open(peer.c_str(), O_RDWR | O_NOCTTY);
+        if(hostFd < 0) return false;
+        break;
+    }
+
+    case TRANSPORT_SHM:
+        // Its own mapping of the region, the way a host process would have
+        return targetLink.create() && hostLink.attach(targetLink.fd()) && RCPPosix::start(targetLink, posix);
+    }
+
+    return RCPPosix::start(targetFd, posix);
+}
+
+static double percentile(const std::vector<double>& sorted, double q) {
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()));
+    return sorted[index];
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if(strcmp(arg, "--transport") == 0 && val != nullptr) {
+            i++;
+            if(strcmp(val, "pty") == 0) options.transport = TRANSPORT_PTY;
+            else if(strcmp(val, "shm") == 0) options.transport = TRANSPORT_SHM;
+            else options.transport = TRANSPORT_SOCKETPAIR;
+        }
+        else if(strcmp(arg, "--io-thread") == 0) options.ioThread = true;
+        else if(strcmp(arg, "--commands") == 0 && val != nullptr) options.commands = atoi(argv[++i]);
+        else if(strcmp(arg, "--window") == 0 && val != nullptr) options.window = atoi(argv[++i]);
+        else if(strcmp(arg, "--duration") == 0 && val != nullptr) options.duration = atof(argv[++i]);
+        else if(strcmp(arg, "--telemetry") == 0 && val != nullptr) options.telemetry = atof(argv[++i]);
+        else {
+            fprintf(stderr,
+                    "Usage: %s [--transport socketpair|pty|shm] [--io-thread] [--commands N] [--window N] "
+                    "[--duration S] [--telemetry HZ]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if(options.commands < 1 || options.window < 1) {
+        fprintf(stderr, "--commands and --window must be at least 1\n");
+        return 1;
+    }
+
+    int hostFd = -1;
+    RCPShm::Link hostLink;
+    if(!openTransport(options, hostFd, hostLink)) {
+        perror("Could not open transport");
+        return 1;
+    }
+
+    std::thread target(targetLoop, std::cref(options));
+    Host host(hostFd, options.transport == TRANSPORT_SHM ? &hostLink : nullptr);
+    bool ok = true;
+
+    // Latency: one command in flight at a time
+    std::vector<double> latencies;
+    latencies.reserve(options.commands);
+    for(int i = 0; i < options.commands && ok; i++) {
+        Clock::time_point start = Clock::now();
+        host.send(0, i % 2 ? RCP_SIMPLE_ACTUATOR_OFF : RCP_SIMPLE_ACTUATOR_ON);
+        ok = host.waitEcho();
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    // Throughput: keep the window full
+    uint64_t completed = 0;
+    uint64_t telemetryBefore = host.telemetry;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(options.duration));
+    int inFlight = 0;
+    while(ok && Clock::now() < end) {
+        for(; inFlight < options.window; inFlight++) host.send(1, RCP_SIMPLE_ACTUATOR_TOGGLE);
+        uint64_t before = host.echoes;
+        ok = host.waitEcho();
+        inFlight -= host.echoes - before;
+        completed += host.echoes - before;
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Closing the host end first makes the target drop what it still sends instead of waiting for the link
+    running = false;
+    if(hostFd >= 0) close(hostFd);
+    RCPShm::Stats hostStats = hostLink.getStats();
+    hostLink.close();
+    target.join();
+    RCPPosix::stop();
+    RCPShm::Stats targetStats = targetLink.getStats();
+    targetLink.close();
+    if(targetFd >= 0) close(targetFd);
+
+    if(!ok) {
+        fprintf(stderr, "Timed out waiting for an echo\n");
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("transport %s%s, telemetry %.0f Hz\n", TRANSPORT_NAMES[options.transport],
+           options.ioThread && options.transport != TRANSPORT_SHM ? " with I/O thread" : "", options.telemetry);
+    printf("latency (us) over %d commands: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", options.commands,
+           percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.back());
+    printf("throughput with %d in flight: %.0f commands/s, %.0f telemetry packets/s received\n", options.window,
+           completed / seconds, (host.telemetry - telemetryBefore) / seconds);
+    if(options.transport == TRANSPORT_SHM) {
+        printf("futex calls: target %llu sleeps, %llu wakeups; host %llu sleeps, %llu wakeups\n",
+               static_cast<unsigned long long>(targetStats.sleeps),
+               static_cast<unsigned long long>(targetStats.wakeups), static_cast<unsigned long long>(hostStats.sleeps),
+               static_cast<unsigned long long>(hostStats.wakeups));
+    }
+
+    else {
+        RCPPosix::Stats stats = RCPPosix::getStats();
+        printf("target system calls: %llu reads, %llu writes\n", static_cast<unsigned long long>(stats.reads),
+               static_cast<unsigned long long>(stats.writes));
+    }
+    return 0;
+}
@@ -0,0 +1,603 @@
+#include "RCP_Host/posix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RCP_Target/RCP_Target.h"
+
+namespace RCPPosix {
+    // head and tail count every byte ever added and removed, so the ring never needs a separate full flag
+    class ByteRing {
+        std::vector<uint8_t> buf;
+        size_t head = 0;
+        size_t tail = 0;
+
+        // Up to two iovecs covering length bytes from position from. Returns how many.
+        int spans(size_t from, size_t length, iovec* iov) {
+            if(length == 0) return 0;
+            size_t start = from % buf.size();
+            size_t first = std::min(length, buf.size() - start);
+            iov[0] = {buf.data() + start, first};
+            if(first == length) return 1;
+            iov[1] = {buf.data(), length - first};
+            return 2;
+        }
+
+    public:
+        void reset(size_t capacity) {
+            buf.assign(capacity == 0 ? 1 : capacity, 0);
+            head = tail = 0;
+        }
+
+        size_t used() const { return head - tail; }
+        size_t space() const { return buf.size() - used(); }
+
+        int filled(iovec* iov) { return spans(tail, used(), iov); }
+        int empty(iovec* iov) { return spans(head, space(), iov); }
+        void produced(size_t length) { head += length; }
+        void consumed(size_t length) { tail += length; }
+
+        size_t push(const uint8_t* data, size_t length) {
+            iovec iov[2];
+            int count = empty(iov);
+            size_t copied = 0;
+            for(int i = 0; i < count && copied < length; i++) {
+                size_t part = std::min(iov[i].iov_len, length - copied);
+                memcpy(iov[i].iov_base, data + copied, part);
+                copied += part;
+            }
+
+            produced(copied);
+            return copied;
+        }
+
+        size_t pop(uint8_t* data, size_t length) {
+            iovec iov[2];
+            int count = filled(iov);
+            size_t copied = 0;
+            for(int i = 0; i < count && copied < length; i++) {
+                size_t part = std::min(iov[i].iov_len, length - copied);
+                memcpy(data + copied, iov[i].iov_base, part);
+                copied += part;
+            }
+
+            consumed(copied);
+            return copied;
+        }
+    };
+
+    struct Counters {
+        std::atomic<uint64_t> rxBytes{0};
+        std::atomic<uint64_t> txBytes{0};
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> writes{0};
+        std::atomic<uint64_t> txStalls{0};
+        std::atomic<uint64_t> txDropped{0};
+    };
+
+    static int linkFd = -1;
+    static RCPShm::Link* shmLink = nullptr;
+    static bool isSocket = false;
+    static int epollFd = -1;
+    // Wakes the I/O thread when output is queued, input space frees up, or it is stopping
+    static int wakeFd = -1;
+    static uint32_t watched = 0;
+    static Options opts;
+    static Counters counters;
+
+    // Both rings and watched are guarded by lock. Without an I/O thread it is never contended.
+    static std::mutex lock;
+    static std::condition_variable changed;
+    static ByteRing txRing;
+    static ByteRing rxRing;
+    static std::thread ioThread;
+    static std::atomic<bool> running{false};
+    // Set by the I/O thread when the link reported a hangup, so it polls instead of spinning on EPOLLHUP
+    static bool hungUp = false;
+    // Set when output was dropped after a stall, until the link takes something again. Guarded by lock.
+    static bool stalled = false;
+
+    // The bytes readAvail() and read() hand out. Only touched by the thread calling yield().
+    static uint8_t chunk[255];
+    static size_t chunkLen = 0;
+    static size_t chunkPos = 0;
+
+    static uint64_t monotonicNanos() {
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000u + now.tv_nsec;
+    }
+
+    static const uint64_t epoch = monotonicNanos();
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    static speed_t baudConstant(uint32_t baud) {
+        switch(baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        default: return B0;
+        }
+    }
+
+    static bool makeRaw(int fd, speed_t speed) {
+        termios tio{};
+        if(tcgetattr(fd, &tio) != 0) return false;
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        if(speed != B0 && (cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0)) return false;
+        return tcsetattr(fd, TCSANOW, &tio) == 0;
+    }
+
+    static int failClose(int fd) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    int openTty(const char* path, uint32_t baud) {
+        speed_t speed = baudConstant(baud);
+        if(speed == B0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if(fd < 0) return -1;
+        if(!makeRaw(fd, speed)) return failClose(fd);
+        return fd;
+    }
+
+    int openPty(std::string& peerPath) {
+        int fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if(fd < 0) return -1;
+
+        char name[128];
+        if(grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, name, sizeof(name)) != 0) return failClose(fd);
+
+        // The line discipline belongs to the peer side, so that is what has to be raw
+        int peer = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if(peer < 0) return failClose(fd);
+        bool raw = makeRaw(peer, B0);
+        close(peer);
+        if(!raw || !setNonBlocking(fd)) return failClose(fd);
+
+        peerPath = name;
+        return fd;
+    }
+
+    static bool unixAddress(const char* path, sockaddr_un& addr) {
+        addr = {};
+        addr.sun_family = AF_UNIX;
+        if(strlen(path) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+
+        strcpy(addr.sun_path, path);
+        return true;
+    }
+
+    int connectUnix(const char* path) {
+        sockaddr_un addr;
+        if(!unixAddress(path, addr)) return -1;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0) return -1;
+        if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return failClose(fd);
+        if(!setNonBlocking(fd)) return failClose(fd);
+        return fd;
+    }
+
+    int acceptUnix(const char* path) {
+        sockaddr_un addr;
+        if(!unixAddress(path, addr)) return -1;
+
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(listener < 0) return -1;
+        if(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+            return failClose(listener);
+        }
+
+        int fd;
+        do fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        while(fd < 0 && errno == EINTR);
+        int saved = errno;
+        close(listener);
+        unlink(path);
+        errno = saved;
+
+        if(fd < 0) return -1;
+        if(!setNonBlocking(fd)) return failClose(fd);
+        return fd;
+    }
+
+    static void wake() {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    }
+
+    static void watch(uint32_t events) {
+        if(events == watched) return;
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = linkFd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, linkFd, &event);
+        watched = events;
+    }
+
+    // Discards everything queued for sending. Called with lock held.
+    static void drop() {
+        counters.txDropped += txRing.used();
+        txRing.consumed(txRing.used());
+        changed.notify_all();
+    }
+
+    // Sends as much of the transmit ring as the link takes right now. Called with lock held.
+    static void transmit() {
+        while(txRing.used() != 0) {
+            iovec iov[2];
+            int count = txRing.filled(iov);
+            ssize_t sent;
+            if(isSocket) {
+                // sendmsg() so a closed peer is an EPIPE error instead of a SIGPIPE
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
+                sent = sendmsg(linkFd, &msg, MSG_NOSIGNAL);
+            }
+
+            else sent = writev(linkFd, iov, count);
+
+            if(sent < 0) {
+                if(errno == EINTR) continue;
+                if(errno != EAGAIN && errno != EWOULDBLOCK) drop();
+                return;
+            }
+
+            counters.writes++;
+            counters.txBytes += sent;
+            stalled = false;
+            txRing.consumed(sent);
+            changed.notify_all();
+        }
+    }
+
+    // Reads what the link has into the receive ring. Called with lock held, on the I/O thread.
+    static void receive() {
+        iovec iov[2];
+        int count = rxRing.empty(iov);
+        if(count == 0) return;
+
+        ssize_t received = readv(linkFd, iov, count);
+        if(received > 0) {
+            counters.reads++;
+            counters.rxBytes += received;
+            rxRing.produced(received);
+            changed.notify_all();
+        }
+
+        // EIO is a pty whose peer is not open
+        else if(received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) hungUp = true;
+    }
+
+    static void ioLoop() {
+        std::unique_lock<std::mutex> guard(lock);
+        while(running) {
+            transmit();
+            receive();
+            watch((rxRing.space() != 0 ? EPOLLIN : 0) | (txRing.used() != 0 ? EPOLLOUT : 0));
+            bool idle = hungUp;
+            hungUp = false;
+            guard.unlock();
+
+            // A hung up link keeps reporting EPOLLHUP, so only wait for a wakeup and retry every so often
+            if(idle) {
+                pollfd pfd = {wakeFd, POLLIN, 0};
+                poll(&pfd, 1, 10);
+            }
+
+            else {
+                epoll_event events[2];
+                epoll_wait(epollFd, events, 2, -1);
+            }
+
+            uint64_t wakeups;
+            [[maybe_unused]] ssize_t drained = ::read(wakeFd, &wakeups, sizeof(wakeups));
+            guard.lock();
+        }
+
+        transmit();
+        changed.notify_all();
+    }
+
+    // Waits up to timeoutMs for the link to become writable. Called with lock held, without an I/O thread.
+    static void waitWritable(int timeoutMs) {
+        watch(EPOLLOUT);
+        epoll_event events[1];
+        epoll_wait(epollFd, events, 1, timeoutMs);
+    }
+
+    // Waits until done(), called with lock held. If the link takes nothing for txTimeoutMs, or the I/O thread is gone,
+    // the pending output is dropped instead, so a stalled peer can not block the target. Once that has happened it
+    // drops without waiting until the link takes something again.
+    template<typename Done>
+    static void waitForLink(std::unique_lock<std::mutex>& guard, Done done) {
+        if(stalled) {
+            transmit();
+            if(!done()) drop();
+            return;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        const auto timeout = std::chrono::milliseconds(opts.txTimeoutMs);
+        uint64_t sent = counters.txBytes;
+        Clock::time_point deadline = Clock::now() + timeout;
+
+        while(!done()) {
+            if(opts.ioThread) {
+                if(!running) break;
+                wake();
+                changed.wait_until(guard, deadline, [&] { return done() || !running || counters.txBytes != sent; });
+            }
+
+            else {
+                transmit();
+                if(done()) return;
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                waitWritable(std::max<int>(1, left));
+                transmit();
+            }
+
+            if(counters.txBytes != sent) {
+                sent = counters.txBytes;
+                deadline = Clock::now() + timeout;
+            }
+
+            else if(Clock::now() >= deadline) break;
+        }
+
+        if(done()) return;
+        stalled = true;
+        drop();
+    }
+
+    bool start(int fd, const Options& options) {
+        if(linkFd >= 0 || fd < 0 || !setNonBlocking(fd)) return false;
+
+        struct stat info{};
+        isSocket = fstat(fd, &info) == 0 && S_ISSOCK(info.st_mode);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollFd < 0) return false;
+        epoll_event event{};
+        event.data.fd = fd;
+        if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(epollFd);
+            epollFd = -1;
+            return false;
+        }
+
+        opts = options;
+        linkFd = fd;
+        counters.rxBytes = counters.txBytes = counters.reads = counters.writes = 0;
+        counters.txStalls = counters.txDropped = 0;
+        watched = 0;
+        hungUp = false;
+        stalled = false;
+        chunkLen = chunkPos = 0;
+        txRing.reset(opts.txBufferSize);
+        rxRing.reset(opts.ioThread ? opts.rxBufferSize : 0);
+
+        if(opts.ioThread) {
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            event.events = EPOLLIN;
+            event.data.fd = wakeFd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+            running = true;
+            ioThread = std::thread(ioLoop);
+        }
+
+        return true;
+    }
+
+    bool start(RCPShm::Link& link, const Options& options) {
+        if(linkFd >= 0 || shmLink != nullptr || !link.isOpen()) return false;
+
+        opts = options;
+        counters.rxBytes = counters.txBytes = counters.reads = counters.writes = 0;
+        counters.txStalls = counters.txDropped = 0;
+        stalled = false;
+        chunkLen = chunkPos = 0;
+        shmLink = &link;
+        return true;
+    }
+
+    void stop() {
+        // Everything written is in the link already
+        shmLink = nullptr;
+        if(linkFd < 0) return;
+
+        if(opts.ioThread) {
+            running = false;
+            wake();
+            ioThread.join();
+            close(wakeFd);
+            wakeFd = -1;
+        }
+
+        else {
+            std::lock_guard<std::mutex> guard(lock);
+            transmit();
+        }
+
+        close(epollFd);
+        epollFd = -1;
+        linkFd = -1;
+    }
+
+    void flush() {
+        if(shmLink != nullptr) {
+            // Waits as long as the host keeps taking something. What is in the link can not be taken back.
+            size_t pending = shmLink->pending();
+            while(pending != 0 && !shmLink->waitSent(opts.txTimeoutMs) && shmLink->pending() < pending) {
+                pending = shmLink->pending();
+            }
+            return;
+        }
+
+        if(linkFd < 0) return;
+        std::unique_lock<std::mutex> guard(lock);
+        waitForLink(guard, [] { return txRing.used() == 0; });
+    }
+
+    bool wait(int timeoutMs) {
+        if(chunkPos != chunkLen) return true;
+        if(shmLink != nullptr) return shmLink->waitReadable(timeoutMs);
+        std::unique_lock<std::mutex> guard(lock);
+        if(opts.ioThread) {
+            auto ready = [] { return rxRing.used() != 0; };
+            if(timeoutMs < 0) {
+                changed.wait(guard, ready);
+                return true;
+            }
+
+            return changed.wait_for(guard, std::chrono::milliseconds(timeoutMs), ready);
+        }
+
+        transmit();
+        watch(EPOLLIN | (txRing.used() != 0 ? EPOLLOUT : 0));
+        epoll_event events[1];
+        int count = epoll_wait(epollFd, events, 1, timeoutMs);
+        return count > 0 && (events[0].events & EPOLLIN) != 0;
+    }
+
+    // Whole packets only, so the host never sees part of one. There are no system calls to batch, so the packet goes
+    // straight into the link.
+    static void queueShm(const void* data, uint8_t length) {
+        if(shmLink->space() < length) {
+            counters.txStalls++;
+            // Waits as long as the host keeps taking something. After a stall drops without waiting until it does.
+            size_t space = shmLink->space();
+            while(!stalled && !shmLink->waitWritable(length, opts.txTimeoutMs) && shmLink->space() > space) {
+                space = shmLink->space();
+            }
+
+            if(shmLink->space() < length) {
+                stalled = true;
+                counters.txDropped += length;
+                return;
+            }
+        }
+
+        stalled = false;
+        shmLink->send(data, length);
+        counters.txBytes += length;
+    }
+
+    static void queue(const void* data, uint8_t length) {
+        if(shmLink != nullptr) return queueShm(data, length);
+        if(linkFd < 0) return;
+        const auto* bytes = static_cast<const uint8_t*>(data);
+
+        std::unique_lock<std::mutex> guard(lock);
+        // The I/O thread only sleeps with an empty ring, so it only needs waking for the first packet of a batch
+        if(opts.ioThread && txRing.used() == 0) wake();
+
+        while(true) {
+            size_t copied = txRing.push(bytes, length);
+            bytes += copied;
+            length -= copied;
+            if(length == 0) return;
+
+            counters.txStalls++;
+            waitForLink(guard, [] { return txRing.space() != 0; });
+        }
+    }
+
+    static uint8_t available() {
+        if(chunkPos != chunkLen) return chunkLen - chunkPos;
+        chunkPos = chunkLen = 0;
+        if(shmLink != nullptr) {
+            chunkLen = shmLink->receive(chunk, sizeof(chunk));
+            counters.rxBytes += chunkLen;
+            return chunkLen;
+        }
+
+        if(linkFd < 0) return 0;
+
+        std::unique_lock<std::mutex> guard(lock);
+        if(opts.ioThread) {
+            bool full = rxRing.space() == 0;
+            chunkLen = rxRing.pop(chunk, sizeof(chunk));
+            // The I/O thread stops reading while the ring is full
+            if(full && chunkLen != 0) wake();
+        }
+
+        else {
+            // Output queued during the previous loop goes out in one batch
+            transmit();
+            ssize_t received = ::read(linkFd, chunk, sizeof(chunk));
+            if(received > 0) {
+                counters.reads++;
+                counters.rxBytes += received;
+                chunkLen = received;
+            }
+        }
+
+        return chunkLen;
+    }
+
+    Stats getStats() {
+        return {counters.rxBytes, counters.txBytes, counters.reads, counters.writes, counters.txStalls,
+                counters.txDropped};
+    }
+} // namespace RCPPosix
+
+namespace RCP {
+    void write(const void* data, uint8_t length) { RCPPosix::queue(data, length); }
+
+    uint8_t readAvail() { return RCPPosix::available(); }
+
+    uint8_t read() { return RCPPosix::chunkPos < RCPPosix::chunkLen ? RCPPosix::chunk[RCPPosix::chunkPos++] : 0; }
+
+    uint32_t systime() { return (RCPPosix::monotonicNanos() - RCPPosix::epoch) / 1000000; }
+
+    uint32_t systimeMicros() { return (RCPPosix::monotonicNanos() - RCPPosix::epoch) / 1000; }
+} // namespace RCP
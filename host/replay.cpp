@@ -0,0 +1,90 @@
+#include "RCP_Host/replay.h"
+
+#include <chrono>
+#include <thread>
+
+namespace RCPReplay {
+    static const uint8_t* rxData = nullptr;
+    static uint32_t rxLength = 0;
+    static uint32_t rxPos = 0;
+    static uint64_t txBytes = 0;
+    static uint64_t now = 0;
+
+    double Result::bytesPerSecond() const { return seconds > 0 ? rxBytes / seconds : 0; }
+
+    Result replay(const RCPCapture::Reader& capture, const Options& options) {
+        using Clock = std::chrono::steady_clock;
+
+        Result result{};
+        RCPCapture::Reader::Cursor cursor = capture.seek(options.from);
+        RCPCapture::Chunk chunk{};
+
+        txBytes = 0;
+        now = options.from;
+        RCP::init();
+        RCP::channel = options.channel;
+
+        Clock::time_point start = Clock::now();
+        bool first = true;
+        uint64_t firstTime = 0;
+
+        while(cursor.next(chunk)) {
+            result.chunks++;
+            if(chunk.direction == RCPCapture::CAPTURE_TX) {
+                result.recordedTxBytes += chunk.length;
+                continue;
+            }
+
+            if(first) {
+                first = false;
+                firstTime = chunk.time;
+            }
+
+            now = chunk.time;
+            if(options.speed == REPLAY_REAL_TIME) {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(chunk.time - firstTime));
+            }
+
+            rxData = chunk.data;
+            rxLength = chunk.length;
+            rxPos = 0;
+            result.rxBytes += chunk.length;
+
+            // Until the chunk is read and yield() stops making progress on what is left in the buffer. A packet split
+            // across chunks stays in the buffer until the next one.
+            while(true) {
+                bool reading = rxPos < rxLength;
+                uint16_t buffered = RCP::rxBuffered();
+                RCP::yield();
+                result.yields++;
+                if(options.runTests) RCP::runTest();
+                if(!reading && RCP::rxBuffered() == buffered) break;
+            }
+        }
+
+        rxData = nullptr;
+        rxLength = 0;
+        rxPos = 0;
+        result.txBytes = txBytes;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return result;
+    }
+} // namespace RCPReplay
+
+namespace RCP {
+    void write([[maybe_unused]] const void* data, uint8_t length) { RCPReplay::txBytes += length; }
+
+    uint8_t readAvail() {
+        uint32_t left = RCPReplay::rxLength - RCPReplay::rxPos;
+        return left > 255 ? 255 : left;
+    }
+
+    uint8_t read() {
+        if(RCPReplay::rxPos >= RCPReplay::rxLength) return 0;
+        return RCPReplay::rxData[RCPReplay::rxPos++];
+    }
+
+    uint32_t systime() { return RCPReplay::now / 1000; }
+
+    uint32_t systimeMicros() { return RCPReplay::now; }
+} // namespace RCP
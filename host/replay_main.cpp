@@ -0,0 +1,48 @@
+/*
+ * Replays a capture into the target library and reports parse throughput.
+ *
+ *     RCPT_ReplayTool capture.bin [--real-time] [--no-tests] [--repeat N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RCP_Host/replay.h"
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s capture [--real-time] [--no-tests] [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+    RCPReplay::Options options;
+    int repeat = 1;
+    for(int i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "--real-time") == 0) options.speed = RCPReplay::REPLAY_REAL_TIME;
+        else if(strcmp(argv[i], "--no-tests") == 0) options.runTests = false;
+        else if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    RCPCapture::Reader capture(argv[1]);
+    if(!capture.isOpen()) {
+        fprintf(stderr, "Could not read capture %s\n", argv[1]);
+        return 1;
+    }
+
+    if(!capture.isIndexed()) fprintf(stderr, "Capture was not closed, reading it without an index\n");
+
+    for(int i = 0; i < repeat; i++) {
+        RCPReplay::Result result = RCPReplay::replay(capture, options);
+        printf("chunks %llu, rx bytes %llu, yields %llu, tx bytes %llu (recorded %llu), %.3f s, %.2f MB/s\n",
+               static_cast<unsigned long long>(result.chunks), static_cast<unsigned long long>(result.rxBytes),
+               static_cast<unsigned long long>(result.yields), static_cast<unsigned long long>(result.txBytes),
+               static_cast<unsigned long long>(result.recordedTxBytes), result.seconds,
+               result.bytesPerSecond() / 1e6);
+    }
+
+    return 0;
+}
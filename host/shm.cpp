@@ -0,0 +1,283 @@
+#include "RCP_Host/shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+namespace RCPShm {
+    static constexpr uint32_t MAGIC = 0x52435053;
+    // How long a wait spins before it goes to sleep on the futex. On a single CPU the peer can not make progress
+    // while this side spins, so there it sleeps right away.
+    static const uint64_t spinNanos = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 20000 : 0;
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex words have to be plain 32 bit atomics");
+
+    // A ring counter and the flag its waiter sets before sleeping on it. head is advanced by the producer and tail by
+    // the consumer, so each gets its own cache line.
+    struct alignas(64) Link::Counter {
+        std::atomic<uint32_t> value;
+        std::atomic<uint32_t> waiting;
+    };
+
+    struct Link::Ring {
+        Counter head;
+        Counter tail;
+    };
+
+    // rings[i] is sent by side i. The ring data follows the region, rings[0] first.
+    struct alignas(64) Link::Region {
+        uint32_t magic;
+        uint32_t ringSize;
+        std::atomic<uint32_t> closed[2];
+        Ring rings[2];
+    };
+
+    static uint64_t monotonicNanos() {
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000u + now.tv_nsec;
+    }
+
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Not FUTEX_PRIVATE_FLAG, since the word is shared with another process
+    static long futex(std::atomic<uint32_t>& word, int op, uint32_t val, const timespec* timeout) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val, timeout, nullptr, 0);
+    }
+
+    Link::~Link() { close(); }
+
+    bool Link::map(int fd, size_t size) {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(addr == MAP_FAILED) return false;
+        region = static_cast<Region*>(addr);
+        mapped = size;
+        memFd = fd;
+        return true;
+    }
+
+    uint8_t* Link::data(uint8_t ring) const {
+        return reinterpret_cast<uint8_t*>(region) + sizeof(Region) + static_cast<size_t>(ring) * region->ringSize;
+    }
+
+    bool Link::create(const char* shmName, size_t ringSize) {
+        if(region != nullptr || ringSize == 0 || ringSize > (1u << 30)) return false;
+        if(shmName != nullptr && strlen(shmName) >= sizeof(name)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+
+        uint32_t size = 64;
+        while(size < ringSize) size <<= 1;
+
+        int fd = shmName != nullptr ? shm_open(shmName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)
+                                    : memfd_create("rcp_shm", MFD_CLOEXEC);
+        if(fd < 0) return false;
+
+        size_t total = sizeof(Region) + 2 * static_cast<size_t>(size);
+        if(ftruncate(fd, total) != 0 || !map(fd, total)) {
+            int saved = errno;
+            ::close(fd);
+            if(shmName != nullptr) shm_unlink(shmName);
+            errno = saved;
+            return false;
+        }
+
+        new(region) Region{};
+        region->magic = MAGIC;
+        region->ringSize = size;
+
+        side = 0;
+        if(shmName != nullptr) strcpy(name, shmName);
+        sleeps = wakeups = sent = received = 0;
+        return true;
+    }
+
+    bool Link::open(const char* shmName) {
+        if(region != nullptr) return false;
+        int fd = shm_open(shmName, O_RDWR | O_CLOEXEC, 0);
+        if(fd < 0) return false;
+        bool attached = attach(fd);
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return attached;
+    }
+
+    bool Link::attach(int fd) {
+        struct stat info{};
+        if(region != nullptr || fstat(fd, &info) != 0) return false;
+        if(static_cast<size_t>(info.st_size) < sizeof(Region) || !map(fd, info.st_size)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        if(region->magic != MAGIC || sizeof(Region) + 2 * static_cast<size_t>(region->ringSize) > mapped) {
+            munmap(region, mapped);
+            region = nullptr;
+            memFd = -1;
+            errno = EINVAL;
+            return false;
+        }
+
+        memFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        side = 1;
+        name[0] = '\0';
+        sleeps = wakeups = sent = received = 0;
+        return true;
+    }
+
+    void Link::close() {
+        if(region == nullptr) return;
+
+        region->closed[side].store(1);
+        // Whatever the peer is waiting on, it has to notice
+        for(Ring& ring : region->rings) {
+            futex(ring.head.value, FUTEX_WAKE, INT_MAX, nullptr);
+            futex(ring.tail.value, FUTEX_WAKE, INT_MAX, nullptr);
+        }
+
+        munmap(region, mapped);
+        region = nullptr;
+        ::close(memFd);
+        memFd = -1;
+        if(name[0] != '\0') shm_unlink(name);
+        name[0] = '\0';
+    }
+
+    bool Link::peerClosed() const { return region == nullptr || region->closed[1 - side].load() != 0; }
+
+    // Called after counter.value changed. The fence pairs with the one in waitOn(): either the waiter sees the new
+    // value before it sleeps, or this sees its flag and wakes it.
+    void Link::notify(Counter& counter) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(counter.waiting.load(std::memory_order_relaxed) == 0 || counter.waiting.exchange(0) == 0) return;
+        wakeups++;
+        futex(counter.value, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+    template<typename Ready>
+    bool Link::waitOn(Counter& counter, Ready ready, int timeoutMs) {
+        uint64_t start = monotonicNanos();
+        while(!ready()) {
+            if(peerClosed()) return false;
+            if(monotonicNanos() - start >= spinNanos) break;
+            cpuRelax();
+        }
+
+        while(!ready()) {
+            if(peerClosed()) return false;
+
+            timespec timeout{};
+            if(timeoutMs >= 0) {
+                uint64_t elapsed = monotonicNanos() - start;
+                uint64_t limit = static_cast<uint64_t>(timeoutMs) * 1000000u;
+                if(elapsed >= limit) return false;
+                timeout.tv_sec = (limit - elapsed) / 1000000000u;
+                timeout.tv_nsec = (limit - elapsed) % 1000000000u;
+            }
+
+            uint32_t seen = counter.value.load();
+            counter.waiting.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(ready() || peerClosed()) {
+                counter.waiting.store(0);
+                continue;
+            }
+
+            // Returns right away if the counter moved since it was read
+            sleeps++;
+            futex(counter.value, FUTEX_WAIT, seen, timeoutMs >= 0 ? &timeout : nullptr);
+            counter.waiting.store(0);
+        }
+
+        return true;
+    }
+
+    size_t Link::send(const void* src, size_t length) {
+        if(region == nullptr) return 0;
+        Ring& ring = region->rings[side];
+        uint32_t head = ring.head.value.load(std::memory_order_relaxed);
+        uint32_t tail = ring.tail.value.load(std::memory_order_acquire);
+        size_t count = std::min<size_t>(length, region->ringSize - (head - tail));
+        if(count == 0) return 0;
+
+        uint32_t start = head & (region->ringSize - 1);
+        size_t first = std::min<size_t>(count, region->ringSize - start);
+        memcpy(data(side) + start, src, first);
+        memcpy(data(side), static_cast<const uint8_t*>(src) + first, count - first);
+
+        ring.head.value.store(head + count, std::memory_order_release);
+        notify(ring.head);
+        sent += count;
+        return count;
+    }
+
+    size_t Link::receive(void* dst, size_t length) {
+        if(region == nullptr) return 0;
+        Ring& ring = region->rings[1 - side];
+        uint32_t tail = ring.tail.value.load(std::memory_order_relaxed);
+        uint32_t head = ring.head.value.load(std::memory_order_acquire);
+        size_t count = std::min<size_t>(length, head - tail);
+        if(count == 0) return 0;
+
+        uint32_t start = tail & (region->ringSize - 1);
+        size_t first = std::min<size_t>(count, region->ringSize - start);
+        memcpy(dst, data(1 - side) + start, first);
+        memcpy(static_cast<uint8_t*>(dst) + first, data(1 - side), count - first);
+
+        ring.tail.value.store(tail + count, std::memory_order_release);
+        notify(ring.tail);
+        received += count;
+        return count;
+    }
+
+    size_t Link::available() const {
+        if(region == nullptr) return 0;
+        const Ring& ring = region->rings[1 - side];
+        return ring.head.value.load(std::memory_order_acquire) - ring.tail.value.load(std::memory_order_relaxed);
+    }
+
+    size_t Link::pending() const {
+        if(region == nullptr) return 0;
+        const Ring& ring = region->rings[side];
+        return ring.head.value.load(std::memory_order_relaxed) - ring.tail.value.load(std::memory_order_acquire);
+    }
+
+    size_t Link::space() const { return region == nullptr ? 0 : region->ringSize - pending(); }
+
+    bool Link::waitReadable(int timeoutMs) {
+        if(region == nullptr) return false;
+        return waitOn(region->rings[1 - side].head, [this] { return available() != 0; }, timeoutMs) ||
+               available() != 0;
+    }
+
+    bool Link::waitWritable(size_t bytes, int timeoutMs) {
+        if(region == nullptr || bytes > region->ringSize) return false;
+        return waitOn(region->rings[side].tail, [&] { return space() >= bytes; }, timeoutMs);
+    }
+
+    bool Link::waitSent(int timeoutMs) {
+        if(region == nullptr) return false;
+        return waitOn(region->rings[side].tail, [this] { return pending() == 0; }, timeoutMs);
+    }
+
+    Stats Link::getStats() const { return {sent, received, sleeps, wakeups}; }
+} // namespace RCPShm
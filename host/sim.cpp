@@ -0,0 +1,481 @@
+#include "RCP_Host/sim.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace RCPSim {
+    static Simulator* current = nullptr;
+
+    static const char* stateName(RCP_TestRunningState state) {
+        switch(state) {
+        case RCP_TEST_RUNNING:
+            return "RUNNING";
+        case RCP_TEST_STOPPED:
+            return "STOPPED";
+        case RCP_TEST_PAUSED:
+            return "PAUSED";
+        case RCP_TEST_ESTOP:
+            return "ESTOP";
+        default:
+            return "?";
+        }
+    }
+
+    void Plant::advance([[maybe_unused]] uint32_t now) {}
+
+    uint32_t Plant::nextEvent([[maybe_unused]] uint32_t now) { return NO_EVENT; }
+
+    SimpleActuatorPlant::SimpleActuatorPlant(uint32_t travelTime) : travelTime(travelTime) {
+        for(auto& act : actuators) act = {RCP_SIMPLE_ACTUATOR_OFF, RCP_SIMPLE_ACTUATOR_OFF, 0};
+    }
+
+    RCP_SimpleActuatorState SimpleActuatorPlant::write(uint8_t id, RCP_SimpleActuatorState state, uint32_t now) {
+        Actuator& act = actuators[id];
+        if(state == RCP_SIMPLE_ACTUATOR_TOGGLE)
+            state = act.target == RCP_SIMPLE_ACTUATOR_ON ? RCP_SIMPLE_ACTUATOR_OFF : RCP_SIMPLE_ACTUATOR_ON;
+
+        act.target = state;
+        act.arrival = now + travelTime;
+        if(travelTime == 0) act.state = state;
+        return act.state;
+    }
+
+    RCP_SimpleActuatorState SimpleActuatorPlant::read(uint8_t id) { return actuators[id].state; }
+
+    void SimpleActuatorPlant::advance(uint32_t now) {
+        for(auto& act : actuators) {
+            if(act.state != act.target && now >= act.arrival) act.state = act.target;
+        }
+    }
+
+    uint32_t SimpleActuatorPlant::nextEvent(uint32_t now) {
+        uint32_t next = NO_EVENT;
+        for(const auto& act : actuators) {
+            if(act.state != act.target && act.arrival > now) next = std::min(next, act.arrival);
+        }
+
+        return next;
+    }
+
+    StepperPlant::StepperPlant(float maxSpeed) : maxSpeed(maxSpeed), lastUpdate(0) {
+        for(auto& step : steppers) step = {0, 0, 0, true};
+    }
+
+    RCP::Floats2 StepperPlant::write(uint8_t id, RCP_StepperControlMode mode, float value, uint32_t now) {
+        advance(now);
+        Stepper& step = steppers[id];
+        switch(mode) {
+        case RCP_STEPPER_ABSOLUTE_POS_CONTROL:
+            step.positionControl = true;
+            step.target = value;
+            break;
+
+        case RCP_STEPPER_RELATIVE_POS_CONTROL:
+            step.positionControl = true;
+            step.target = step.position + value;
+            break;
+
+        case RCP_STEPPER_SPEED_CONTROL:
+            step.positionControl = false;
+            step.speed = value;
+            break;
+        }
+
+        return read(id);
+    }
+
+    RCP::Floats2 StepperPlant::read(uint8_t id) { return {steppers[id].position, steppers[id].speed}; }
+
+    void StepperPlant::advance(uint32_t now) {
+        if(now <= lastUpdate) return;
+        float dt = static_cast<float>(now - lastUpdate) / 1000.0f;
+        lastUpdate = now;
+
+        for(auto& step : steppers) {
+            if(!step.positionControl) {
+                step.position += step.speed * dt;
+                continue;
+            }
+
+            float remaining = step.target - step.position;
+            float travel = maxSpeed * dt;
+            if(fabsf(remaining) <= travel) {
+                step.position = step.target;
+                step.speed = 0;
+            }
+
+            else {
+                step.speed = remaining > 0 ? maxSpeed : -maxSpeed;
+                step.position += step.speed * dt;
+            }
+        }
+    }
+
+    uint32_t StepperPlant::nextEvent(uint32_t now) {
+        float longest = 0;
+        for(const auto& step : steppers) {
+            if(!step.positionControl || step.position == step.target) continue;
+            longest = std::max(longest, fabsf(step.target - step.position) / maxSpeed);
+        }
+
+        if(longest == 0) return NO_EVENT;
+        return now + std::max(1u, static_cast<uint32_t>(ceilf(longest * 1000.0f)));
+    }
+
+    MotorPlant::MotorPlant(float slewRate) : slewRate(slewRate), lastUpdate(0) {
+        for(auto& motor : motors) motor = {0, 0};
+    }
+
+    float MotorPlant::write(uint8_t id, float value, uint32_t now) {
+        advance(now);
+        motors[id].target = value;
+        if(slewRate == 0) motors[id].value = value;
+        return motors[id].value;
+    }
+
+    float MotorPlant::read(uint8_t id) { return motors[id].value; }
+
+    void MotorPlant::advance(uint32_t now) {
+        if(now <= lastUpdate) return;
+        float slew = slewRate * static_cast<float>(now - lastUpdate) / 1000.0f;
+        lastUpdate = now;
+
+        for(auto& motor : motors) {
+            float diff = motor.target - motor.value;
+            if(fabsf(diff) <= slew) motor.value = motor.target;
+            else motor.value += diff > 0 ? slew : -slew;
+        }
+    }
+
+    uint32_t MotorPlant::nextEvent(uint32_t now) {
+        if(slewRate == 0) return NO_EVENT;
+        float longest = 0;
+        for(const auto& motor : motors) longest = std::max(longest, fabsf(motor.target - motor.value) / slewRate);
+
+        if(longest == 0) return NO_EVENT;
+        return now + std::max(1u, static_cast<uint32_t>(ceilf(longest * 1000.0f)));
+    }
+
+    float ValuePlant::writeAngled(uint8_t id, float value, [[maybe_unused]] uint32_t now) {
+        angles[id] = value;
+        return value;
+    }
+
+    float ValuePlant::readAngled(uint8_t id) { return angles[id]; }
+
+    uint8_t ValuePlant::writeDiscrete(uint8_t id, uint8_t state, [[maybe_unused]] uint32_t now) {
+        discretes[id] = state;
+        return state;
+    }
+
+    uint8_t ValuePlant::readDiscrete(uint8_t id) { return discretes[id]; }
+
+    RCP::Floats4 SensorPlant::read([[maybe_unused]] RCP_DeviceClass devclass, [[maybe_unused]] uint8_t id,
+                                   [[maybe_unused]] uint32_t now) {
+        return {};
+    }
+
+    bool SensorPlant::readBool([[maybe_unused]] uint8_t id, [[maybe_unused]] uint32_t now) { return false; }
+
+    Simulator::Simulator(const Plants& plants) :
+        plants(plants), now(0), maxStep(10), autoPrompt(false), promptResponse(), promptDelay(0),
+        promptType(RCP_PromptDataType_GONOGO), reportedState(RCP_TEST_STOPPED), runsReported(0) {
+        if(!this->plants.simpleActuators) this->plants.simpleActuators = &defaultSimpleActuators;
+        if(!this->plants.steppers) this->plants.steppers = &defaultSteppers;
+        if(!this->plants.motors) this->plants.motors = &defaultMotors;
+        if(!this->plants.values) this->plants.values = &defaultValues;
+        if(!this->plants.sensors) this->plants.sensors = &defaultSensors;
+
+        current = this;
+        reset();
+    }
+
+    Simulator::~Simulator() {
+        if(current == this) current = nullptr;
+    }
+
+    void Simulator::reset() {
+        now = 0;
+        wakeups = {};
+        injections.clear();
+        rx.clear();
+        tx.clear();
+        timeline.clear();
+        reportedState = RCP_TEST_STOPPED;
+        runsReported = 0;
+
+        RCP::init();
+        RCP::setReady(true);
+        processTx();
+    }
+
+    void Simulator::setMaxStep(uint32_t ms) { maxStep = std::max(1u, ms); }
+
+    void Simulator::setAutoPrompt(RCP::PromptData response, uint32_t delay) {
+        autoPrompt = true;
+        promptResponse = response;
+        promptDelay = delay;
+    }
+
+    void Simulator::inject(const std::vector<uint8_t>& packet, uint32_t delay) {
+        Injection inj{now + delay, packet};
+        auto pos = std::upper_bound(injections.begin(), injections.end(), inj.time,
+                                    [](uint32_t time, const Injection& other) { return time < other.time; });
+        injections.insert(pos, std::move(inj));
+    }
+
+    void Simulator::startTest(uint8_t testNum, uint32_t delay) {
+        inject({static_cast<uint8_t>(RCP::channel | 1), RCP_DEVCLASS_TEST_STATE,
+                static_cast<uint8_t>(RCP_TEST_START | (testNum & 0x0F))},
+               delay);
+    }
+
+    void Simulator::stopTest(uint32_t delay) {
+        inject({static_cast<uint8_t>(RCP::channel | 1), RCP_DEVCLASS_TEST_STATE, RCP_TEST_STOP}, delay);
+    }
+
+    void Simulator::deliverInjections() {
+        while(!injections.empty() && injections.front().time <= now) {
+            const auto& bytes = injections.front().bytes;
+            rx.insert(rx.end(), bytes.begin(), bytes.end());
+            injections.pop_front();
+        }
+    }
+
+    void Simulator::step() {
+        deliverInjections();
+        RCP::yield();
+        RCP::runTest();
+        processTx();
+        advanceTo(nextTime());
+    }
+
+    void Simulator::runFor(uint32_t duration) {
+        uint32_t end = now + duration;
+        while(now < end) step();
+    }
+
+    Result Simulator::runTest(uint8_t testNum, uint32_t timeLimit) {
+        uint32_t start = now;
+        uint32_t runs = runsReported;
+        uint32_t steps = 0;
+        startTest(testNum);
+
+        while(now - start < timeLimit) {
+            step();
+            steps++;
+
+            RCP_TestRunningState state = RCP::getTestState();
+            bool estopDone = state == RCP_TEST_ESTOP && RCP::ESTOP_PROC == nullptr;
+            if(runsReported != runs && (state == RCP_TEST_STOPPED || estopDone)) return {true, state, now, steps};
+        }
+
+        return {false, RCP::getTestState(), now, steps};
+    }
+
+    uint32_t Simulator::nextTime() {
+        while(!wakeups.empty() && wakeups.top() <= now) wakeups.pop();
+
+        uint32_t next = NO_EVENT;
+        if(!wakeups.empty()) next = wakeups.top();
+        if(!injections.empty()) next = std::min(next, injections.front().time);
+        next = std::min(next, plants.simpleActuators->nextEvent(now));
+        next = std::min(next, plants.steppers->nextEvent(now));
+        next = std::min(next, plants.motors->nextEvent(now));
+        next = std::min(next, plants.values->nextEvent(now));
+        next = std::min(next, plants.sensors->nextEvent(now));
+        if(next == NO_EVENT) next = now + maxStep;
+
+        // Unread host input is handled at loop speed
+        if(!rx.empty()) next = now;
+        return std::max(next, now + 1);
+    }
+
+    void Simulator::advanceTo(uint32_t time) {
+        now = time;
+        plants.simpleActuators->advance(now);
+        plants.steppers->advance(now);
+        plants.motors->advance(now);
+        plants.values->advance(now);
+        plants.sensors->advance(now);
+    }
+
+    void Simulator::processTx() {
+        size_t pos = 0;
+        while(tx.size() - pos >= 2) {
+            const uint8_t* pkt = tx.data() + pos;
+            size_t len = pkt[0] & ~RCP_CHANNEL_MASK;
+            if(tx.size() - pos < len + 2) break;
+            pos += len + 2;
+
+            switch(pkt[1]) {
+            case RCP_DEVCLASS_TEST_STATE: {
+                if(len < 5) break;
+                auto state = static_cast<RCP_TestRunningState>(pkt[6] & RCP_TEST_STATE_MASK);
+                if(state == reportedState) break;
+                if(state == RCP_TEST_RUNNING && reportedState == RCP_TEST_STOPPED) runsReported++;
+                reportedState = state;
+                note(std::string("test ") + std::to_string(RCP::getTestNum()) + " " + stateName(state));
+                break;
+            }
+
+            case RCP_DEVCLASS_PROMPT: {
+                if(pkt[2] == RCP_PromptDataType_RESET) {
+                    note("prompt reset");
+                    break;
+                }
+
+                promptType = static_cast<RCP_PromptDataType>(pkt[2]);
+                note("prompt: " + std::string(reinterpret_cast<const char*>(pkt + 3), len - 1));
+                if(!autoPrompt) break;
+
+                if(promptType == RCP_PromptDataType_GONOGO) {
+                    inject({static_cast<uint8_t>(RCP::channel | 1), RCP_DEVCLASS_PROMPT,
+                            static_cast<uint8_t>(promptResponse.boolData)},
+                           promptDelay);
+                }
+
+                else {
+                    std::vector<uint8_t> resp = {static_cast<uint8_t>(RCP::channel | 4), RCP_DEVCLASS_PROMPT, 0, 0, 0,
+                                                 0};
+                    memcpy(resp.data() + 2, &promptResponse.floatData, 4);
+                    inject(resp, promptDelay);
+                }
+
+                break;
+            }
+
+            case RCP_DEVCLASS_CUSTOM:
+                note("message: " + std::string(reinterpret_cast<const char*>(pkt + 2), len));
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        tx.erase(tx.begin(), tx.begin() + static_cast<long>(pos));
+    }
+
+    uint32_t Simulator::time() const { return now; }
+
+    const std::vector<TimelineEvent>& Simulator::getTimeline() const { return timeline; }
+
+    void Simulator::note(const std::string& text) { timeline.push_back({now, text}); }
+
+    void Simulator::printTimeline(FILE* out) const {
+        for(const auto& event : timeline) {
+            fprintf(out, "[%4u:%02u.%03u] %s\n", event.time / 60000, event.time / 1000 % 60, event.time % 1000,
+                    event.text.c_str());
+        }
+    }
+
+    Simulator* Simulator::active() { return current; }
+
+    Plants& Simulator::getPlants() { return plants; }
+
+    void Simulator::wakeAt(uint32_t time) {
+        if(time > now) wakeups.push(time);
+    }
+
+    uint8_t Simulator::rxAvailable() const { return static_cast<uint8_t>(std::min<size_t>(rx.size(), 255)); }
+
+    uint8_t Simulator::rxRead() {
+        if(rx.empty()) return 0;
+        uint8_t val = rx.front();
+        rx.pop_front();
+        return val;
+    }
+
+    void Simulator::txWrite(const void* data, uint8_t length) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        tx.insert(tx.end(), bytes, bytes + length);
+    }
+} // namespace RCPSim
+
+using RCPSim::Simulator;
+
+namespace RCP {
+    void write(const void* data, uint8_t length) {
+        if(Simulator::active()) Simulator::active()->txWrite(data, length);
+    }
+
+    uint8_t readAvail() { return Simulator::active() ? Simulator::active()->rxAvailable() : 0; }
+
+    uint8_t read() { return Simulator::active() ? Simulator::active()->rxRead() : 0; }
+
+    uint32_t systime() { return Simulator::active() ? Simulator::active()->time() : 0; }
+
+    // Procedures report deadlines in millis() time, the simulator clock is in systime() time
+    void scheduleWakeup(uint32_t time) {
+        if(Simulator::active()) Simulator::active()->wakeAt(time + (systime() - millis()));
+    }
+
+    RCP_SimpleActuatorState readSimpleActuator(uint8_t id) {
+        if(!Simulator::active()) return RCP_SIMPLE_ACTUATOR_OFF;
+        return Simulator::active()->getPlants().simpleActuators->read(id);
+    }
+
+    RCP_SimpleActuatorState simpleActuatorWrite_CLBK(uint8_t id, RCP_SimpleActuatorState state) {
+        Simulator* sim = Simulator::active();
+        if(!sim) return RCP_SIMPLE_ACTUATOR_OFF;
+        sim->note("simple actuator " + std::to_string(id) + " " +
+                  (state == RCP_SIMPLE_ACTUATOR_ON ? "ON" : state == RCP_SIMPLE_ACTUATOR_OFF ? "OFF" : "TOGGLE"));
+        return sim->getPlants().simpleActuators->write(id, state, sim->time());
+    }
+
+    uint8_t readDiscreteActuator(uint8_t id) {
+        return Simulator::active() ? Simulator::active()->getPlants().values->readDiscrete(id) : 0;
+    }
+
+    uint8_t discreteActuatorWrite_CLBK(uint8_t id, uint8_t state) {
+        Simulator* sim = Simulator::active();
+        if(!sim) return 0;
+        sim->note("discrete actuator " + std::to_string(id) + " " + std::to_string(state));
+        return sim->getPlants().values->writeDiscrete(id, state, sim->time());
+    }
+
+    Floats2 readStepper(uint8_t id) {
+        return Simulator::active() ? Simulator::active()->getPlants().steppers->read(id) : Floats2{};
+    }
+
+    Floats2 stepperWrite_CLBK(uint8_t id, RCP_StepperControlMode controlMode, float controlVal) {
+        Simulator* sim = Simulator::active();
+        if(!sim) return {};
+        sim->note("stepper " + std::to_string(id) + " mode " + std::to_string(controlMode) + " " +
+                  std::to_string(controlVal));
+        return sim->getPlants().steppers->write(id, controlMode, controlVal, sim->time());
+    }
+
+    float readMotor(uint8_t id) { return Simulator::active() ? Simulator::active()->getPlants().motors->read(id) : 0; }
+
+    float motorWrite_CLBK(uint8_t id, float value) {
+        Simulator* sim = Simulator::active();
+        if(!sim) return 0;
+        sim->note("motor " + std::to_string(id) + " " + std::to_string(value));
+        return sim->getPlants().motors->write(id, value, sim->time());
+    }
+
+    float readAngledActuator(uint8_t id) {
+        return Simulator::active() ? Simulator::active()->getPlants().values->readAngled(id) : 0;
+    }
+
+    float angledActuatorWrite_CLBK(uint8_t id, float controlVal) {
+        Simulator* sim = Simulator::active();
+        if(!sim) return 0;
+        sim->note("angled actuator " + std::to_string(id) + " " + std::to_string(controlVal));
+        return sim->getPlants().values->writeAngled(id, controlVal, sim->time());
+    }
+
+    Floats4 readSensor(RCP_DeviceClass devclass, uint8_t id) {
+        Simulator* sim = Simulator::active();
+        return sim ? sim->getPlants().sensors->read(devclass, id, sim->time()) : Floats4{};
+    }
+
+    bool readBoolSensor(uint8_t id) {
+        Simulator* sim = Simulator::active();
+        return sim && sim->getPlants().sensors->readBool(id, sim->time());
+    }
+} // namespace RCP
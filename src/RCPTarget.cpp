@@ -11,13 +11,29 @@
  * the prompt data. It is up to the prompt acceptor to know what data type is present in the memory region.
  *
  * In this implementation, the testing framework is used for executing the emergency stop sequence. The
- * sequence can be defined by changing the ESTOP_PROC variable.
+ * sequence can be defined by changing the ESTOP_PROC variable. ESTOP() calls ESTOP_ACTION synchronously before
+ * anything else, takes the ESTOP_PROC set at that moment, and initializes it right away. Until it finishes, runTest()
+ * runs nothing but the ESTOP procedure.
+ *
+ * Tests run in one of TEST_SLOTS slots, each with its own state. A plain test start only works while every slot is
+ * stopped and always uses slot 0, exactly like a single slot target. RCP_TEST_START_CONCURRENT starts a test in the
+ * next free slot alongside the ones already running, and RCP_TEST_STOP_ONE/RCP_TEST_PAUSE_ONE address a single
+ * test. Stop, pause and ESTOP apply to every slot. The ESTOP procedure runs in slot 0. The test state packet only
+ * carries the combined state; while more than one test is active it is followed by an RCP_DIAG_TEST_SLOTS packet.
  */
 #include <string.h>
 
 #include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/aggregation.h"
 
-#include "RCP_Target/procedures.h"
+#include "RCP_Target/channels.h"
+#include "RCP_Target/diagnostics.h"
+#include "RCP_Target/framing.h"
+#include "RCP_Target/redlines.h"
+#include "RCP_Target/router.h"
+#include "RCP_Target/stats.h"
+#include "RCP_Target/trace.h"
+#include "RCP_Target/transports.h"
 
 #ifndef __GNUG__
 #error "This code uses GCC weak symbols, therefore a GCC compiler must be used"
@@ -25,25 +41,177 @@
 
 namespace RCP {
     RCP_Channel channel;
+#if RCPT_PROCEDURES
     Test::Procedure* ESTOP_PROC = nullptr;
+#endif
+    EstopAction ESTOP_ACTION = nullptr;
+    EstopAction ESTOP_ISR_ACTION = nullptr;
 
     static LRI::RingBuf<uint8_t, RCP_SERIAL_BUFFER_SIZE> inbuffer;
 
-    static uint8_t testNum;
-    static RCP_TestRunningState testState;
-    static bool dataStreaming;
-    static bool ready = false;
-    static uint8_t heartbeatTime;
-    static uint32_t lastHeartbeatReceived;
+    // Everything that is kept per channel served (see channels.h)
+    struct ChannelState {
+        TestSlot slots[TEST_SLOTS];
+#if RCPT_PROCEDURES
+        uint8_t nextSlot;
+#endif
+        bool dataStreaming;
+        bool ready = false;
+        uint8_t heartbeatTime;
+        // Read by checkHeartbeat(), which may run in an interrupt
+        volatile uint32_t heartbeatTimeout;
+        volatile uint32_t lastHeartbeatReceived;
+        volatile bool watchdogTripped;
+        volatile bool watchdogPending;
+        RCP_HeartbeatEcho heartbeatEcho = RCP_HEARTBEAT_ECHO_ALWAYS;
+        uint32_t heartbeatEchoInterval;
+        uint32_t lastHeartbeatEcho;
+        uint32_t timeOffset = 0;
+#if RCPT_PROMPTS
+        PromptData promptdata;
+        RCP_PromptDataType lastType;
+        PromptAcceptor pacceptor;
+#endif
+#if RCPT_CHANNELS > 1
+        RCP_Channel channel;
+        ChannelCallbacks callbacks;
+        Test::Tests* tests;
+#endif
+    };
+
+    static ChannelState states[RCPT_CHANNELS];
+
+#if RCPT_CHANNELS > 1
+    static uint8_t numChannels = 1;
+    // Index of the channel whose procedures run first in the next runTest() call
+    static uint8_t nextChannel = 0;
+    // The state each channel uses, by the channel bits shifted down. Channels that are not served use the primary's.
+    static uint8_t channelStates[4];
+
+    static ChannelState& target() { return states[channelStates[channel >> 6]]; }
+
+    const ChannelCallbacks* channelCallbacks() {
+        uint8_t index = channelStates[channel >> 6];
+        return index == 0 ? nullptr : &states[index].callbacks;
+    }
+
+    static bool serves(uint8_t head) {
+        uint8_t bits = head & RCP_CHANNEL_MASK;
+        return bits == channel || channelStates[bits >> 6] != 0;
+    }
+
+    // Calls fn with RCP::channel set to each channel in turn, starting from the one at index first (the primary one is
+    // at 0), and sets it back after
+    template<typename Fn>
+    static void forEachChannel(Fn&& fn, uint8_t first = 0) {
+        RCP_Channel was = channel;
+        for(uint8_t i = 0; i < numChannels; i++) {
+            channel = states[(first + i) % numChannels].channel;
+            fn();
+        }
+        channel = was;
+    }
+
+    template<typename Fn>
+    static void onPrimary(Fn&& fn) {
+        RCP_Channel was = channel;
+        channel = states[0].channel;
+        fn();
+        channel = was;
+    }
+
+    bool addChannel(RCP_Channel ch, const ChannelCallbacks& callbacks, Test::Tests* tests) {
+        ch = static_cast<RCP_Channel>(ch & RCP_CHANNEL_MASK);
+        if(ch == channel || channelStates[ch >> 6] != 0 || numChannels == RCPT_CHANNELS) return false;
+        ChannelState& state = states[numChannels];
+        state = {};
+        for(auto& slot : state.slots) slot.state = RCP_TEST_STOPPED;
+        state.channel = ch;
+        state.callbacks = callbacks;
+        state.tests = tests;
+        channelStates[ch >> 6] = numChannels++;
+        return true;
+    }
+
+    void removeChannels() {
+        // checkHeartbeat() looks at every state, so the watchdogs of the removed channels are disarmed
+        for(uint8_t i = 1; i < numChannels; i++) {
+            states[i].heartbeatTimeout = 0;
+            states[i].watchdogPending = false;
+        }
+
+        for(auto& index : channelStates) index = 0;
+        numChannels = 1;
+        nextChannel = 0;
+    }
+
+    uint8_t getChannelCount() { return numChannels; }
+#else
+    static ChannelState& target() { return states[0]; }
+
+    static bool serves(uint8_t head) { return (head & RCP_CHANNEL_MASK) == channel; }
+
+    template<typename Fn>
+    static void forEachChannel(Fn&& fn, [[maybe_unused]] uint8_t first = 0) {
+        fn();
+    }
+
+    template<typename Fn>
+    static void onPrimary(Fn&& fn) {
+        fn();
+    }
+#endif
+
+#if RCPT_PROCEDURES
+    // Budget of the current runTest() call. A budget of 0 is unlimited.
+    static TestSlot* currentSlot = nullptr;
+    static uint32_t budgetStart;
+    static uint32_t budget;
+    static bool deferred;
+#endif
+
     static bool writeUpdatesPaused;
 
-    static bool firstTestRun;
     static bool initDone = false;
-    static uint32_t timeOffset = 0;
 
-    static PromptData promptdata;
-    static RCP_PromptDataType lastType;
-    static PromptAcceptor pacceptor;
+    // ESTOP fast path. The scanner follows packet boundaries in the received byte stream, so an ESTOP header is seen
+    // when it arrives rather than when yield() gets through the packets queued before it.
+    static volatile uint32_t estopsDetected;
+    static volatile uint32_t estopDetectedAt;
+    static uint8_t rxRemaining;
+    static bool externalScan;
+    // ESTOPs already acted on whose header is still in inbuffer
+    static uint32_t estopsInFlight;
+    static EstopStats estopStats;
+#if RCPT_PROCEDURES
+    // The ESTOP_PROC taken by the last ESTOP()
+    static Test::Procedure* estopProc = nullptr;
+    // Counts finishEstop() calls, so runSlot() can tell when the test it is running was ended by an ESTOP from inside
+    static uint32_t estopCount = 0;
+#endif
+    static uint32_t estopStartedAt;
+    static bool awaitingEstopWrite = false;
+
+    static CaptureTap captureTap = nullptr;
+
+    static RCP_Framing framing = RCP_FRAMING_RAW;
+    static CobsDecoder<> decoder;
+
+#if RCPT_ROUTER
+    // Bytes of the packet being passed down the chain that are not in inbuffer yet
+    static uint8_t forwardRemaining = 0;
+#endif
+
+    // Receive budget. adaptiveMax of 0 is the fixed SERIAL_BYTES_PER_LOOP budget.
+    static uint8_t adaptiveMin;
+    static uint8_t adaptiveMax = 0;
+    static uint32_t adaptiveReference;
+    static uint8_t rxBudget = SERIAL_BYTES_PER_LOOP;
+    // Bytes of packets yield() parses with the adaptive budget: the budget before it is capped to the free space, and
+    // more the fuller the buffer is
+    static uint16_t parseBudget;
+    static uint32_t lastYieldAt;
+    static uint32_t loopMicros;
 
     inline void insertTimestamp(uint8_t* start) {
         uint32_t time = millis();
@@ -54,18 +222,178 @@ namespace RCP {
     }
 
     void init() {
-        testNum = 0;
-        testState = RCP_TEST_STOPPED;
-        dataStreaming = false;
-        firstTestRun = false;
+        for(auto& state : states) {
+            for(auto& slot : state.slots) {
+                slot = {};
+                slot.state = RCP_TEST_STOPPED;
+            }
+
+#if RCPT_PROCEDURES
+            state.nextSlot = 0;
+#endif
+            state.dataStreaming = false;
+            state.heartbeatTime = 0;
+            state.heartbeatTimeout = 0;
+            state.lastHeartbeatReceived = 0;
+            state.watchdogTripped = false;
+            state.watchdogPending = false;
+            state.heartbeatEcho = RCP_HEARTBEAT_ECHO_ALWAYS;
+            state.timeOffset = 0;
+        }
+#if RCPT_CHANNELS > 1
+        states[0].channel = channel;
+#endif
+
         initDone = true;
-        heartbeatTime = 0;
-        lastHeartbeatReceived = 0;
-        timeOffset = 0;
         inbuffer.clear();
+        decoder.reset();
+        decoder.stats = {};
         writeUpdatesPaused = false;
+
+        estopsDetected = 0;
+        rxRemaining = 0;
+        externalScan = false;
+        estopsInFlight = 0;
+        estopStats = {};
+        adaptiveMax = 0;
+        rxBudget = SERIAL_BYTES_PER_LOOP;
+        lastYieldAt = systimeMicros();
+        loopMicros = 0;
+#if RCPT_PROCEDURES
+        estopProc = nullptr;
+#endif
+        awaitingEstopWrite = false;
+
+#if RCPT_STATS
+        resetRuntimeStats();
+        setRuntimeStatsInterval(0);
+#endif
+#if RCPT_TRANSPORTS
+        resetTransports();
+#endif
+#if RCPT_AGGREGATION_MTU
+        resetAggregation();
+#endif
+#if RCPT_ROUTER
+        forwardRemaining = 0;
+        resetRouter();
+#endif
+    }
+
+    // The part of ESTOP() that has to happen right away
+    static void beginEstop() {
+        estopStartedAt = systimeMicros();
+        awaitingEstopWrite = true;
+        if(ESTOP_ACTION != nullptr) ESTOP_ACTION();
+    }
+
+    static void finishEstop();
+
+    [[maybe_unused]] static void noteActuatorWrite() {
+        if(!awaitingEstopWrite) return;
+        awaitingEstopWrite = false;
+        estopStats.lastActuationMicros = systimeMicros() - estopStartedAt;
+        if(estopStats.lastActuationMicros > estopStats.maxActuationMicros) {
+            estopStats.maxActuationMicros = estopStats.lastActuationMicros;
+        }
+    }
+
+    static void scanRxByte(uint8_t byte) {
+        if(rxRemaining != 0) {
+            rxRemaining--;
+            return;
+        }
+
+        uint8_t pktlen = byte & (~RCP_CHANNEL_MASK);
+        if(pktlen != 0) {
+            rxRemaining = pktlen + 1;
+            return;
+        }
+
+        estopDetectedAt = systimeMicros();
+        estopsDetected = estopsDetected + 1;
+    }
+
+    void scanRxBytes(const uint8_t* data, uint8_t length) {
+        // These would be frames, not packets. The decoded packets are scanned as they are received.
+        if(framing != RCP_FRAMING_RAW) return;
+        externalScan = true;
+        for(uint8_t i = 0; i < length; i++) scanRxByte(data[i]);
     }
 
+    const EstopStats& getEstopStats() { return estopStats; }
+
+    void checkHeartbeat() {
+        // This may be an interrupt, where RCP::channel may be switched, so every channel is looked at by its state
+        for(auto& state : states) {
+            if(state.heartbeatTimeout == 0 || state.watchdogTripped) continue;
+            if(systime() - state.timeOffset - state.lastHeartbeatReceived <= state.heartbeatTimeout) continue;
+
+            // Nothing that sends here: ESTOP_ACTION and the rest of ESTOP() run from the latch
+            state.watchdogTripped = true;
+            if(ESTOP_ISR_ACTION != nullptr) ESTOP_ISR_ACTION();
+            state.watchdogPending = true;
+        }
+    }
+
+    static void setHeartbeatTimeout(uint32_t timeout) {
+        target().heartbeatTimeout = timeout;
+        target().heartbeatTime = timeout > 15 ? 15 : timeout;
+        target().lastHeartbeatReceived = millis();
+        target().watchdogTripped = false;
+    }
+
+    void setHeartbeatEcho(RCP_HeartbeatEcho echo, uint32_t intervalMs) {
+        target().heartbeatEcho = echo;
+        target().heartbeatEchoInterval = intervalMs;
+        target().lastHeartbeatEcho = millis() - intervalMs;
+    }
+
+    static bool shouldEchoHeartbeat() {
+        switch(target().heartbeatEcho) {
+        case RCP_HEARTBEAT_ECHO_NEVER:
+            return false;
+
+        case RCP_HEARTBEAT_ECHO_RATE_LIMITED:
+            if(millis() - target().lastHeartbeatEcho < target().heartbeatEchoInterval) return false;
+            target().lastHeartbeatEcho = millis();
+            return true;
+
+        default:
+            return true;
+        }
+    }
+
+    // Acts on a latched ESTOP request. Returns true if there was one.
+    static bool handleEstopLatch() {
+        // One ESTOP for every channel whose heartbeat ran out
+        bool tripped = false;
+        for(auto& state : states) {
+            if(!state.watchdogPending) continue;
+            state.watchdogPending = false;
+            estopStats.watchdogTrips++;
+            RCPT_TRACE_EVENT(RCP_TRACE_HEARTBEAT_TIMEOUT, 0, 0);
+            tripped = true;
+        }
+
+        if(tripped) {
+            ESTOP();
+            return true;
+        }
+
+        uint32_t detected = estopsDetected;
+        if(detected == estopStats.handled) return false;
+
+        uint32_t latency = systimeMicros() - estopDetectedAt;
+        if(latency > estopStats.maxLatencyMicros) estopStats.maxLatencyMicros = latency;
+        estopsInFlight += detected - estopStats.handled;
+        estopStats.detected = detected;
+        estopStats.handled = detected;
+        ESTOP();
+        return true;
+    }
+
+#if RCPT_SIMPLE_ACTUATORS
     static void sendSimpleActuatorState(uint8_t id, RCP_SimpleActuatorState state) {
         uint8_t pkt[8];
         pkt[0] = channel | 0x06;
@@ -73,9 +401,11 @@ namespace RCP {
         insertTimestamp(pkt + 2);
         pkt[6] = id;
         pkt[7] = state ? RCP_SIMPLE_ACTUATOR_ON : RCP_SIMPLE_ACTUATOR_OFF;
-        write(pkt, 8);
+        sendPacket(pkt, 8);
     }
+#endif
 
+#if RCPT_DISCRETE_ACTUATORS
     static void sendDiscreteActuatorState(uint8_t id, uint8_t state) {
         uint8_t pkt[8];
         pkt[0] = channel | 0x06;
@@ -83,274 +413,675 @@ namespace RCP {
         insertTimestamp(pkt + 2);
         pkt[6] = id;
         pkt[7] = state;
-        write(pkt, 8);
+        sendPacket(pkt, 8);
     }
+#endif
 
-    // The majority of RCP related functions
-    void yield() {
-        if(!initDone) return;
+    static bool isActive(const TestSlot& slot) {
+        return slot.state == RCP_TEST_RUNNING || slot.state == RCP_TEST_PAUSED;
+    }
+
+    static TestSlot* findSlot(uint8_t id) {
+        for(auto& slot : target().slots) {
+            if(isActive(slot) && slot.testNum == id) return &slot;
+        }
+        return nullptr;
+    }
+
+#if RCPT_PROCEDURES
+    // The procedures of RCP::channel
+    static Test::Tests& tests() {
+#if RCPT_CHANNELS > 1
+        if(target().tests != nullptr) return *target().tests;
+#endif
+        return Test::getTests();
+    }
+#endif
+
+    static void stopSlot(TestSlot& slot) {
+        if(!isActive(slot)) return;
+#if RCPT_PROCEDURES
+        tests()[slot.testNum]->end(true);
+#endif
+        RCPT_TRACE_EVENT(RCP_TRACE_PROC_END, &slot - target().slots, 1);
+        slot.state = RCP_TEST_STOPPED;
+    }
+
+    // Starts id in the first stopped slot. Without procedures there is nothing to run, so tests never start.
+    static bool startInSlot(uint8_t id) {
+        if(!RCPT_PROCEDURES || target().slots[0].state == RCP_TEST_ESTOP || findSlot(id) != nullptr) return false;
+
+        for(auto& slot : target().slots) {
+            if(slot.state != RCP_TEST_STOPPED) continue;
+            slot = {};
+            slot.testNum = id;
+            slot.state = RCP_TEST_RUNNING;
+            slot.firstRun = true;
+            return true;
+        }
+
+        return false;
+    }
+
+#if RCPT_PROCEDURES
+    static void runSlot(TestSlot& slot, Test::Procedure* test) {
+        uint32_t start = systimeMicros();
+        uint32_t estops = estopCount;
+        RCP_TestRunningState state = slot.state;
+        // A test can be ended from inside its own calls, by an ESTOP() (e.g. a redline tripped by a sensor read) or by
+        // stopProcedure(). It has then been ended already, and the slot may hold the ESTOP sequence, so stop there.
+        auto ended = [&] { return estopCount != estops || slot.state != state; };
+        currentSlot = &slot;
+
+        if(slot.firstRun) {
+            RCPT_TRACE_EVENT(RCP_TRACE_PROC_INIT, &slot - target().slots, slot.testNum);
+            slot.firstRun = false;
+            test->initialize();
+        }
 
-        // Read SERIAL_BYTES_PER_LOOP bytes into the buffer
-        for(int i = 0; i < SERIAL_BYTES_PER_LOOP && readAvail(); i++) {
+        if(!ended()) test->execute();
+        bool finished = !ended() && test->isFinished();
+        if(finished) {
+            test->end(false);
+            RCPT_TRACE_EVENT(RCP_TRACE_PROC_END, &slot - target().slots, 0);
+        }
+
+        uint32_t elapsed = systimeMicros() - start;
+        currentSlot = nullptr;
+        if(ended()) return;
+        slot.runs++;
+        slot.busyMicros += elapsed;
+        if(elapsed > slot.maxMicros) slot.maxMicros = elapsed;
+
+        if(finished) {
+            slot.state = RCP_TEST_STOPPED;
+            sendTestState();
+        }
+    }
+#endif
+
+    static void timeLoop() {
+        uint32_t now = systimeMicros();
+        uint32_t interval = now - lastYieldAt;
+        lastYieldAt = now;
+        loopMicros = loopMicros - loopMicros / 8 + interval / 8;
+    }
+
+    static uint8_t nextRxBudget() {
+        timeLoop();
+        if(adaptiveMax == 0) return SERIAL_BYTES_PER_LOOP;
+
+        uint64_t budget = static_cast<uint64_t>(SERIAL_BYTES_PER_LOOP) * loopMicros / adaptiveReference;
+        if(budget < adaptiveMin) budget = adaptiveMin;
+        if(budget > adaptiveMax) budget = adaptiveMax;
+        // Up to twice the budget with a full buffer, so a backlog is worked off before the buffer overflows
+        parseBudget = budget + budget * inbuffer.size() / RCP_SERIAL_BUFFER_SIZE;
+        uint16_t space = RCP_SERIAL_BUFFER_SIZE - inbuffer.size();
+        return budget > space ? space : budget;
+    }
+
+    // Adds a decoded frame to the buffer if it is one whole packet, and if all of it fits
+    static bool receiveFrame(const uint8_t* frame, size_t length) {
+        if(!isPacketFrame(frame, length)) return false;
+        if(static_cast<size_t>(RCP_SERIAL_BUFFER_SIZE - inbuffer.size()) < length) {
+            RCPT_STAT(rxDropped += length);
+            return true;
+        }
+
+        if(captureTap != nullptr) captureTap(false, frame, length);
+        for(size_t i = 0; i < length; i++) {
+            scanRxByte(frame[i]);
+            inbuffer.push(frame[i]);
+        }
+        return true;
+    }
+
+    static void receiveChunk(const uint8_t* data, uint8_t count) {
+        if(framing == RCP_FRAMING_COBS) decoder.decode(data, count, receiveFrame);
+        else if(captureTap != nullptr) captureTap(false, data, count);
+    }
+
+    // Reads up to limit bytes into the buffer and returns how many were read. The capture tap sees the bytes in chunks
+    // of SERIAL_BYTES_PER_LOOP, or the packets decoded from them on a framed link.
+    static uint16_t readInput(uint16_t limit) {
+        uint8_t received[SERIAL_BYTES_PER_LOOP];
+        uint8_t count = 0;
+        uint16_t total = 0;
+        for(; total < limit && readAvail(); total++) {
             uint8_t val = read();
-            inbuffer.push(val);
+            received[count++] = val;
+            if(framing == RCP_FRAMING_RAW) {
+                if(!externalScan) scanRxByte(val);
+                if(!inbuffer.push(val)) RCPT_STAT(rxDropped++);
+            }
+            RCPT_STAT(rxBytes++);
+
+            if(count == SERIAL_BYTES_PER_LOOP) {
+                receiveChunk(received, count);
+                count = 0;
+            }
         }
 
-        if(heartbeatTime != 0 && millis() - lastHeartbeatReceived > heartbeatTime) ESTOP();
+        if(count != 0) receiveChunk(received, count);
+#if RCPT_STATS
+        if(inbuffer.size() > runtimeStats.rxHighWater) runtimeStats.rxHighWater = inbuffer.size();
+#endif
+        return total;
+    }
 
+    // Handles the packet at the front of the buffer, if all of it has been received. Returns false if there was no
+    // complete packet.
+#if RCPT_ROUTER
+    // Passes down what inbuffer has of the packet being forwarded
+    static bool forwardBuffered() {
+        uint8_t bytes[65];
+        uint8_t count = 0;
+        while(count < forwardRemaining && inbuffer.pop(bytes[count])) count++;
+        if(count == 0) return false;
+        forwardRemaining -= count;
+        cutThrough(bytes, count, forwardRemaining);
+        return true;
+    }
+#endif
+
+    static bool dispatchPacket() {
+#if RCPT_ROUTER
+        if(forwardRemaining != 0) return forwardBuffered();
+#endif
         // Calculate the packet length from the header available in the buffer
-        if(inbuffer.isEmpty()) return;
+        if(inbuffer.isEmpty()) return false;
         uint8_t head = 0;
         inbuffer.peek(head, 0);
         uint8_t pktlen = head & (~RCP_CHANNEL_MASK);
 
-        // If the packet length is zero, this indicates an ESTOP condition. Do that immediately.
+        // If the packet length is zero, this indicates an ESTOP condition. Do that immediately, unless the fast path
+        // already did when the byte was received.
         if(pktlen == 0) {
-            ESTOP();
+            RCPT_STAT(rxPackets++);
+#if RCPT_ROUTER
+            routeEstop(head);
+#endif
+            if(estopsInFlight != 0) estopsInFlight--;
+            else ESTOP();
             inbuffer.pop(pktlen);
-            return;
+            return true;
         }
 
-        // If the buffer contains all the bytes for a packet, read it in to the
-        // array bytes
-        if(inbuffer.size() >= pktlen + 2) {
-            // RCPDebug("pkt");
-            uint8_t bytes[65];
-            for(int i = 0; i < pktlen + 2; i++) {
-                inbuffer.pop(bytes[i]);
-            }
+#if RCPT_ROUTER
+        // Packets for the targets down the chain go on as they are read, without waiting for the rest
+        if(!serves(head) && getDownstream() != 0) {
+            RCPT_STAT(rxPackets++);
+            RCPT_STAT(foreignChannel++);
+            forwardRemaining = pktlen + 2;
+            return forwardBuffered();
+        }
+#endif
 
-            // If the channel does not match, exit early
-            if((bytes[0] & RCP_CHANNEL_MASK) != channel) return;
-
-            // Switch on the device class
-            switch(auto devclass = static_cast<RCP_DeviceClass>(bytes[1])) {
-                // Handle test state packet
-            case RCP_DEVCLASS_TEST_STATE: {
-                switch(bytes[2] & 0xF0) {
-                case 0x00:
-                    if(testState != RCP_TEST_STOPPED) break;
-                    testNum = bytes[2] & 0x0F;
-                    testState = RCP_TEST_RUNNING;
-                    firstTestRun = true;
-                    break;
+        // Wait for the rest of the packet
+        if(inbuffer.size() < pktlen + 2) return false;
 
-                case 0x10: {
-                    switch(bytes[2] & 0x0F) {
-                    case 0x00:
-                        if(testState == RCP_TEST_RUNNING || testState == RCP_TEST_PAUSED) {
-                            Test::getTests()[testNum]->end(true);
-                            testState = RCP_TEST_STOPPED;
-                            resetPrompt();
-                        }
-                        break;
-
-                    case 0x01: {
-                        if(testState == RCP_TEST_RUNNING) testState = RCP_TEST_PAUSED;
-                        else if(testState == RCP_TEST_PAUSED) testState = RCP_TEST_RUNNING;
-                        break;
-
-                        default:
-                        break;
-                    }
+        uint8_t bytes[65];
+        for(int i = 0; i < pktlen + 2; i++) {
+            inbuffer.pop(bytes[i]);
+        }
 
-                    case 0x02:
-                        systemReset();
+        handlePacket(bytes);
+        return true;
+    }
 
-                    case 0x03:
-                        timeOffset = systime();
-                        break;
-                    }
+    // The majority of RCP related functions, for a packet of RCP::channel
+    static void handleChannelPacket(const uint8_t* bytes) {
+        uint8_t pktlen = bytes[0] & (~RCP_CHANNEL_MASK);
+        RCPT_TRACE_EVENT(RCP_TRACE_RX, bytes[1], pktlen);
+
+        // Switch on the device class
+        switch([[maybe_unused]] auto devclass = static_cast<RCP_DeviceClass>(bytes[1])) {
+            // Handle test state packet
+        case RCP_DEVCLASS_TEST_STATE: {
+            bool echo = true;
+            switch(bytes[2] & 0xF0) {
+            case 0x00:
+                if(getTestState() != RCP_TEST_STOPPED) break;
+                startInSlot(bytes[2] & 0x0F);
+                break;
 
+            case 0x10: {
+                switch(bytes[2] & 0x0F) {
+                case 0x00: {
+                    RCP_TestRunningState state = getTestState();
+                    if(state == RCP_TEST_RUNNING || state == RCP_TEST_PAUSED) {
+                        for(auto& slot : target().slots) stopSlot(slot);
+#if RCPT_PROMPTS
+                        resetPrompt();
+#endif
+                    }
                     break;
                 }
 
-                case 0x20:
-                    dataStreaming = (bytes[2] & 0x0F) != 0;
+                case 0x01: {
+                    RCP_TestRunningState from = getTestState();
+                    if(from != RCP_TEST_RUNNING && from != RCP_TEST_PAUSED) break;
+                    RCP_TestRunningState to = from == RCP_TEST_RUNNING ? RCP_TEST_PAUSED : RCP_TEST_RUNNING;
+                    for(auto& slot : target().slots) {
+                        if(slot.state == from) slot.state = to;
+                    }
                     break;
+                }
+
+                case 0x02:
+                    systemReset();
 
-                case 0xF0:
-                    if((bytes[2] & 0x0F) == 0x0F) lastHeartbeatReceived = millis();
-                    else heartbeatTime = bytes[2] & 0x0F;
+                case 0x03:
+                    target().timeOffset = systime();
                     break;
 
                 default:
                     break;
                 }
 
-                sendTestState();
-
                 break;
             }
 
-            case RCP_DEVCLASS_PROMPT: {
-                if(!pacceptor) break;
-                if(lastType == RCP_PromptDataType_GONOGO) promptdata.boolData = bytes[2];
-                else memcpy(&promptdata.floatData, bytes + 2, 4);
-
-                pacceptor(promptdata);
-                pacceptor = nullptr;
+            case 0x20:
+                target().dataStreaming = (bytes[2] & 0x0F) != 0;
                 break;
-            }
 
-            case RCP_DEVCLASS_SIMPLE_ACTUATOR: {
-                if(pktlen == 1) sendSimpleActuatorState(bytes[2], readSimpleActuator(bytes[2]));
-                else writeSimpleActuator(bytes[2], static_cast<RCP_SimpleActuatorState>(bytes[3]));
+            case 0x40:
+                startInSlot(bytes[2] & 0x0F);
                 break;
-            }
 
-            case RCP_DEVCLASS_STEPPER: {
-                if(pktlen == 1) sendTwoFloat(RCP_DEVCLASS_STEPPER, bytes[2], readStepper(bytes[2]));
-                else {
-                    auto ctlmode = static_cast<RCP_StepperControlMode>(bytes[3]);
-                    float ctlval;
-                    memcpy(&ctlval, bytes + 4, 4);
-                    writeStepper(bytes[2], ctlmode, ctlval);
-                }
+            case 0x50:
+                stopProcedure(bytes[2] & 0x0F);
+                break;
 
+            case 0x60: {
+                TestSlot* slot = findSlot(bytes[2] & 0x0F);
+                if(slot == nullptr) break;
+                slot->state = slot->state == RCP_TEST_RUNNING ? RCP_TEST_PAUSED : RCP_TEST_RUNNING;
                 break;
             }
 
-            case RCP_DEVCLASS_ANGLED_ACTUATOR: {
-                if(pktlen == 1) sendOneFloat(RCP_DEVCLASS_ANGLED_ACTUATOR, bytes[2], readAngledActuator(bytes[2]));
-                else {
-                    float val = 0;
-                    memcpy(&val, bytes + 3, 4);
-                    writeAngledActuator(bytes[2], val);
+            case 0xF0:
+                if((bytes[2] & 0x0F) == 0x0F) {
+                    RCPT_TRACE_EVENT(RCP_TRACE_HEARTBEAT, 0, 0);
+                    target().lastHeartbeatReceived = millis();
+                    target().watchdogTripped = false;
+                    echo = shouldEchoHeartbeat();
                 }
 
+                else if(pktlen >= 3) setHeartbeatTimeout((bytes[3] << 8) | bytes[4]);
+                else setHeartbeatTimeout(bytes[2] & 0x0F);
+                break;
+
+            default:
                 break;
             }
 
-            case RCP_DEVCLASS_MOTOR: {
-                if(pktlen == 1) sendOneFloat(RCP_DEVCLASS_MOTOR, bytes[2], readMotor(bytes[2]));
-                else {
-                    float val = 0;
-                    memcpy(&val, bytes + 3, 4);
-                    writeMotor(bytes[2], val);
-                }
+            if(echo) sendTestState();
 
-                break;
+            break;
+        }
+
+#if RCPT_PROMPTS
+        case RCP_DEVCLASS_PROMPT: {
+            ChannelState& state = target();
+            if(!state.pacceptor) break;
+            if(state.lastType == RCP_PromptDataType_GONOGO) state.promptdata.boolData = bytes[2];
+            else memcpy(&state.promptdata.floatData, bytes + 2, 4);
+
+            state.pacceptor(state.promptdata);
+            state.pacceptor = nullptr;
+            break;
+        }
+#endif
+
+#if RCPT_SIMPLE_ACTUATORS
+        case RCP_DEVCLASS_SIMPLE_ACTUATOR: {
+            if(pktlen == 1) sendSimpleActuatorState(bytes[2], RCPT_CALLBACK(readSimpleActuator)(bytes[2]));
+            else writeSimpleActuator(bytes[2], static_cast<RCP_SimpleActuatorState>(bytes[3]));
+            break;
+        }
+#endif
+
+#if RCPT_STEPPERS
+        case RCP_DEVCLASS_STEPPER: {
+            if(pktlen == 1) sendTwoFloat(RCP_DEVCLASS_STEPPER, bytes[2], RCPT_CALLBACK(readStepper)(bytes[2]));
+            else {
+                auto ctlmode = static_cast<RCP_StepperControlMode>(bytes[3]);
+                float ctlval;
+                memcpy(&ctlval, bytes + 4, 4);
+                writeStepper(bytes[2], ctlmode, ctlval);
             }
 
-            case RCP_DEVCLASS_DISCRETE_ACTUATOR: {
-                if(pktlen == 1) sendDiscreteActuatorState(bytes[2], readDiscreteActuator(bytes[2]));
-                else writeDiscreteActuator(bytes[2], bytes[3]);
+            break;
+        }
+#endif
 
-                break;
+#if RCPT_ANGLED_ACTUATORS
+        case RCP_DEVCLASS_ANGLED_ACTUATOR: {
+            if(pktlen == 1) {
+                sendOneFloat(RCP_DEVCLASS_ANGLED_ACTUATOR, bytes[2], RCPT_CALLBACK(readAngledActuator)(bytes[2]));
             }
 
-            case RCP_DEVCLASS_CUSTOM:
-                handleCustomData(bytes + 2, pktlen);
-                break;
+            else {
+                float val = 0;
+                memcpy(&val, bytes + 3, 4);
+                writeAngledActuator(bytes[2], val);
+            }
 
+            break;
+        }
+#endif
 
-            case RCP_DEVCLASS_BOOL_SENSOR: {
-                forceSendBoolSensorState(bytes[2]);
-                break;
+#if RCPT_MOTORS
+        case RCP_DEVCLASS_MOTOR: {
+            if(pktlen == 1) sendOneFloat(RCP_DEVCLASS_MOTOR, bytes[2], RCPT_CALLBACK(readMotor)(bytes[2]));
+            else {
+                float val = 0;
+                memcpy(&val, bytes + 3, 4);
+                writeMotor(bytes[2], val);
             }
 
-            case RCP_DEVCLASS_AM_PRESSURE:
-            case RCP_DEVCLASS_TEMPERATURE:
-            case RCP_DEVCLASS_PRESSURE_TRANSDUCER:
-            case RCP_DEVCLASS_RELATIVE_HYGROMETER:
-            case RCP_DEVCLASS_FLOW_METER:
-            case RCP_DEVCLASS_LOAD_CELL:
-            case RCP_DEVCLASS_ALTITUDE:
-            case RCP_DEVCLASS_RADIO_STRENGTH: {
-                if(pktlen == 1) {
-                    sendOneFloat(devclass, bytes[2], readSensor(devclass, bytes[2]).vals[0]);
-                }
+            break;
+        }
+#endif
 
-                else {
-                    uint8_t chan = bytes[3];
-                    float tareval;
-                    memcpy(&tareval, bytes + 4, 4);
-                    writeSensorTare(devclass, bytes[2], chan, tareval);
-                }
+#if RCPT_DISCRETE_ACTUATORS
+        case RCP_DEVCLASS_DISCRETE_ACTUATOR: {
+            if(pktlen == 1) sendDiscreteActuatorState(bytes[2], RCPT_CALLBACK(readDiscreteActuator)(bytes[2]));
+            else writeDiscreteActuator(bytes[2], bytes[3]);
 
-                break;
+            break;
+        }
+#endif
+
+#if RCPT_CUSTOM_DATA
+        case RCP_DEVCLASS_CUSTOM:
+            RCPT_CALLBACK(handleCustomData)(bytes + 2, pktlen);
+            break;
+#endif
+
+#if RCPT_BOOL_SENSORS
+        case RCP_DEVCLASS_BOOL_SENSOR: {
+            forceSendBoolSensorState(bytes[2]);
+            break;
+        }
+#endif
+
+#if RCPT_ONE_FLOAT_SENSORS
+        case RCP_DEVCLASS_AM_PRESSURE:
+        case RCP_DEVCLASS_TEMPERATURE:
+        case RCP_DEVCLASS_PRESSURE_TRANSDUCER:
+        case RCP_DEVCLASS_RELATIVE_HYGROMETER:
+        case RCP_DEVCLASS_FLOW_METER:
+        case RCP_DEVCLASS_LOAD_CELL:
+        case RCP_DEVCLASS_ALTITUDE:
+        case RCP_DEVCLASS_RADIO_STRENGTH: {
+            if(pktlen == 1) {
+                sendOneFloat(devclass, bytes[2], sampleSensor(devclass, bytes[2]).vals[0]);
             }
 
-            case RCP_DEVCLASS_POWERMON: {
-                if(pktlen == 1) {
-                    sendTwoFloat(devclass, bytes[2], readSensor(devclass, bytes[2]).vals);
-                }
+            else {
+                uint8_t chan = bytes[3];
+                float tareval;
+                memcpy(&tareval, bytes + 4, 4);
+                RCPT_CALLBACK(writeSensorTare)(devclass, bytes[2], chan, tareval);
+            }
 
-                else {
-                    uint8_t chan = bytes[3];
-                    float tareval;
-                    memcpy(&tareval, bytes + 4, 4);
-                    writeSensorTare(devclass, bytes[2], chan, tareval);
-                }
+            break;
+        }
+#endif
 
-                break;
+#if RCPT_TWO_FLOAT_SENSORS
+        case RCP_DEVCLASS_POWERMON: {
+            if(pktlen == 1) {
+                sendTwoFloat(devclass, bytes[2], sampleSensor(devclass, bytes[2]).vals);
             }
 
-            case RCP_DEVCLASS_ACCELEROMETER:
-            case RCP_DEVCLASS_GYROSCOPE:
-            case RCP_DEVCLASS_MAGNETOMETER:
-            case RCP_DEVCLASS_RPY: {
-                if(pktlen == 1) {
-                    sendThreeFloat(devclass, bytes[2], readSensor(devclass, bytes[2]).vals);
-                }
+            else {
+                uint8_t chan = bytes[3];
+                float tareval;
+                memcpy(&tareval, bytes + 4, 4);
+                RCPT_CALLBACK(writeSensorTare)(devclass, bytes[2], chan, tareval);
+            }
 
-                else {
-                    uint8_t chan = bytes[3];
-                    float tareval;
-                    memcpy(&tareval, bytes + 4, 4);
-                    writeSensorTare(devclass, bytes[2], chan, tareval);
-                }
+            break;
+        }
+#endif
 
-                break;
+#if RCPT_THREE_FLOAT_SENSORS
+        case RCP_DEVCLASS_ACCELEROMETER:
+        case RCP_DEVCLASS_GYROSCOPE:
+        case RCP_DEVCLASS_MAGNETOMETER:
+        case RCP_DEVCLASS_RPY: {
+            if(pktlen == 1) {
+                sendThreeFloat(devclass, bytes[2], sampleSensor(devclass, bytes[2]).vals);
             }
 
-            case RCP_DEVCLASS_GPS:
-            case RCP_DEVCLASS_QUATERNION: {
-                if(pktlen == 1) {
-                    sendFourFloat(devclass, bytes[2], readSensor(devclass, bytes[2]).vals);
-                }
+            else {
+                uint8_t chan = bytes[3];
+                float tareval;
+                memcpy(&tareval, bytes + 4, 4);
+                RCPT_CALLBACK(writeSensorTare)(devclass, bytes[2], chan, tareval);
+            }
 
-                else {
-                    uint8_t chan = bytes[3];
-                    float tareval;
-                    memcpy(&tareval, bytes + 4, 4);
-                    writeSensorTare(devclass, bytes[2], chan, tareval);
-                }
+            break;
+        }
+#endif
 
-                break;
+#if RCPT_FOUR_FLOAT_SENSORS
+        case RCP_DEVCLASS_GPS:
+        case RCP_DEVCLASS_QUATERNION: {
+            if(pktlen == 1) {
+                sendFourFloat(devclass, bytes[2], sampleSensor(devclass, bytes[2]).vals);
             }
 
-            default:
-                break;
+            else {
+                uint8_t chan = bytes[3];
+                float tareval;
+                memcpy(&tareval, bytes + 4, 4);
+                RCPT_CALLBACK(writeSensorTare)(devclass, bytes[2], chan, tareval);
             }
+
+            break;
+        }
+#endif
+
+        default:
+            RCPT_STAT(unknownClass++);
+            break;
         }
+
+        RCPT_TRACE_EVENT(RCP_TRACE_DISPATCHED, bytes[1], 0);
     }
 
-    void runTest() {
-        if(testState != RCP_TEST_RUNNING && testState != RCP_TEST_ESTOP) return;
-        Test::Procedure* test = nullptr;
+    void handlePacket(const uint8_t* bytes) {
+        uint8_t pktlen = bytes[0] & (~RCP_CHANNEL_MASK);
+        RCPT_STAT(rxPackets++);
+        if(pktlen == 0) {
+#if RCPT_ROUTER
+            routeEstop(bytes[0]);
+#endif
+            ESTOP();
+            return;
+        }
+
+        // If the channel is not served here, exit early, passing the packet down the chain if there is one
+        if(!serves(bytes[0])) {
+            RCPT_STAT(foreignChannel++);
+#if RCPT_ROUTER
+            routePacket(bytes);
+#endif
+            return;
+        }
+
+#if RCPT_CHANNELS > 1
+        // Handled as the channel it is for, so the replies go out on it
+        RCP_Channel was = channel;
+        channel = static_cast<RCP_Channel>(bytes[0] & RCP_CHANNEL_MASK);
+        handleChannelPacket(bytes);
+        channel = was;
+#else
+        handleChannelPacket(bytes);
+#endif
+    }
 
-        if(testState == RCP_TEST_RUNNING) test = Test::getTests()[testNum];
+    static void processInput() {
+        rxBudget = nextRxBudget();
+        readInput(rxBudget);
+        checkHeartbeat();
+        handleEstopLatch();
+#if RCPT_TRANSPORTS
+        pollTransports();
+#endif
+        if(adaptiveMax == 0) dispatchPacket();
         else {
-            if(ESTOP_PROC == nullptr) return;
-            test = ESTOP_PROC;
+            // Parse as much as the budget reads, so a larger budget also drains the buffer faster. Nothing is read
+            // meanwhile, so the buffer shrinking is the bytes parsed.
+            uint16_t buffered = inbuffer.size();
+            while(dispatchPacket() && buffered - inbuffer.size() < parseBudget) {}
         }
 
-        if(firstTestRun) {
-            test->initialize();
-            firstTestRun = false;
+#if RCPT_AGGREGATION_MTU
+        flushAgedFrames();
+#endif
+    }
+
+    // Alternates reading and dispatching one packet until there is nothing left to do, or budgetMicros have passed
+    // since start. Reads are capped to the free space in the buffer, so nothing is dropped. Returns true if it stopped
+    // because of the budget.
+    static bool processInputFor(uint32_t start, uint32_t budgetMicros) {
+        timeLoop();
+#if RCPT_TRANSPORTS
+        pollTransports();
+#endif
+        bool progress;
+        do {
+            uint16_t space = RCP_SERIAL_BUFFER_SIZE - inbuffer.size();
+            uint16_t received = readInput(space < SERIAL_BYTES_PER_LOOP ? space : SERIAL_BYTES_PER_LOOP);
+            checkHeartbeat();
+            handleEstopLatch();
+            progress = dispatchPacket() || received != 0;
+        } while(progress && systimeMicros() - start < budgetMicros);
+
+#if RCPT_AGGREGATION_MTU
+        flushAgedFrames();
+#endif
+        return progress;
+    }
+
+    void yield() {
+        if(!initDone) return;
+
+#if RCPT_STATS
+        uint32_t start = systimeMicros();
+        processInput();
+        runtimeStats.yield.record(systimeMicros() - start);
+        streamRuntimeStats();
+#else
+        processInput();
+#endif
+    }
+
+    bool yield(uint32_t budgetMicros) {
+        if(!initDone) return false;
+
+        uint32_t start = systimeMicros();
+        bool more = processInputFor(start, budgetMicros);
+#if RCPT_STATS
+        runtimeStats.yield.record(systimeMicros() - start);
+        streamRuntimeStats();
+#endif
+        return more;
+    }
+
+#if RCPT_PROCEDURES
+    static bool runSlots(uint32_t budgetMicros);
+
+    void runTest() { runTest(0); }
+
+    bool runTest(uint32_t budgetMicros) {
+#if RCPT_STATS
+        uint32_t start = systimeMicros();
+        bool wasDeferred = runSlots(budgetMicros);
+        runtimeStats.runTest.record(systimeMicros() - start);
+        return wasDeferred;
+#else
+        return runSlots(budgetMicros);
+#endif
+    }
+
+    // Runs the slots of RCP::channel. ran is whether a slot has run in this runTest() call, on any channel.
+    static void runChannelSlots(bool& ran) {
+        // Rotate which slot goes first so no slot always sees the others' side effects a tick late
+        uint8_t first = target().nextSlot;
+        target().nextSlot = (target().nextSlot + 1) % TEST_SLOTS;
+        for(uint8_t i = 0; i < TEST_SLOTS; i++) {
+            uint8_t index = (first + i) % TEST_SLOTS;
+            TestSlot& slot = target().slots[index];
+            if(slot.state != RCP_TEST_RUNNING) continue;
+
+            // Out of time: the remaining slots go first next call
+            if(ran && budget != 0 && systimeMicros() - budgetStart >= budget) {
+                target().nextSlot = index;
+                slot.deferrals++;
+                deferred = true;
+                break;
+            }
+
+            runSlot(slot, tests()[slot.testNum]);
+            ran = true;
         }
+    }
 
-        test->execute();
-        if(test->isFinished()) {
-            test->end(false);
-            testState = RCP_TEST_STOPPED;
-            firstTestRun = true;
-            sendTestState();
+    static bool runSlots(uint32_t budgetMicros) {
+        handleEstopLatch();
+        budgetStart = systimeMicros();
+        budget = budgetMicros;
+        deferred = false;
+
+        // An ESTOP is every channel's, and its sequence runs on the primary one
+        if(states[0].slots[0].state == RCP_TEST_ESTOP) {
+            // The ESTOP sequence is never cut short
+            budget = 0;
+            if(estopProc != nullptr) onPrimary([] { runSlot(states[0].slots[0], estopProc); });
+            // A write after the sequence is over is not its actuation
+            if(states[0].slots[0].state != RCP_TEST_ESTOP) awaitingEstopWrite = false;
+#if RCPT_CHANNELS > 1
+            // Once it is done, so is the ESTOP of the other channels
+            if(states[0].slots[0].state != RCP_TEST_ESTOP) {
+                forEachChannel([] {
+                    if(target().slots[0].state != RCP_TEST_ESTOP) return;
+                    target().slots[0].state = RCP_TEST_STOPPED;
+                    sendTestState();
+                });
+            }
+#endif
+            return false;
         }
+
+        bool ran = false;
+#if RCPT_CHANNELS > 1
+        // Rotated like the slots, so the procedures of one channel can not always use up the budget
+        uint8_t first = nextChannel;
+        nextChannel = (nextChannel + 1) % numChannels;
+        forEachChannel([&ran] { runChannelSlots(ran); }, first);
+#else
+        runChannelSlots(ran);
+#endif
+
+        budget = 0;
+        return deferred;
     }
 
+    bool budgetExhausted() {
+        if(budget == 0 || systimeMicros() - budgetStart < budget) return false;
+        if(currentSlot != nullptr) currentSlot->deferrals++;
+        deferred = true;
+        return true;
+    }
+#endif
+
     // The weak attribute is needed so user defined versions of systemReset will override this one
     [[gnu::weak, noreturn]] void systemReset() {
         while(true) {}
@@ -362,24 +1093,143 @@ namespace RCP {
 
     void sendTestState() {
         uint8_t data[7] = {0};
-        data[0] = channel | 0x05;
+        data[0] = channel | 5;
         data[1] = 0x00;
         insertTimestamp(data + 2);
-        data[6] = testState | heartbeatTime | (dataStreaming ? 0x80 : 0x00) | (ready ? 0x10 : 0x00);
-        write(data, 7);
+        const ChannelState& state = target();
+        data[6] = getTestState() | state.heartbeatTime | (state.dataStreaming ? 0x80 : 0x00) |
+                  (state.ready ? 0x10 : 0x00);
+        sendPacket(data, 7);
+
+        // The combined state above can not tell concurrent tests apart, so the host also gets them one by one
+        uint8_t active = 0;
+        for(const auto& slot : target().slots) {
+            if(isActive(slot)) active++;
+        }
+
+        if(active > 1) sendTestSlots();
     }
 
-    void startProcedure(uint8_t id) {
-        testNum = id;
-        testState = RCP_TEST_RUNNING;
-        firstTestRun = true;
+    void sendTestSlots() {
+        uint8_t payload[TEST_SLOTS];
+        uint8_t len = 0;
+        for(const auto& slot : target().slots) {
+            if(isActive(slot)) payload[len++] = slot.state | slot.testNum;
+        }
+
+        sendDiagnostics(RCP_DIAG_TEST_SLOTS, payload, len);
     }
 
-    void ESTOP() {
-        if(testState == RCP_TEST_RUNNING || testState == RCP_TEST_PAUSED) Test::getTests()[testNum]->end(true);
-        testState = RCP_TEST_ESTOP;
+    bool startProcedure(uint8_t id) { return startInSlot(id); }
+
+    void stopProcedure(uint8_t id) {
+        TestSlot* slot = findSlot(id);
+        if(slot == nullptr) return;
+        stopSlot(*slot);
         sendTestState();
-        firstTestRun = true;
+    }
+
+    void sendPacket(const void* data, uint8_t length) {
+        RCPT_STAT(txPackets++);
+        RCPT_STAT(txBytes += length);
+        RCPT_TRACE_EVENT(RCP_TRACE_TX, length > 1 ? static_cast<const uint8_t*>(data)[1] : 0, length);
+        if(captureTap != nullptr) captureTap(true, data, length);
+#if RCPT_TRANSPORTS
+        writeTransports(data, length);
+#else
+        const auto* out = static_cast<const uint8_t*>(data);
+        uint8_t outLength = length;
+        uint8_t frame[MAX_FRAME];
+        if(framing == RCP_FRAMING_COBS) {
+            outLength = cobsEncode(out, length, frame);
+            out = frame;
+        }
+
+#if RCPT_AGGREGATION_MTU
+        aggregate(0, out, outLength, isControlPacket(static_cast<const uint8_t*>(data), length));
+#else
+        write(out, outLength);
+#endif
+#endif
+    }
+
+    void setFraming(RCP_Framing newFraming, uint8_t link) {
+#if RCPT_TRANSPORTS
+        if(link != 0) {
+            setTransportFraming(link, newFraming);
+            return;
+        }
+#endif
+        if(link != 0) return;
+        framing = newFraming;
+        decoder.reset();
+        inbuffer.clear();
+        rxRemaining = 0;
+        estopsInFlight = 0;
+#if RCPT_ROUTER
+        if(forwardRemaining != 0) abortCutThrough();
+        forwardRemaining = 0;
+#endif
+    }
+
+    RCP_Framing getFraming(uint8_t link) {
+#if RCPT_TRANSPORTS
+        if(link != 0) return getTransportFraming(link);
+#endif
+        return link == 0 ? framing : RCP_FRAMING_RAW;
+    }
+
+    FramingStats getFramingStats(uint8_t link) {
+#if RCPT_TRANSPORTS
+        if(link != 0) return getTransportFramingStats(link);
+#endif
+        return link == 0 ? decoder.stats : FramingStats{};
+    }
+
+    uint16_t rxBuffered() { return inbuffer.size(); }
+
+    void setAdaptiveRxBudget(uint8_t minBytes, uint8_t maxBytes, uint32_t referenceLoopMicros) {
+        adaptiveMin = minBytes;
+        adaptiveMax = maxBytes;
+        adaptiveReference = referenceLoopMicros == 0 ? 1 : referenceLoopMicros;
+        // Start from the fixed budget
+        loopMicros = adaptiveReference;
+    }
+
+    uint8_t getRxBudget() { return rxBudget; }
+
+    uint32_t getLoopMicros() { return loopMicros; }
+
+    void setCaptureTap(CaptureTap tap) { captureTap = tap; }
+
+    void ESTOP() {
+        beginEstop();
+        finishEstop();
+    }
+
+    static void finishEstop() {
+#if RCPT_PROCEDURES
+        // Taken before the running tests are ended, since ending an EStopSetterWrapper changes ESTOP_PROC
+        Test::Procedure* proc = ESTOP_PROC;
+#endif
+        RCPT_TRACE_EVENT(RCP_TRACE_ESTOP, 0, 0);
+        // The board has one ESTOP_ACTION, so every channel is stopped
+        forEachChannel([] {
+            for(auto& slot : target().slots) stopSlot(slot);
+
+            target().slots[0] = {};
+            target().slots[0].state = RCP_TEST_ESTOP;
+        });
+#if RCPT_PROCEDURES
+        estopCount++;
+        estopProc = proc;
+        if(proc != nullptr) onPrimary([proc] { proc->initialize(); });
+        // Without an ESTOP sequence, ESTOP_ACTION was the last part of the ESTOP that could write an actuator
+        else awaitingEstopWrite = false;
+#else
+        awaitingEstopWrite = false;
+#endif
+        forEachChannel(sendTestState);
     }
 
     void RCPWriteSerialString(const char* str) {
@@ -389,47 +1239,70 @@ namespace RCP {
         data[0] = channel | len;
         data[1] = RCP_DEVCLASS_CUSTOM;
         memcpy(data + 2, str, len);
-        write(data, len + 2);
+        sendPacket(data, len + 2);
     }
 
     void setReady(bool newready) {
-        if(!initDone || newready == ready) return;
-        ready = newready;
+        if(!initDone || newready == target().ready) return;
+        target().ready = newready;
         sendTestState();
     }
 
+#if RCPT_PROMPTS
     void setPrompt(const char* str, RCP_PromptDataType gng, PromptAcceptor acceptor) {
         size_t len = strlen(str);
         if(len > 62) return;
-        pacceptor = acceptor;
-        lastType = gng;
+        target().pacceptor = acceptor;
+        target().lastType = gng;
         uint8_t pkt[65];
         pkt[0] = channel | (len + 1);
         pkt[1] = RCP_DEVCLASS_PROMPT;
         pkt[2] = gng;
         memcpy(pkt + 3, str, len);
-        write(pkt, len + 3);
+        sendPacket(pkt, len + 3);
     }
 
     void resetPrompt() {
-        pacceptor = nullptr;
+        target().pacceptor = nullptr;
         uint8_t pkt[3] = {0};
         pkt[0] = channel | 1;
         pkt[1] = RCP_DEVCLASS_PROMPT;
         pkt[2] = RCP_PromptDataType_RESET;
-        write(pkt, 3);
+        sendPacket(pkt, 3);
     }
+#endif
+
+    bool getDataStreaming() { return target().dataStreaming; }
+
+    uint8_t getTestNum() {
+        for(const auto& slot : target().slots) {
+            if(isActive(slot)) return slot.testNum;
+        }
+        return target().slots[0].testNum;
+    }
+
+    bool isTestActive(uint8_t id) { return findSlot(id) != nullptr; }
 
-    bool getDataStreaming() { return dataStreaming; }
+    const TestSlot& getTestSlot(uint8_t slot) { return target().slots[slot % TEST_SLOTS]; }
 
-    uint8_t getTestNum() { return testNum; }
+    uint32_t millis() { return systime() - target().timeOffset; }
 
-    uint32_t millis() { return systime() - timeOffset; }
+    uint8_t getHeartbeatTime() { return target().heartbeatTime; }
 
-    uint8_t getHeartbeatTime() { return heartbeatTime; }
+    uint32_t getHeartbeatTimeout() { return target().heartbeatTimeout; }
 
-    RCP_TestRunningState getTestState() { return testState; }
+    RCP_TestRunningState getTestState() {
+        if(target().slots[0].state == RCP_TEST_ESTOP) return RCP_TEST_ESTOP;
 
+        RCP_TestRunningState state = RCP_TEST_STOPPED;
+        for(const auto& slot : target().slots) {
+            if(slot.state == RCP_TEST_RUNNING) return RCP_TEST_RUNNING;
+            if(slot.state == RCP_TEST_PAUSED) state = RCP_TEST_PAUSED;
+        }
+        return state;
+    }
+
+#if RCPT_SEND_ONE_FLOAT
     void sendOneFloat(const RCP_DeviceClass devclass, const uint8_t id, float value) {
         uint8_t data[11] = {0};
         data[0] = channel | 9;
@@ -437,9 +1310,11 @@ namespace RCP {
         insertTimestamp(data + 2);
         data[6] = id;
         memcpy(data + 7, &value, 4);
-        write(data, 11);
+        sendPacket(data, 11);
     }
+#endif
 
+#if RCPT_SEND_TWO_FLOAT
     void sendTwoFloat(const RCP_DeviceClass devclass, const uint8_t id, const float value[2]) {
         uint8_t data[15] = {0};
         data[0] = channel | 13;
@@ -447,9 +1322,11 @@ namespace RCP {
         insertTimestamp(data + 2);
         data[6] = id;
         memcpy(data + 7, value, 8);
-        write(data, 15);
+        sendPacket(data, 15);
     }
+#endif
 
+#if RCPT_SEND_THREE_FLOAT
     void sendThreeFloat(const RCP_DeviceClass devclass, const uint8_t id, const float value[3]) {
         uint8_t data[19] = {0};
         data[0] = channel | 17;
@@ -457,9 +1334,11 @@ namespace RCP {
         insertTimestamp(data + 2);
         data[6] = id;
         memcpy(data + 7, value, 12);
-        write(data, 19);
+        sendPacket(data, 19);
     }
+#endif
 
+#if RCPT_SEND_FOUR_FLOAT
     void sendFourFloat(const RCP_DeviceClass devclass, const uint8_t id, const float value[4]) {
         uint8_t data[23] = {0};
         data[0] = channel | 21;
@@ -467,59 +1346,44 @@ namespace RCP {
         insertTimestamp(data + 2);
         data[6] = id;
         memcpy(data + 7, value, 16);
-        write(data, 23);
+        sendPacket(data, 23);
     }
+#endif
 
+#if RCPT_SIMPLE_ACTUATORS
     void forceSendSimpleActuatorState(uint8_t id) {
-        sendSimpleActuatorState(id, readSimpleActuator(id));
+        sendSimpleActuatorState(id, RCPT_CALLBACK(readSimpleActuator)(id));
     }
+#endif
 
+#if RCPT_BOOL_SENSORS
     void forceSendBoolSensorState(uint8_t id) {
-        bool resval = readBoolSensor(id);
+        bool resval = sampleBoolSensor(id);
         uint8_t data[8];
         data[0] = channel | 0x06;
         data[1] = RCP_DEVCLASS_BOOL_SENSOR;
         insertTimestamp(data + 2);
         data[6] = id;
         data[7] = resval ? 0x80 : 0x00;
-        write(data, 8);
+        sendPacket(data, 8);
     }
+#endif
 
     [[gnu::weak]] void write([[maybe_unused]] const void* data, [[maybe_unused]] uint8_t length) {}
     [[gnu::weak]] uint8_t readAvail() { return 0; }
     [[gnu::weak]] uint8_t read() { return 0; }
     [[gnu::weak]] uint32_t systime() { return 0; }
+    [[gnu::weak]] uint32_t systimeMicros() { return systime() * 1000; }
+    [[gnu::weak]] void scheduleWakeup([[maybe_unused]] uint32_t time) {}
 
+#if RCPT_SIMPLE_ACTUATORS
     RCP_SimpleActuatorState writeSimpleActuator(uint8_t id, RCP_SimpleActuatorState state) {
-        RCP_SimpleActuatorState newstate = simpleActuatorWrite_CLBK(id, state);
+        noteActuatorWrite();
+        RCP_SimpleActuatorState newstate = RCPT_CALLBACK(simpleActuatorWrite_CLBK)(id, state);
         if(!writeUpdatesPaused) sendSimpleActuatorState(id, newstate);
         return newstate;
     }
 
-    Floats2 writeStepper(uint8_t id, RCP_StepperControlMode controlMode, float controlVal) {
-        Floats2 newstate = stepperWrite_CLBK(id, controlMode, controlVal);
-        if(!writeUpdatesPaused) sendTwoFloat(RCP_DEVCLASS_STEPPER, id, newstate);
-        return newstate;
-    }
-
-    float writeMotor(uint8_t id, float value) {
-        float newstate = motorWrite_CLBK(id, value);
-        if(!writeUpdatesPaused) sendOneFloat(RCP_DEVCLASS_MOTOR, id, newstate);
-        return newstate;
-    }
-
-    float writeAngledActuator(uint8_t id, float controlVal) {
-        float newstate = angledActuatorWrite_CLBK(id, controlVal);
-        if(!writeUpdatesPaused) sendOneFloat(RCP_DEVCLASS_ANGLED_ACTUATOR, id, newstate);
-        return newstate;
-    }
-
-    uint8_t writeDiscreteActuator(uint8_t id, uint8_t state) {
-        uint8_t newstate = discreteActuatorWrite_CLBK(id, state);
-        if(!writeUpdatesPaused) sendDiscreteActuatorState(id, newstate);
-        return newstate;
-    }
-
     [[gnu::weak]] RCP_SimpleActuatorState readSimpleActuator([[maybe_unused]] uint8_t id) {
         return RCP_SIMPLE_ACTUATOR_OFF;
     }
@@ -528,12 +1392,30 @@ namespace RCP {
                                                                    [[maybe_unused]] RCP_SimpleActuatorState state) {
         return RCP_SIMPLE_ACTUATOR_OFF;
     }
+#endif
+
+#if RCPT_DISCRETE_ACTUATORS
+    uint8_t writeDiscreteActuator(uint8_t id, uint8_t state) {
+        noteActuatorWrite();
+        uint8_t newstate = RCPT_CALLBACK(discreteActuatorWrite_CLBK)(id, state);
+        if(!writeUpdatesPaused) sendDiscreteActuatorState(id, newstate);
+        return newstate;
+    }
 
     [[gnu::weak]] uint8_t readDiscreteActuator([[maybe_unused]] uint8_t id) { return 0; }
 
     [[gnu::weak]] uint8_t discreteActuatorWrite_CLBK([[maybe_unused]] uint8_t id, [[maybe_unused]] uint8_t state) {
         return 0;
     }
+#endif
+
+#if RCPT_STEPPERS
+    Floats2 writeStepper(uint8_t id, RCP_StepperControlMode controlMode, float controlVal) {
+        noteActuatorWrite();
+        Floats2 newstate = RCPT_CALLBACK(stepperWrite_CLBK)(id, controlMode, controlVal);
+        if(!writeUpdatesPaused) sendTwoFloat(RCP_DEVCLASS_STEPPER, id, newstate);
+        return newstate;
+    }
 
     [[gnu::weak]] Floats2 readStepper([[maybe_unused]] uint8_t id) { return {}; }
 
@@ -542,16 +1424,35 @@ namespace RCP {
                                             [[maybe_unused]] float controlVal) {
         return {};
     }
+#endif
+
+#if RCPT_MOTORS
+    float writeMotor(uint8_t id, float value) {
+        noteActuatorWrite();
+        float newstate = RCPT_CALLBACK(motorWrite_CLBK)(id, value);
+        if(!writeUpdatesPaused) sendOneFloat(RCP_DEVCLASS_MOTOR, id, newstate);
+        return newstate;
+    }
 
     [[gnu::weak]] float readMotor([[maybe_unused]] uint8_t id) { return 0; }
 
     [[gnu::weak]] float motorWrite_CLBK([[maybe_unused]] uint8_t id, [[maybe_unused]] float value) { return 0; }
+#endif
+
+#if RCPT_ANGLED_ACTUATORS
+    float writeAngledActuator(uint8_t id, float controlVal) {
+        noteActuatorWrite();
+        float newstate = RCPT_CALLBACK(angledActuatorWrite_CLBK)(id, controlVal);
+        if(!writeUpdatesPaused) sendOneFloat(RCP_DEVCLASS_ANGLED_ACTUATOR, id, newstate);
+        return newstate;
+    }
 
     [[gnu::weak]] float readAngledActuator([[maybe_unused]] uint8_t id) { return 0; }
 
     [[gnu::weak]] float angledActuatorWrite_CLBK([[maybe_unused]] uint8_t id, [[maybe_unused]] float controlVal) {
         return 0;
     }
+#endif
 
     [[gnu::weak]] Floats4 readSensor([[maybe_unused]] RCP_DeviceClass devclass, [[maybe_unused]] uint8_t id) {
         return {};
@@ -562,11 +1463,12 @@ namespace RCP {
     [[gnu::weak]] void writeSensorTare([[maybe_unused]] RCP_DeviceClass devclass, [[maybe_unused]] uint8_t id,
                                        [[maybe_unused]] uint8_t dataChannel, [[maybe_unused]] float tareVal) {}
 
+#if RCPT_CUSTOM_DATA
     [[gnu::weak]] void handleCustomData([[maybe_unused]] const void* data, [[maybe_unused]] uint8_t length) {}
-
-
+#endif
 } // namespace RCP
 
+#if RCPT_PROCEDURES
 namespace Test {
     [[gnu::weak]] Tests& getTests() {
         static Tests tests = {
@@ -578,3 +1480,4 @@ namespace Test {
         return tests;
     }
 } // namespace Test
+#endif
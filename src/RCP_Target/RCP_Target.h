@@ -3,10 +3,14 @@
 
 #include <stdint.h>
 
+#include "config.h"
 #include "LRIRingBuf.h"
-#include "procedures.h"
 #include "VERSION.h"
 
+#if RCPT_PROCEDURES
+#include "procedures.h"
+#endif
+
 // This do-while(0) thing is horrible but if the linux kernel can do it so can I
 #define RCPDebug(str)                                                                                                  \
 do {                                                                                                                   \
@@ -62,6 +66,9 @@ typedef enum {
     RCP_DATA_STREAM_STOP = 0x20,
     RCP_DATA_STREAM_START = 0x21,
     RCP_TEST_QUERY = 0x30,
+    RCP_TEST_START_CONCURRENT = 0x40,
+    RCP_TEST_STOP_ONE = 0x50,
+    RCP_TEST_PAUSE_ONE = 0x60,
     RCP_HEARTBEATS_CONTROL = 0xF0
 } RCP_TestStateControlMode;
 
@@ -76,6 +83,12 @@ typedef enum {
     RCP_HEARTBEAT_TIME_MASK = 0x0F,
 } RCP_TestRunningState;
 
+typedef enum {
+    RCP_HEARTBEAT_ECHO_ALWAYS = 0x00,
+    RCP_HEARTBEAT_ECHO_NEVER = 0x01,
+    RCP_HEARTBEAT_ECHO_RATE_LIMITED = 0x02,
+} RCP_HeartbeatEcho;
+
 typedef enum {
     RCP_SIMPLE_ACTUATOR_OFF = 0x00,
     RCP_SIMPLE_ACTUATOR_ON = 0x80,
@@ -108,6 +121,9 @@ namespace RCP {
     static_assert(sizeof(PromptData) == 4, "PromptData size does not equal 4!");
 
     using PromptAcceptor = void (*)(const PromptData& promptData);
+    using EstopAction = void (*)();
+    // Sees every chunk of bytes read() and every packet passed to write(). See setCaptureTap().
+    using CaptureTap = void (*)(bool transmit, const void* data, uint8_t length);
 
     template<size_t NUM_FLOATS>
     struct Floats {
@@ -118,11 +134,48 @@ namespace RCP {
     using Floats3 = Floats<3>;
     using Floats4 = Floats<4>;
 
-    constexpr int SERIAL_BYTES_PER_LOOP = 20;
-    constexpr int RCP_SERIAL_BUFFER_SIZE = 128;
+    constexpr int SERIAL_BYTES_PER_LOOP = RCPT_RX_BYTES_PER_LOOP;
+    constexpr int RCP_SERIAL_BUFFER_SIZE = RCPT_RX_BUFFER_SIZE;
+    static_assert(SERIAL_BYTES_PER_LOOP > 0 && SERIAL_BYTES_PER_LOOP <= 255, "RCPT_RX_BYTES_PER_LOOP must be 1 to 255");
+    static_assert(RCP_SERIAL_BUFFER_SIZE >= 65 && RCP_SERIAL_BUFFER_SIZE <= 65535,
+                  "RCPT_RX_BUFFER_SIZE must hold a whole packet and be at most 65535");
+    constexpr uint8_t TEST_SLOTS = 4;
+
+    // State and time accounting of one concurrently running test. Times are in systimeMicros() units and cover
+    // the test's initialize/execute/end calls since it was started.
+    struct TestSlot {
+        uint8_t testNum;
+        RCP_TestRunningState state;
+        bool firstRun;
+        uint32_t runs;
+        uint32_t busyMicros;
+        uint32_t maxMicros;
+        uint32_t deferrals;
+    };
+
+    struct EstopStats {
+        // ESTOP headers seen by the receive path scanner, and how many of those ESTOP() was called for
+        uint32_t detected;
+        uint32_t handled;
+        // Worst time from an ESTOP header being scanned to ESTOP() being called, in systimeMicros() units
+        uint32_t maxLatencyMicros;
+        // Time from ESTOP() being called to the first actuator write after it, for the last and worst ESTOP
+        uint32_t lastActuationMicros;
+        uint32_t maxActuationMicros;
+        uint32_t watchdogTrips;
+    };
 
     extern RCP_Channel channel;
+#if RCPT_PROCEDURES
     extern Test::Procedure* ESTOP_PROC;
+#endif
+    // Called first thing in ESTOP(), before any procedure is ended or started. Keep it to direct actuator writes:
+    // it runs wherever ESTOP() was called from, and is the bound on how quickly the system is safed.
+    extern EstopAction ESTOP_ACTION;
+    // Called by checkHeartbeat() when it trips, which may be in an interrupt. Only put the actuators in their safe
+    // state here, directly on the hardware: anything that sends, such as writeSimpleActuator(), must wait for
+    // ESTOP_ACTION, which the next yield() or runTest() runs as part of ESTOP().
+    extern EstopAction ESTOP_ISR_ACTION;
 
     // extern LRI::RingBuf<uint8_t, RCP_SERIAL_BUFFER_SIZE> inbuffer;
 
@@ -136,77 +189,168 @@ namespace RCP {
 
     void init();
     void yield();
+    // Like yield(), but keeps reading and handling packets until there is no more input or budgetMicros of
+    // systimeMicros() have passed, so the time spent per call is bounded rather than following the traffic. Reads
+    // stop when the receive buffer is full instead of dropping bytes. Always handles at least one packet if there is
+    // one. Returns true if it stopped because of the budget. systimeMicros() needs to be finer than the budget.
+    bool yield(uint32_t budgetMicros);
+#if RCPT_PROCEDURES
     void runTest();
+    // Like runTest(), but stops starting new work once budgetMicros have passed. Procedures that run several children
+    // (such as ParallelProcedure) check budgetExhausted() between children and resume where they left off on the
+    // next call, so every child still runs at least once every few calls. Returns true if work was deferred.
+    bool runTest(uint32_t budgetMicros);
+    // For procedures with more work left in this runTest() call. Returns true, and counts a deferral for the running
+    // test, if the budget passed to runTest() is used up. Always false outside of a budgeted runTest().
+    bool budgetExhausted();
+#endif
     [[noreturn]] void systemReset();
     void pauseWriteUpdates();
     void unpauseWriteUpdates();
 
     void sendTestState();
-    void startProcedure(uint8_t id);
+    // Sends the state and test number of each active test in an RCP_DIAG_TEST_SLOTS packet (see diagnostics.h)
+    void sendTestSlots();
+    // Starts test id in a free slot. Returns false if it is already running, all slots are busy, during ESTOP, or if
+    // the procedures framework is compiled out.
+    bool startProcedure(uint8_t id);
+    void stopProcedure(uint8_t id);
     void ESTOP();
+    // Scans received bytes for an ESTOP header at a packet boundary, and latches an ESTOP request that the next
+    // yield() or runTest() acts on before anything else. Safe to call from a receive ISR with the same bytes that
+    // read() later returns. If this is never called, yield() scans bytes as it reads them instead.
+    void scanRxBytes(const uint8_t* data, uint8_t length);
+    const EstopStats& getEstopStats();
+    // Trips ESTOP if heartbeats are enabled and none was received within the timeout. yield() calls this, but it can
+    // also be called from a timer interrupt so a stalled main loop is still caught. It only calls ESTOP_ISR_ACTION
+    // and latches the trip; the next yield() or runTest() runs ESTOP() and sends from there. Trips once per lost link.
+    void checkHeartbeat();
+    // How the test state echo to heartbeat packets is sent. RCP_HEARTBEAT_ECHO_RATE_LIMITED echoes at most once per
+    // intervalMs.
+    void setHeartbeatEcho(RCP_HeartbeatEcho echo, uint32_t intervalMs = 0);
     void RCPWriteSerialString(const char* str);
 
     void setReady(bool newready);
+#if RCPT_PROMPTS
     void setPrompt(const char* str, RCP_PromptDataType gng, PromptAcceptor acceptor);
     void resetPrompt();
+#endif
 
     bool getDataStreaming();
+    // The test number of the first active slot, or of the last test run in slot 0 if none are active
     uint8_t getTestNum();
+    bool isTestActive(uint8_t id);
+    const TestSlot& getTestSlot(uint8_t slot);
     uint32_t millis();
+    // The heartbeat time field of the test state. A heartbeat control packet with a two byte big endian payload
+    // sets a timeout of up to 65535ms; the field then reads the timeout capped at 15.
     uint8_t getHeartbeatTime();
+    uint32_t getHeartbeatTimeout();
+    // ESTOP, else RUNNING if any slot is running, else PAUSED if any is paused, else STOPPED
     RCP_TestRunningState getTestState();
 
+#if RCPT_SEND_ONE_FLOAT
     void sendOneFloat(RCP_DeviceClass devclass, uint8_t id, float value);
+#endif
 
+#if RCPT_SEND_TWO_FLOAT
     void sendTwoFloat(RCP_DeviceClass devclass, uint8_t id, const float value[2]);
     inline void sendTwoFloat(RCP_DeviceClass devclass, uint8_t id, Floats2 floats) {
         sendTwoFloat(devclass, id, floats.vals);
     }
+#endif
 
+#if RCPT_SEND_THREE_FLOAT
     void sendThreeFloat(RCP_DeviceClass devclass, uint8_t id, const float value[3]);
     inline void sendThreeFloat(RCP_DeviceClass devclass, uint8_t id, Floats3 floats) {
         sendThreeFloat(devclass, id, floats.vals);
     }
+#endif
 
+#if RCPT_SEND_FOUR_FLOAT
     void sendFourFloat(RCP_DeviceClass devclass, uint8_t id, const float value[4]);
     inline void sendFourFloat(RCP_DeviceClass devclass, uint8_t id, Floats4 floats) {
         sendFourFloat(devclass, id, floats.vals);
     }
+#endif
 
+#if RCPT_SIMPLE_ACTUATORS
     void forceSendSimpleActuatorState(uint8_t id);
+#endif
+#if RCPT_BOOL_SENSORS
     void forceSendBoolSensorState(uint8_t id);
+#endif
+
+    // Every packet the library sends goes through sendPacket(), which counts it and passes it on to write() and the
+    // links added with addTransport() (see transports.h)
+    void sendPacket(const void* data, uint8_t length);
+    // Handles one complete packet, header first, as if yield() had read it. A zero length header ESTOPs.
+    void handlePacket(const uint8_t* packet);
+    // Bytes read but not yet parsed by yield()
+    uint16_t rxBuffered();
+    // Instead of SERIAL_BYTES_PER_LOOP, lets each yield() read between minBytes and maxBytes depending on how the loop
+    // is doing: SERIAL_BYTES_PER_LOOP for every referenceLoopMicros since the previous yield(), so a slow loop catches
+    // up on what arrived meanwhile, but never more than the receive buffer has room for, so bytes wait in the driver
+    // instead of being dropped. Each yield() then also parses packets until about that many bytes (before the cap to
+    // the free space) have been handled, rather than one packet, so reading more does not just fill the buffer. The
+    // parsing goes further the fuller the buffer is, up to twice that with a full buffer. A maxBytes of 0 goes back to
+    // the fixed budget.
+    void setAdaptiveRxBudget(uint8_t minBytes, uint8_t maxBytes, uint32_t referenceLoopMicros);
+    // Bytes the last yield() was allowed to read. Not updated by yield(budgetMicros).
+    uint8_t getRxBudget();
+    // Time between yield() calls in systimeMicros() units, averaged over about the last 8 calls
+    uint32_t getLoopMicros();
+    // Called with the bytes each yield() reads and each packet sent, for recording the byte streams. nullptr removes
+    // the tap.
+    void setCaptureTap(CaptureTap tap);
 
     void write(const void* data, uint8_t length);
     uint8_t readAvail();
     uint8_t read();
     uint32_t systime();
+    // Microsecond clock used for test time accounting. Defaults to systime() * 1000.
+    uint32_t systimeMicros();
+    // Called by time based procedures with the millis() time at which they next need to run. The default does
+    // nothing; a simulator or low power main loop can use it to skip ahead to that time.
+    void scheduleWakeup(uint32_t time);
 
+#if RCPT_SIMPLE_ACTUATORS
     RCP_SimpleActuatorState writeSimpleActuator(uint8_t id, RCP_SimpleActuatorState state);
-    Floats2 writeStepper(uint8_t id, RCP_StepperControlMode controlMode, float controlVal);
-    float writeMotor(uint8_t id, float value);
-    float writeAngledActuator(uint8_t id, float controlVal);
-    uint8_t writeDiscreteActuator(uint8_t id, uint8_t state);
-
     RCP_SimpleActuatorState readSimpleActuator(uint8_t id);
     RCP_SimpleActuatorState simpleActuatorWrite_CLBK(uint8_t id, RCP_SimpleActuatorState state);
+#endif
 
+#if RCPT_DISCRETE_ACTUATORS
+    uint8_t writeDiscreteActuator(uint8_t id, uint8_t state);
     uint8_t readDiscreteActuator(uint8_t id);
     uint8_t discreteActuatorWrite_CLBK(uint8_t id, uint8_t state);
+#endif
 
+#if RCPT_STEPPERS
+    Floats2 writeStepper(uint8_t id, RCP_StepperControlMode controlMode, float controlVal);
     Floats2 readStepper(uint8_t id);
     Floats2 stepperWrite_CLBK(uint8_t id, RCP_StepperControlMode controlMode, float controlVal);
+#endif
 
+#if RCPT_MOTORS
+    float writeMotor(uint8_t id, float value);
     float readMotor(uint8_t id);
     float motorWrite_CLBK(uint8_t id, float value);
+#endif
 
+#if RCPT_ANGLED_ACTUATORS
+    float writeAngledActuator(uint8_t id, float controlVal);
     float readAngledActuator(uint8_t id);
     float angledActuatorWrite_CLBK(uint8_t id, float controlVal);
+#endif
 
     Floats4 readSensor(RCP_DeviceClass devclass, uint8_t id);
     bool readBoolSensor(uint8_t id);
     void writeSensorTare(RCP_DeviceClass devclass, uint8_t id, uint8_t dataChannel, float tareVal);
 
+#if RCPT_CUSTOM_DATA
     void handleCustomData(const void* data, uint8_t length);
+#endif
 } // namespace RCP
 
 
@@ -0,0 +1,70 @@
+#ifndef AGGREGATION_H
+#define AGGREGATION_H
+
+/*
+ * Packs consecutive packets into one write() call per frame, for links that pay for every transmission rather than
+ * every byte, such as radios and UDP. Most packets are 8 to 23 bytes, so a link that sends each one on its own spends
+ * most of its airtime and transmissions on overhead.
+ *
+ *     RCP::setAggregation(120, 2000);      // link 0: frames of up to 120 bytes, sent at most 2ms after they start
+ *     RCP::setAggregation(200, 5000, 1);   // a link added with addTransport(), see transports.h
+ *
+ * A frame is sent when the next packet would not fit in the MTU, or once its first packet has waited maxAgeMicros
+ * (checked by yield() and by every send). Control packets (test state, actuators, prompts, custom data; everything
+ * below RCP_DEVCLASS_AM_PRESSURE) never wait: one is added to the frame being built, which is sent right away, so the
+ * order of packets on the link is kept. Only telemetry waits for the frame to fill up.
+ *
+ * Frames are the packets back to back, COBS framed on a framed link, so the receiver parses them as it would any
+ * other stream. RCPT_AGGREGATION_MTU (see config.h) is the largest MTU, and the buffer each link gets; it is 0 by
+ * default, which leaves aggregation out. Aggregation is off on every link until setAggregation() is called. init()
+ * drops unsent frames and resets the statistics, but keeps the settings.
+ */
+
+#include <stdint.h>
+
+#include "RCP_Target.h"
+#include "config.h"
+
+namespace RCP {
+    // Whether a packet is sent right away rather than waiting for the frame to fill up
+    inline bool isControlPacket(const uint8_t* packet, uint8_t length) {
+        return length < 2 || packet[1] < RCP_DEVCLASS_AM_PRESSURE;
+    }
+
+#if RCPT_AGGREGATION_MTU
+    static_assert(RCPT_AGGREGATION_MTU <= 255, "write() takes at most 255 bytes at once");
+
+    // Counted since init() or the last setAggregation() for the link
+    struct AggregationStats {
+        // write() calls, and the packets and bytes in them
+        uint32_t frames;
+        uint32_t packets;
+        uint32_t bytes;
+        // Why frames were sent: the next packet did not fit, the deadline passed, a control packet, or
+        // flushAggregation()
+        uint32_t sizeFlushes;
+        uint32_t ageFlushes;
+        uint32_t controlFlushes;
+        uint32_t manualFlushes;
+    };
+
+    // Aggregates the packets sent on link into frames of up to mtu bytes, each sent no later than maxAgeMicros (in
+    // systimeMicros() units) after its first packet. mtu is capped to RCPT_AGGREGATION_MTU, and 0 turns aggregation
+    // off. Sends what the link had waiting.
+    void setAggregation(uint8_t mtu, uint32_t maxAgeMicros, uint8_t link = 0);
+    // Sends every frame that has not been sent yet
+    void flushAggregation();
+    const AggregationStats& getAggregationStats(uint8_t link = 0);
+    // The part of the MTU the link's frames have used on average, from 0 to 1
+    float getFrameFill(uint8_t link = 0);
+
+    // Called by sendPacket() and writeTransports() with the bytes of each packet as they go out on link
+    void aggregate(uint8_t link, const uint8_t* data, uint8_t length, bool control);
+    // Called by init()
+    void resetAggregation();
+    // Called by yield()
+    void flushAgedFrames();
+#endif
+} // namespace RCP
+
+#endif // AGGREGATION_H
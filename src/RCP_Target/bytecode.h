@@ -0,0 +1,153 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+/*
+ * A small bytecode format for procedures that can be uploaded at runtime instead of compiled into the firmware.
+ *
+ * Programs live in a fixed number of statically allocated BytecodeProcedures, so uploading a program never
+ * allocates. A program is a flat sequence of instructions, one opcode byte followed by its operands. Integer operands
+ * (uint16 and uint32) are big endian, like the upload header and RCP timestamps. Floats are copied with memcpy, the
+ * same way they are in RCP packets:
+ *
+ *   BC_END                                               stop the program (also implied at the end of the code)
+ *   BC_SIMPLE_ACTUATOR    id, state                      RCP::writeSimpleActuator
+ *   BC_STEPPER            id, mode, float value          RCP::writeStepper
+ *   BC_ANGLED_ACTUATOR    id, float value                RCP::writeAngledActuator
+ *   BC_MOTOR              id, float value                RCP::writeMotor
+ *   BC_DISCRETE_ACTUATOR  id, state                      RCP::writeDiscreteActuator
+ *   BC_WAIT               uint32 ms                      like WaitProcedure
+ *   BC_WAIT_SENSOR        devclass, id, channel, comparator, float threshold
+ *                                                        wait until readSensor(...).vals[channel] compares true
+ *   BC_WAIT_BOOL_SENSOR   id, value                      wait until readBoolSensor(id) == value
+ *   BC_PARALLEL           count, count x (uint16 length, code)
+ *                                                        run the branches in parallel until all are done
+ *   BC_RACE               same as BC_PARALLEL            run the branches until any one of them is done
+ *   BC_PROMPT_GONOGO      length, text                   prompt the operator. NOGO ends the program
+ *
+ * Parallel blocks can not be nested, and have at most BYTECODE_THREADS - 1 branches. Each call to execute() runs at
+ * most BYTECODE_STEPS_PER_TICK instructions per branch, so the cost of a tick is bounded regardless of the program.
+ *
+ * For comparison, an uploaded program costs a fixed sizeof(BytecodeProcedure) of RAM. The same sequence built from
+ * procedure objects costs one heap allocation (with its vtable pointer and allocator overhead) per step, plus the
+ * child pointer arrays of every Sequential/Parallel node. The BytecodeRam test compares the two.
+ *
+ * Uploads are done with custom packets. Call handleBytecodeUpload() from RCP::handleCustomData(); it returns true if
+ * the packet was an upload packet. Upload packets start with BYTECODE_UPLOAD_MAGIC followed by a command:
+ *
+ *   BYTECODE_BEGIN   program, test slot, uint16 length (big endian)
+ *   BYTECODE_DATA    program, uint16 offset (big endian), code bytes
+ *   BYTECODE_COMMIT  program
+ *
+ * Data has to arrive in order: a data packet may repeat bytes that were already received, but not start past them
+ * (BYTECODE_GAP). A lost data packet is therefore noticed on the next one, and resending from the reported gap
+ * recovers. Commit is refused with BYTECODE_INCOMPLETE until all length bytes have arrived, and with
+ * BYTECODE_BAD_COMMAND unless the program was begun since its last commit; the program is then validated and placed
+ * in Test::getTests() at the given slot. Each command is answered with a custom packet of BYTECODE_UPLOAD_MAGIC, the
+ * command, and a BytecodeUploadStatus.
+ */
+
+#include <stdint.h>
+
+#include "procedures.h"
+
+namespace Test {
+    constexpr uint16_t BYTECODE_PROGRAM_SIZE = 256;
+    constexpr uint8_t BYTECODE_PROGRAMS = 2;
+    constexpr uint8_t BYTECODE_THREADS = 4;
+    constexpr uint8_t BYTECODE_STEPS_PER_TICK = 8;
+    constexpr uint8_t BYTECODE_UPLOAD_MAGIC = 0xBC;
+
+    typedef enum {
+        BC_END = 0x00,
+        BC_SIMPLE_ACTUATOR = 0x01,
+        BC_STEPPER = 0x02,
+        BC_ANGLED_ACTUATOR = 0x04,
+        BC_MOTOR = 0x05,
+        BC_DISCRETE_ACTUATOR = 0x06,
+        BC_WAIT = 0x10,
+        BC_WAIT_SENSOR = 0x11,
+        BC_WAIT_BOOL_SENSOR = 0x12,
+        BC_PARALLEL = 0x20,
+        BC_RACE = 0x21,
+        BC_PROMPT_GONOGO = 0x30,
+    } BytecodeOp;
+
+    typedef enum {
+        BC_LESS = 0x00,
+        BC_LESS_EQUAL = 0x01,
+        BC_GREATER = 0x02,
+        BC_GREATER_EQUAL = 0x03,
+    } BytecodeComparator;
+
+    typedef enum {
+        BYTECODE_BEGIN = 0x01,
+        BYTECODE_DATA = 0x02,
+        BYTECODE_COMMIT = 0x03,
+    } BytecodeUploadCommand;
+
+    typedef enum {
+        BYTECODE_OK = 0x00,
+        BYTECODE_BAD_PROGRAM = 0x01,
+        BYTECODE_BAD_SLOT = 0x02,
+        BYTECODE_TOO_LONG = 0x03,
+        BYTECODE_INVALID = 0x04,
+        BYTECODE_SLOT_BUSY = 0x05,
+        BYTECODE_BAD_COMMAND = 0x06,
+        BYTECODE_GAP = 0x07,
+        BYTECODE_INCOMPLETE = 0x08,
+    } BytecodeUploadStatus;
+
+    class BytecodeProcedure : public Procedure {
+        struct Thread {
+            uint16_t pc;
+            uint16_t end;
+            uint32_t waitStart;
+            bool waiting;
+            bool done;
+        };
+
+        uint8_t code[BYTECODE_PROGRAM_SIZE];
+        uint16_t length;
+        // Bytes of an upload received so far
+        uint16_t received;
+        bool loaded;
+        bool aborted;
+
+        // Thread 0 is the main program, the others run the branches of the current parallel block
+        Thread threads[BYTECODE_THREADS];
+        uint8_t branches;
+        bool race;
+        bool inBlock;
+        uint16_t blockEnd;
+
+        bool step(Thread& thread);
+        void run(Thread& thread);
+        bool blockFinished() const;
+        void endBlock();
+
+        static BytecodeUploadStatus upload(const uint8_t* packet, uint8_t length);
+
+    public:
+        BytecodeProcedure();
+
+        // Checks that every instruction in program is complete and well formed
+        static bool validate(const uint8_t* program, uint16_t length);
+
+        // Validates and copies program. Returns false and unloads the procedure if it is invalid.
+        bool load(const uint8_t* program, uint16_t length);
+        bool isLoaded() const;
+
+        void initialize() override;
+        void execute() override;
+        void end(bool interrupted) override;
+        bool isFinished() override;
+
+        friend bool handleBytecodeUpload(const void* data, uint8_t length);
+    };
+
+    BytecodeProcedure& getBytecodeProgram(uint8_t index);
+
+    bool handleBytecodeUpload(const void* data, uint8_t length);
+} // namespace Test
+
+#endif // BYTECODE_H
@@ -0,0 +1,100 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+/*
+ * More than one logical target in one firmware, for boards that are several systems to the host, such as a propellant
+ * skid and an ignition controller on one MCU. Each channel the firmware serves has its own test state and test slots,
+ * heartbeat and watchdog, data streaming and ready flags, prompt, procedures table and device callbacks. They share
+ * the receive parser, the links and the send path; each packet is handled in one pass by the channel in its header.
+ *
+ * RCP::channel as set before init() is the primary channel, which uses the global hooks and Test::getTests() as
+ * before. addChannel() adds up to RCPT_CHANNELS - 1 more (see config.h, 1 by default), each with its own callbacks
+ * and procedures:
+ *
+ *     RCP::ChannelCallbacks igniter = {};
+ *     igniter.readSimpleActuator = igniterRead;
+ *     igniter.simpleActuatorWrite_CLBK = igniterWrite;
+ *     RCP::channel = RCP_CH_ZERO;
+ *     RCP::addChannel(RCP_CH_ONE, igniter, &igniterTests);
+ *     RCP::init();
+ *
+ * Callbacks an added channel leaves null fall back to the global hooks, and a null procedures table to
+ * Test::getTests(). While a channel's packet is handled, and while its procedures run, RCP::channel is that channel,
+ * so the hooks can tell the channels apart by it and everything sent from there goes out on it. To send for or look
+ * at an added channel from elsewhere, set RCP::channel to it and back:
+ *
+ *     RCP::channel = RCP_CH_ONE;
+ *     RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, chamberPressure);
+ *     RCP::channel = RCP_CH_ZERO;
+ *
+ * runTest() runs the procedures of every channel. An ESTOP is for the whole board, which has one ESTOP_ACTION: an
+ * ESTOP packet, or any channel's heartbeat running out, puts every channel in ESTOP, and ESTOP_PROC runs on the
+ * primary channel. Redlines, statistics, bytecode uploads (into Test::getTests()) and the links are shared.
+ * init() resets every channel's state but keeps the added channels.
+ */
+
+#include <stdint.h>
+
+#include "RCP_Target.h"
+#include "config.h"
+#include "procedures.h"
+
+namespace RCP {
+#if RCPT_CHANNELS > 1
+    static_assert(RCPT_CHANNELS <= 4, "RCP has four channels");
+
+    // The device hooks of an added channel, named as the global ones. Null uses the global hook.
+    struct ChannelCallbacks {
+#if RCPT_SIMPLE_ACTUATORS
+        RCP_SimpleActuatorState (*readSimpleActuator)(uint8_t id);
+        RCP_SimpleActuatorState (*simpleActuatorWrite_CLBK)(uint8_t id, RCP_SimpleActuatorState state);
+#endif
+#if RCPT_DISCRETE_ACTUATORS
+        uint8_t (*readDiscreteActuator)(uint8_t id);
+        uint8_t (*discreteActuatorWrite_CLBK)(uint8_t id, uint8_t state);
+#endif
+#if RCPT_STEPPERS
+        Floats2 (*readStepper)(uint8_t id);
+        Floats2 (*stepperWrite_CLBK)(uint8_t id, RCP_StepperControlMode controlMode, float controlVal);
+#endif
+#if RCPT_MOTORS
+        float (*readMotor)(uint8_t id);
+        float (*motorWrite_CLBK)(uint8_t id, float value);
+#endif
+#if RCPT_ANGLED_ACTUATORS
+        float (*readAngledActuator)(uint8_t id);
+        float (*angledActuatorWrite_CLBK)(uint8_t id, float controlVal);
+#endif
+        Floats4 (*readSensor)(RCP_DeviceClass devclass, uint8_t id);
+        bool (*readBoolSensor)(uint8_t id);
+        void (*writeSensorTare)(RCP_DeviceClass devclass, uint8_t id, uint8_t dataChannel, float tareVal);
+#if RCPT_CUSTOM_DATA
+        void (*handleCustomData)(const void* data, uint8_t length);
+#endif
+    };
+
+    // Serves ch as well, with its own callbacks and procedures (nullptr for Test::getTests()). Returns false if ch is
+    // RCP::channel or already served, or RCPT_CHANNELS are served already.
+    bool addChannel(RCP_Channel ch, const ChannelCallbacks& callbacks, Test::Tests* tests = nullptr);
+    // Stops serving every channel added with addChannel()
+    void removeChannels();
+    // Channels served, including the primary one
+    uint8_t getChannelCount();
+
+    // Called through RCPT_CALLBACK(): the callbacks of RCP::channel, or nullptr for the primary channel
+    const ChannelCallbacks* channelCallbacks();
+
+    template<typename Hook>
+    Hook channelCallback(Hook ChannelCallbacks::*callback, Hook hook) {
+        const ChannelCallbacks* callbacks = channelCallbacks();
+        return callbacks != nullptr && callbacks->*callback != nullptr ? callbacks->*callback : hook;
+    }
+
+// The hook of RCP::channel for name
+#define RCPT_CALLBACK(name) (::RCP::channelCallback(&::RCP::ChannelCallbacks::name, ::RCP::name))
+#else
+#define RCPT_CALLBACK(name) (::RCP::name)
+#endif
+} // namespace RCP
+
+#endif // CHANNELS_H
@@ -0,0 +1,153 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+ * Compile time feature selection. Device classes, procedures, prompts, custom data and statistics are on by default.
+ * A board that only uses some device classes can turn the rest off, which removes their yield() handlers, the
+ * read/write functions and callbacks for them, and whatever send functions nothing else needs. Packets for a disabled
+ * class are counted as unknown and otherwise ignored.
+ *
+ * Set the macros with compiler definitions (build_flags in platformio.ini, target_compile_definitions() in
+ * CMake), or in an RCPT_Config.h on the include path, which is included here if it exists:
+ *
+ *     // RCPT_Config.h for a board with valves and pressure transducers
+ *     #define RCPT_STEPPERS 0
+ *     #define RCPT_ANGLED_ACTUATORS 0
+ *     #define RCPT_MOTORS 0
+ *     #define RCPT_DISCRETE_ACTUATORS 0
+ *     #define RCPT_TWO_FLOAT_SENSORS 0
+ *     #define RCPT_THREE_FLOAT_SENSORS 0
+ *     #define RCPT_FOUR_FLOAT_SENSORS 0
+ *     #define RCPT_BOOL_SENSORS 0
+ *     #define RCPT_PROMPTS 0
+ *     #define RCPT_PROCEDURES 0
+ *
+ * RCPT_PROCEDURES 0 removes the testing framework: procedures, coroutine and bytecode procedures, runTest() and the
+ * fixed rate executor. Test start requests are then ignored, and ESTOP() only calls ESTOP_ACTION and reports the
+ * ESTOP state. RCPT_PROMPTS 0 removes setPrompt() and prompt answers, and bytecode prompts are rejected on upload,
+ * as are instructions for any disabled actuator class. RCPT_CUSTOM_DATA 0 removes handleCustomData(), so custom
+ * packets from the host (including diagnostics requests) are dropped; the target can still send debug strings.
+ *
+ * RCPT_RX_BUFFER_SIZE is the size of the receive buffer packets are assembled in (up to 65535), and
+ * RCPT_RX_BYTES_PER_LOOP how many bytes each yield() reads into it (up to 255). A board that receives bursts of
+ * commands faster than its main loop parses them needs a bigger buffer; a slow board may want fewer bytes per loop.
+ * RCP::setAdaptiveRxBudget() can also vary the bytes per loop at runtime.
+ *
+ * Extra links, aggregation, routing and channels cost RAM on every board, so they are opt-in. RCPT_TRANSPORTS is how
+ * many links can be added besides the write()/read() hooks (see transports.h); 0 leaves just the hooks.
+ * RCPT_AGGREGATION_MTU is the largest frame packets can be aggregated into (see aggregation.h), up to 255; each link
+ * gets a buffer that size, and 0 leaves aggregation out. RCPT_ROUTER 1 adds routing to daisy-chained targets (see
+ * router.h), which needs RCPT_TRANSPORTS. RCPT_CHANNELS is how many channels one firmware can serve (see channels.h),
+ * up to 4; each takes its own test slots and heartbeat state, and 1 serves RCP::channel alone.
+ *
+ * RCPT_STATS 0 removes the runtime statistics counters (see stats.h). RCPT_TRACE 1 adds the event trace ring of
+ * RCPT_TRACE_EVENTS entries (see trace.h).
+ *
+ * The library must be built with the same settings as the code that uses it. The RCPT_Footprint CMake target reports
+ * the flash and RAM used by a reference firmware in a few configurations.
+ */
+
+#if __has_include("RCPT_Config.h")
+#include "RCPT_Config.h"
+#endif
+
+// Actuators
+#ifndef RCPT_SIMPLE_ACTUATORS
+#define RCPT_SIMPLE_ACTUATORS 1
+#endif
+
+#ifndef RCPT_STEPPERS
+#define RCPT_STEPPERS 1
+#endif
+
+#ifndef RCPT_ANGLED_ACTUATORS
+#define RCPT_ANGLED_ACTUATORS 1
+#endif
+
+#ifndef RCPT_MOTORS
+#define RCPT_MOTORS 1
+#endif
+
+#ifndef RCPT_DISCRETE_ACTUATORS
+#define RCPT_DISCRETE_ACTUATORS 1
+#endif
+
+// Sensors, grouped by how many floats they report. One: AM pressure, temperature, pressure transducer, hygrometer,
+// load cell, flow meter, altitude, radio strength. Two: power monitor. Three: accelerometer, gyroscope, magnetometer,
+// roll/pitch/yaw. Four: GPS, quaternion.
+#ifndef RCPT_ONE_FLOAT_SENSORS
+#define RCPT_ONE_FLOAT_SENSORS 1
+#endif
+
+#ifndef RCPT_TWO_FLOAT_SENSORS
+#define RCPT_TWO_FLOAT_SENSORS 1
+#endif
+
+#ifndef RCPT_THREE_FLOAT_SENSORS
+#define RCPT_THREE_FLOAT_SENSORS 1
+#endif
+
+#ifndef RCPT_FOUR_FLOAT_SENSORS
+#define RCPT_FOUR_FLOAT_SENSORS 1
+#endif
+
+#ifndef RCPT_BOOL_SENSORS
+#define RCPT_BOOL_SENSORS 1
+#endif
+
+#ifndef RCPT_PROMPTS
+#define RCPT_PROMPTS 1
+#endif
+
+#ifndef RCPT_CUSTOM_DATA
+#define RCPT_CUSTOM_DATA 1
+#endif
+
+#ifndef RCPT_PROCEDURES
+#define RCPT_PROCEDURES 1
+#endif
+
+#ifndef RCPT_RX_BUFFER_SIZE
+#define RCPT_RX_BUFFER_SIZE 128
+#endif
+
+#ifndef RCPT_RX_BYTES_PER_LOOP
+#define RCPT_RX_BYTES_PER_LOOP 20
+#endif
+
+#ifndef RCPT_TRANSPORTS
+#define RCPT_TRANSPORTS 0
+#endif
+
+#ifndef RCPT_AGGREGATION_MTU
+#define RCPT_AGGREGATION_MTU 0
+#endif
+
+#ifndef RCPT_ROUTER
+#define RCPT_ROUTER 0
+#endif
+
+#ifndef RCPT_CHANNELS
+#define RCPT_CHANNELS 1
+#endif
+
+// Diagnostics
+#ifndef RCPT_STATS
+#define RCPT_STATS 1
+#endif
+
+#ifndef RCPT_TRACE
+#define RCPT_TRACE 0
+#endif
+
+#ifndef RCPT_TRACE_EVENTS
+#define RCPT_TRACE_EVENTS 128
+#endif
+
+// The sendNFloat() functions exist if a device class that is enabled reports that many floats
+#define RCPT_SEND_ONE_FLOAT (RCPT_ONE_FLOAT_SENSORS || RCPT_ANGLED_ACTUATORS || RCPT_MOTORS)
+#define RCPT_SEND_TWO_FLOAT (RCPT_TWO_FLOAT_SENSORS || RCPT_STEPPERS)
+#define RCPT_SEND_THREE_FLOAT RCPT_THREE_FLOAT_SENSORS
+#define RCPT_SEND_FOUR_FLOAT RCPT_FOUR_FLOAT_SENSORS
+
+#endif // CONFIG_H
@@ -0,0 +1,194 @@
+#ifndef COPROCEDURES_H
+#define COPROCEDURES_H
+
+/*
+ * Coroutine procedures let a test sequence be written as straight line code instead of a tree of
+ * SequentialProcedure/ParallelProcedure objects:
+ *
+ *     Test::Task ignition() {
+ *         RCP::writeSimpleActuator(IGNITER, RCP_SIMPLE_ACTUATOR_ON);
+ *         co_await Test::wait(500);
+ *         co_await Test::all(Test::until(chamberPressurized), Test::wait(2000));
+ *     }
+ *
+ *     Test::CoroutineProcedure ignitionProc(&ignition);
+ *
+ * Anything that is a Procedure can be co_awaited, and is driven with the usual initialize/execute/isFinished/end
+ * cycle from RCP::runTest(). Coroutine frames are allocated from a static pool, so no heap allocation happens.
+ * This is only available when compiling with C++20 (RCPT_CXX20 in the CMake build); the C++17 API is unchanged.
+ */
+
+#include "config.h"
+
+#if RCPT_PROCEDURES && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define RCPT_COROUTINES
+
+#include <coroutine>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "procedures.h"
+
+namespace Test {
+    constexpr size_t COROUTINE_FRAME_SIZE = 256;
+    constexpr size_t COROUTINE_FRAME_COUNT = 8;
+
+    namespace CoroutinePool {
+        // Returns nullptr if the frame is too large or the pool is exhausted
+        void* allocate(size_t size) noexcept;
+        void deallocate(void* frame) noexcept;
+        size_t available();
+        // Times allocate() returned nullptr
+        uint32_t failures();
+    } // namespace CoroutinePool
+
+    struct ProcedureAwaiter {
+        Procedure& proc;
+
+        bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        void await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            proc.initialize();
+            handle.promise().awaiting = &proc;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    class Task : public Procedure {
+    public:
+        struct promise_type {
+            Procedure* awaiting = nullptr;
+
+            static void* operator new(size_t size) noexcept { return CoroutinePool::allocate(size); }
+            static void operator delete(void* frame) noexcept { CoroutinePool::deallocate(frame); }
+            static Task get_return_object_on_allocation_failure() noexcept {
+                Task task;
+                task.allocationFailed = true;
+                return task;
+            }
+
+            Task get_return_object() noexcept {
+                return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept {}
+
+            ProcedureAwaiter await_transform(Procedure& proc) noexcept { return {proc}; }
+            ProcedureAwaiter await_transform(Procedure&& proc) noexcept { return {proc}; }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+        bool allocationFailed;
+
+        explicit Task(std::coroutine_handle<promise_type> handle);
+
+    public:
+        Task();
+        Task(Task&& other) noexcept;
+        Task& operator=(Task&& other) noexcept;
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() override;
+
+        // False if the coroutine frame could not be allocated from the pool. Initializing such a task ESTOPs, since
+        // the steps after it would otherwise run without it.
+        bool valid() const;
+
+        void initialize() override;
+        void execute() override;
+        void end(bool interrupted) override;
+        bool isFinished() override;
+    };
+
+    // Adapter that can be placed in Tests. Each time it is initialized a fresh coroutine is started from body.
+    class CoroutineProcedure : public Procedure {
+    public:
+        using Body = Task (*)();
+
+    private:
+        const Body body;
+        Task task;
+
+    public:
+        explicit CoroutineProcedure(Body body);
+
+        void initialize() override;
+        void execute() override;
+        void end(bool interrupted) override;
+        bool isFinished() override;
+    };
+
+    // Same as ParallelProcedure and ParallelRaceProcedure, but holds references to its procedures instead of
+    // owning heap allocated copies. Intended to be constructed inside of a co_await expression with all/race.
+    template<size_t N>
+    class Join : public Procedure {
+        Procedure* procedures[N];
+        bool running[N];
+        const bool race;
+
+    public:
+        template<typename... Procs>
+        explicit Join(bool race, Procs&... procs) : procedures{&procs...}, running{}, race(race) {}
+
+        void initialize() override {
+            for(size_t i = 0; i < N; i++) {
+                procedures[i]->initialize();
+                running[i] = true;
+            }
+        }
+
+        void execute() override {
+            for(size_t i = 0; i < N; i++) {
+                if(!running[i]) continue;
+                procedures[i]->execute();
+
+                if(procedures[i]->isFinished()) {
+                    procedures[i]->end(false);
+                    running[i] = false;
+                }
+            }
+        }
+
+        void end(bool interrupted) override {
+            if(!interrupted && !race) return;
+            for(size_t i = 0; i < N; i++) {
+                if(!running[i]) continue;
+                procedures[i]->end(true);
+                running[i] = false;
+            }
+        }
+
+        bool isFinished() override {
+            for(size_t i = 0; i < N; i++) {
+                if(running[i] != race) return race;
+            }
+            return !race;
+        }
+    };
+
+    inline WaitProcedure wait(unsigned long waitTime) { return WaitProcedure(waitTime); }
+
+    inline BoolWaiter until(BoolSupplier supplier) { return BoolWaiter(supplier); }
+
+    // Finishes when all of procs have finished
+    template<typename... Procs>
+    Join<sizeof...(Procs)> all(Procs&&... procs) {
+        return Join<sizeof...(Procs)>(false, procs...);
+    }
+
+    // Finishes when any of procs finishes. The others are interrupted.
+    template<typename... Procs>
+    Join<sizeof...(Procs)> race(Procs&&... procs) {
+        return Join<sizeof...(Procs)>(true, procs...);
+    }
+} // namespace Test
+
+#endif
+
+#endif // COPROCEDURES_H
@@ -0,0 +1,52 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+/*
+ * Target diagnostics are carried in custom packets, so hosts that do not know about them are unaffected. Call
+ * handleDiagnostics() from RCP::handleCustomData(); it returns true if the packet was a diagnostics request.
+ *
+ * A request is DIAGNOSTICS_MAGIC followed by an RCP_DiagnosticsType. It is answered with one or more custom packets of
+ * DIAGNOSTICS_MAGIC, the type of the reply, and its payload. Multi byte values are big endian, like timestamps.
+ *
+ *   RCP_DIAG_EXECUTOR          uint32 ticks, missed, skipped, max jitter (us), last period (us), period (us)
+ *                              followed by RCP_DIAG_EXECUTOR_JITTER and RCP_DIAG_EXECUTOR_MISSED replies
+ *   RCP_DIAG_EXECUTOR_JITTER   EXECUTOR_JITTER_BUCKETS x uint32, see executor.h
+ *   RCP_DIAG_EXECUTOR_MISSED   EXECUTOR_MISSED_BUCKETS x uint32, see executor.h
+ *   RCP_DIAG_REDLINE_TRIP      uint16 rule, uint32 time, float value for each logged trip, oldest first, up to
+ *                              six per packet. Also sent unrequested whenever a redline trips. See redlines.h
+ *   RCP_DIAG_STATS             uint32 rx bytes, rx packets, rx dropped, unknown class, foreign channel, tx bytes,
+ *                              tx packets, yield max, yield mean, runTest max, runTest mean (us), rx buffer high
+ *                              water mark, rx budget of the last yield, mean time between yields (us). A request
+ *                              with a uint16 interval in ms also streams the reply at that interval. See stats.h
+ *   RCP_DIAG_TRACE             uint32 time, uint8 type, uint8 arg, uint16 data for each traced event, oldest first,
+ *                              up to seven per packet, followed by an empty RCP_DIAG_TRACE packet. See trace.h
+ *   RCP_DIAG_TEST_SLOTS        uint8 state | test number for each active test. Also sent unrequested after the test
+ *                              state packet while more than one test is active, which keeps that packet at 5 bytes
+ *   RCP_DIAG_RESET             resets all statistics and logs and replies with an empty RCP_DIAG_RESET packet
+ */
+
+#include <stdint.h>
+
+namespace RCP {
+    constexpr uint8_t DIAGNOSTICS_MAGIC = 0xD1;
+
+    typedef enum {
+        RCP_DIAG_EXECUTOR = 0x01,
+        RCP_DIAG_EXECUTOR_JITTER = 0x02,
+        RCP_DIAG_EXECUTOR_MISSED = 0x03,
+        RCP_DIAG_REDLINE_TRIP = 0x04,
+        RCP_DIAG_STATS = 0x05,
+        RCP_DIAG_TRACE = 0x06,
+        RCP_DIAG_TEST_SLOTS = 0x07,
+        RCP_DIAG_RESET = 0x7F,
+    } RCP_DiagnosticsType;
+
+    bool handleDiagnostics(const void* data, uint8_t length);
+
+    // Sends a diagnostics packet. Payloads longer than 61 bytes are not sent.
+    void sendDiagnostics(RCP_DiagnosticsType type, const uint8_t* payload, uint8_t length);
+    // Sends count uint32 values as a big endian payload
+    void sendDiagnostics(RCP_DiagnosticsType type, const uint32_t* values, uint8_t count);
+} // namespace RCP
+
+#endif // DIAGNOSTICS_H
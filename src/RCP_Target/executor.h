@@ -0,0 +1,66 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+/*
+ * Fixed rate execution of tests. Instead of calling RCP::runTest() every time through the main loop, call
+ * RCP::runFixedRate() and the tests are executed once per period, no matter how long yield() and the rest of the loop
+ * took:
+ *
+ *     RCP::setFixedRate(1000, RCP_EXECUTOR_CATCH_UP); // 1 kHz
+ *
+ *     void loop() {
+ *         RCP::yield();
+ *         RCP::runFixedRate();
+ *     }
+ *
+ * By default ticks are scheduled from systimeMicros(). A hardware timer can be used instead by calling
+ * RCP::fixedRateTimerTick() from its interrupt; runFixedRate() then runs one tick for every timer tick since it was
+ * last called. fixedRateTimerTick() only counts the tick, so it is safe to call from an ISR.
+ *
+ * A tick is missed when runFixedRate() is called more than a period late. RCP_EXECUTOR_CATCH_UP runs the missed ticks
+ * back to back, up to maxCatchUp of them, and skips the rest. RCP_EXECUTOR_SKIP drops all of them and runs the next
+ * tick on schedule. Either way the schedule never drifts.
+ *
+ * While ESTOPped, runFixedRate() runs the ESTOP procedure on every call instead of waiting for the next tick.
+ *
+ * The statistics are reported over RCP with the RCP_DIAG_EXECUTOR diagnostics request (see diagnostics.h).
+ */
+
+#include <stdint.h>
+
+namespace RCP {
+    typedef enum {
+        RCP_EXECUTOR_CATCH_UP = 0x00,
+        RCP_EXECUTOR_SKIP = 0x01,
+    } RCP_ExecutorPolicy;
+
+    // Jitter bucket i counts ticks that started less than 2^i us late (bucket 0 is exactly on time). The last bucket
+    // counts everything later than that.
+    constexpr uint8_t EXECUTOR_JITTER_BUCKETS = 12;
+    // Missed bucket i counts the times i + 1 ticks were missed in a row. The last bucket counts that many or more.
+    constexpr uint8_t EXECUTOR_MISSED_BUCKETS = 8;
+
+    struct ExecutorStats {
+        uint32_t ticks;
+        uint32_t missed;
+        uint32_t skipped;
+        uint32_t maxJitter;
+        uint32_t lastPeriod;
+        uint32_t jitter[EXECUTOR_JITTER_BUCKETS];
+        uint32_t missedRuns[EXECUTOR_MISSED_BUCKETS];
+    };
+
+    // A period of 0 turns the fixed rate executor off, and runFixedRate() calls runTest() every time
+    void setFixedRate(uint32_t periodMicros, RCP_ExecutorPolicy policy = RCP_EXECUTOR_CATCH_UP, uint8_t maxCatchUp = 4);
+    uint32_t getFixedRatePeriod();
+
+    // Runs the ticks that are due. Returns the number of ticks run, up to maxCatchUp + 1.
+    uint16_t runFixedRate();
+    void fixedRateTimerTick();
+
+    const ExecutorStats& getExecutorStats();
+    void resetExecutorStats();
+    void sendExecutorStats();
+} // namespace RCP
+
+#endif // EXECUTOR_H
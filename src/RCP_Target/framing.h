@@ -0,0 +1,147 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+/*
+ * Optional COBS framing under the RCP packets, for links that lose or corrupt bytes, such as radios. On a raw link a
+ * single lost byte shifts every packet boundary after it until the parser happens to line up again. With
+ * RCP_FRAMING_COBS each packet is sent as one COBS frame (consistent overhead byte stuffing, Cheshire and Baker 1999),
+ * which has no zero bytes, followed by a zero delimiter. The receiver starts over at every zero, so a lost, flipped or
+ * extra byte costs the frame it is in, and at most the one after it if it was the delimiter.
+ *
+ *     RCP::setFraming(RCP_FRAMING_COBS);      // link 0, the write()/read() hooks
+ *     RCP::setFraming(RCP_FRAMING_COBS, 1);   // a link added with addTransport(), see transports.h
+ *
+ * Both ends have to use the same framing. Frames are at most MAX_FRAME bytes. A frame that does not decode to exactly
+ * one packet, whose length matches its header, is dropped and counted in getFramingStats(). The framing does not
+ * detect a corrupted byte that leaves the frame structure intact; links that flip bits need their own checksum, as
+ * most radios have.
+ *
+ * The capture tap sees the decoded packets, so captures replay the same whether or not the link was framed.
+ * scanRxBytes() does nothing while link 0 is framed; an ESTOP is acted on as soon as its frame is complete instead.
+ * cobsEncode() and CobsDecoder also work on their own, for a host talking to a framed target.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+    RCP_FRAMING_RAW = 0x00,
+    RCP_FRAMING_COBS = 0x01,
+} RCP_Framing;
+
+namespace RCP {
+    // The longest packet, its COBS code byte and the delimiter
+    constexpr uint8_t MAX_FRAME = 65 + 2;
+
+    // Room cobsEncode() needs for length bytes
+    constexpr size_t cobsEncodedSize(size_t length) { return length + length / 254 + 2; }
+
+    // Writes length bytes of src to dst as one COBS frame, delimiter included, and returns the frame length. dst needs
+    // cobsEncodedSize(length) bytes.
+    size_t cobsEncode(const uint8_t* src, size_t length, uint8_t* dst);
+
+    struct FramingStats {
+        uint32_t frames;
+        // Frames dropped because they were cut short, too long or (on RCP links) not one whole packet
+        uint32_t badFrames;
+    };
+
+    // Whether a decoded frame is exactly one RCP packet
+    inline bool isPacketFrame(const uint8_t* frame, size_t length) {
+        if(length == 0) return false;
+        // The header without the channel bits
+        uint8_t pktlen = frame[0] & 0x3F;
+        return pktlen == 0 ? length == 1 : length == pktlen + 2u;
+    }
+
+    // Sets the framing of link 0, or of a link added with addTransport(). Drops what was received from the link but
+    // not handled yet.
+    void setFraming(RCP_Framing framing, uint8_t link = 0);
+    RCP_Framing getFraming(uint8_t link = 0);
+    // Counted since init()
+    FramingStats getFramingStats(uint8_t link = 0);
+
+    // Decodes a COBS byte stream that arrives in chunks of any size, frame by frame. Frames longer than SIZE bytes are
+    // dropped.
+    template<size_t SIZE = 65>
+    class CobsDecoder {
+        uint8_t frame[SIZE];
+        size_t length = 0;
+        // Data bytes left in the current block; 0 means the next byte is a code byte
+        uint8_t remaining = 0;
+        // A block shorter than 254 bytes ends in a zero, unless it is the last in the frame
+        bool zeroPending = false;
+        bool overflow = false;
+
+        void append(const uint8_t* data, size_t count) {
+            if(overflow || length + count > SIZE) {
+                overflow = true;
+                return;
+            }
+
+            memcpy(frame + length, data, count);
+            length += count;
+        }
+
+    public:
+        FramingStats stats = {};
+
+        // Forgets the frame being received
+        void reset() {
+            length = 0;
+            remaining = 0;
+            zeroPending = false;
+            overflow = false;
+        }
+
+        // Decodes a chunk of the stream. onFrame(const uint8_t* frame, size_t length) is called for each complete
+        // frame, and returns false if the frame was not valid for it, which counts it as bad.
+        template<typename OnFrame>
+        void decode(const uint8_t* data, size_t count, OnFrame&& onFrame) {
+            const uint8_t* end = data + count;
+            while(data < end) {
+                if(remaining != 0) {
+                    // The run of data bytes up to the end of the block, or to a delimiter that cuts it short
+                    size_t run = static_cast<size_t>(end - data) < remaining ? end - data : remaining;
+                    const auto* zero = static_cast<const uint8_t*>(memchr(data, 0, run));
+                    if(zero == nullptr) {
+                        append(data, run);
+                        data += run;
+                        remaining -= run;
+                        continue;
+                    }
+
+                    // Truncated frame: the delimiter starts over
+                    stats.frames++;
+                    stats.badFrames++;
+                    reset();
+                    data = zero + 1;
+                    continue;
+                }
+
+                uint8_t code = *data++;
+                if(code == 0) {
+                    // Empty frames are only delimiters in a row
+                    if(length != 0 || zeroPending || overflow) {
+                        stats.frames++;
+                        if(overflow || !onFrame(static_cast<const uint8_t*>(frame), length)) stats.badFrames++;
+                    }
+
+                    reset();
+                    continue;
+                }
+
+                if(zeroPending) {
+                    const uint8_t zeroByte = 0;
+                    append(&zeroByte, 1);
+                }
+
+                remaining = code - 1;
+                zeroPending = code != 0xFF;
+            }
+        }
+    };
+} // namespace RCP
+
+#endif // FRAMING_H
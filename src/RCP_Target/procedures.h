@@ -107,12 +107,14 @@ namespace Test {
         Procedure** const procedures;
         const unsigned int numProcedures;
         bool* const running;
+        // Child to execute first, so a runTest() budget that cuts execute() short resumes where it left off
+        unsigned int cursor;
 
     public:
         template<typename... Procs>
         explicit ParallelProcedure(Procs... procs) :
             procedures(new Procedure* [sizeof...(Procs)] { procs... }), numProcedures(sizeof...(Procs)),
-            running(new bool[sizeof...(Procs)]) {
+            running(new bool[sizeof...(Procs)]), cursor(0) {
             memset(running, 0, numProcedures);
         }
         ~ParallelProcedure() override;
@@ -138,12 +140,13 @@ namespace Test {
         bool* const running;
         Procedure* const deadline;
         bool deadlineRunning;
+        unsigned int cursor;
 
     public:
         template<typename... Procs>
         explicit ParallelDeadlineProcedure(Procedure* deadline, Procs... procs) :
             procedures(new Procedure* [sizeof...(Procs)] { procs... }), numProcedures(sizeof...(Procs)),
-            running(new bool[sizeof...(Procs)]), deadline(deadline), deadlineRunning(false) {
+            running(new bool[sizeof...(Procs)]), deadline(deadline), deadlineRunning(false), cursor(0) {
             memset(running, 0, numProcedures);
         }
 
@@ -0,0 +1,93 @@
+#ifndef REDLINES_H
+#define REDLINES_H
+
+/*
+ * Redlines are limits that are checked on the target every time a sensor is sampled, so an abort does not have to
+ * wait for the host to see the telemetry and send an ESTOP.
+ *
+ * The table is an array owned by the user, set with RCP::setRedlines(). Redlines are evaluated by sampleSensor()
+ * and sampleBoolSensor(), which call readSensor()/readBoolSensor() and check the result against every rule for that
+ * sensor. RCP samples through these itself (sensor read packets, bytecode sensor waits), and the user program should
+ * too wherever it reads sensors. Values that were read some other way can be checked with evaluateRedlines().
+ *
+ *     RCP::Redline redlines[] = {
+ *         // Tank over 800 psi for 3 samples in a row: ESTOP. Re-arms once it falls below 750.
+ *         {RCP_DEVCLASS_PRESSURE_TRANSDUCER, TANK_PT, 0, RCP_REDLINE_ABOVE, 800, 50, 3, RCP_REDLINE_ESTOP},
+ *         // Chamber thermocouple over 500: open the purge valve
+ *         {RCP_DEVCLASS_TEMPERATURE, CHAMBER_TC, 0, RCP_REDLINE_ABOVE, 500, 10, 1, RCP_REDLINE_SIMPLE_ACTUATOR,
+ *          PURGE_VALVE, RCP_SIMPLE_ACTUATOR_ON},
+ *     };
+ *
+ *     RCP::setRedlines(redlines, 2);
+ *
+ * A rule trips when its comparison holds for persistence samples in a row. It then runs its action once, and does
+ * not trip again until the value has come back past the threshold by at least the hysteresis. Bool sensors read as
+ * 1 or 0, so RCP_REDLINE_ABOVE with a threshold of 0.5 trips when the sensor is true. An ESTOP rule that trips
+ * inside a running procedure, such as a sensor wait, ends the procedure right there; the ESTOP sequence then runs from
+ * the next runTest().
+ *
+ * Every trip is logged with its millis() timestamp, rule index and value, and reported to the host with an
+ * RCP_DIAG_REDLINE_TRIP diagnostics packet. The log can be read back with an RCP_DIAG_REDLINE_TRIP request.
+ */
+
+#include <stdint.h>
+
+#include "RCP_Target.h"
+
+typedef enum {
+    RCP_REDLINE_ABOVE = 0x00,
+    RCP_REDLINE_BELOW = 0x01,
+} RCP_RedlineComparator;
+
+typedef enum {
+    RCP_REDLINE_ESTOP = 0x00,
+    // Starts test target with RCP::startProcedure()
+    RCP_REDLINE_START_PROCEDURE = 0x01,
+    // Writes state to simple actuator target
+    RCP_REDLINE_SIMPLE_ACTUATOR = 0x02,
+} RCP_RedlineAction;
+
+namespace RCP {
+    constexpr uint8_t REDLINE_LOG_SIZE = 16;
+
+    struct Redline {
+        RCP_DeviceClass devclass;
+        uint8_t id;
+        uint8_t channel;
+        RCP_RedlineComparator comparator;
+        float threshold;
+        float hysteresis;
+        uint8_t persistence;
+        RCP_RedlineAction action;
+        uint8_t target;
+        RCP_SimpleActuatorState state;
+
+        // Evaluation state, zero it before use
+        uint8_t count;
+        bool tripped;
+    };
+
+    struct RedlineTrip {
+        uint32_t time;
+        uint16_t rule;
+        float value;
+    };
+
+    // table must outlive its use. Pass nullptr to remove all redlines.
+    void setRedlines(Redline* table, uint16_t count);
+    // Re-arms every rule
+    void resetRedlines();
+
+    Floats4 sampleSensor(RCP_DeviceClass devclass, uint8_t id);
+    bool sampleBoolSensor(uint8_t id);
+    void evaluateRedlines(RCP_DeviceClass devclass, uint8_t id, const float* values, uint8_t numValues);
+
+    // Number of trips since the log was cleared, including those that have since been overwritten
+    uint32_t getRedlineTripCount();
+    // The index-th most recent trip. Returns false if there are not that many in the log.
+    bool getRedlineTrip(uint8_t index, RedlineTrip& trip);
+    void clearRedlineLog();
+    void sendRedlineLog();
+} // namespace RCP
+
+#endif // REDLINES_H
@@ -0,0 +1,73 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+/*
+ * Routing for targets daisy-chained on one host link. The host addresses up to four targets by the channel bits in
+ * each header; a target normally drops packets for the other channels. Once a link added with addTransport() is made
+ * the downstream link, packets for other channels are passed down it instead, and every packet the targets further
+ * down send is merged into what this target sends up:
+ *
+ *     RCP::channel = RCP_CH_ZERO;
+ *     uint8_t next = RCP::addTransport({uart2Write, uart2Available, uart2Read});
+ *     RCP::setDownstream(next);
+ *     RCP::init();
+ *
+ * The targets further down set their own channels and need nothing else; one of them can route in turn.
+ *
+ * Forwarding is cut-through from link 0: only the header is looked at, and the rest of the packet is written down as
+ * soon as it is read, rather than once the whole packet is in. Packets from the other added links are forwarded
+ * whole; one that completes while a link 0 packet is still going down waits for it, and is dropped if another one is
+ * already waiting. A framed downstream link (see framing.h) also gets whole packets, since COBS can not be encoded
+ * before the end of the packet is known.
+ *
+ * ESTOPs go down the chain on every channel, as well as stopping this target. What comes up the downstream link is
+ * sent like this target's own packets: through the telemetry policies, framing and aggregation of each upstream link,
+ * and past the capture tap. Nothing is sent down the downstream link but forwarded packets.
+ *
+ * Routing is opt-in: build with RCPT_ROUTER 1 (see config.h), which needs RCPT_TRANSPORTS.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+
+#if RCPT_ROUTER && !RCPT_TRANSPORTS
+#error "RCPT_ROUTER needs RCPT_TRANSPORTS"
+#endif
+
+namespace RCP {
+#if RCPT_ROUTER
+    // Counted since init(), per channel: the channel is the index, the header's channel bits shifted down
+    struct RouterStats {
+        // Bytes passed down the chain, and merged into what is sent up from it
+        uint32_t downBytes[4];
+        uint32_t upBytes[4];
+        // Packets from added links dropped because two were waiting for a link 0 packet to go down
+        uint32_t dropped;
+    };
+
+    // Makes a link added with addTransport() the downstream link, or stops routing for 0
+    void setDownstream(uint8_t link);
+    uint8_t getDownstream();
+    const RouterStats& getRouterStats();
+
+    // Called by dispatchPacket() with the bytes of a link 0 packet for another channel as they are read. remaining is
+    // how much of the packet is still to come.
+    void cutThrough(const uint8_t* data, uint8_t length, uint8_t remaining);
+    // Called by handlePacket() with whole packets for other channels from added links. Returns false if there is no
+    // downstream link.
+    bool routePacket(const uint8_t* packet);
+    // Called by setFraming() when the rest of the link 0 packet going down will not come
+    void abortCutThrough();
+    // Called by dispatchPacket() and handlePacket() for every ESTOP
+    void routeEstop(uint8_t head);
+    // Called by pollTransports() and writeTransports()
+    bool isDownstream(uint8_t link);
+    // Called by pollTransports() with each packet from the downstream link
+    void routeUpstream(const uint8_t* packet);
+    // Called by init()
+    void resetRouter();
+#endif
+} // namespace RCP
+
+#endif // ROUTER_H
@@ -0,0 +1,72 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * Runtime counters for the things RCP otherwise does silently: bytes dropped because the receive buffer was full,
+ * packets for other channels or unknown device classes, how much was sent, and how long yield() and runTest() take.
+ *
+ * The counters are on by default. Build with RCPT_STATS defined to 0 (see config.h) to compile them out entirely;
+ * RCPT_STAT() then expands to nothing and none of the functions below exist.
+ *
+ * The counters are reported over RCP with the RCP_DIAG_STATS diagnostics request (see diagnostics.h). A two byte big
+ * endian interval in ms after the request also streams them every interval from yield(); an interval of 0 stops the
+ * stream. Durations are in systimeMicros() units.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+
+#if RCPT_STATS
+#define RCPT_STAT(expr) (::RCP::runtimeStats.expr)
+#else
+#define RCPT_STAT(expr) ((void) 0)
+#endif
+
+namespace RCP {
+    struct DurationStats {
+        uint32_t count;
+        uint32_t max;
+        uint64_t total;
+
+        void record(uint32_t duration) {
+            count++;
+            total += duration;
+            if(duration > max) max = duration;
+        }
+
+        uint32_t mean() const { return count == 0 ? 0 : total / count; }
+    };
+
+    struct RuntimeStats {
+        uint32_t rxBytes;
+        uint32_t rxPackets;
+        // Bytes lost because the receive buffer was full
+        uint32_t rxDropped;
+        // Most bytes the receive buffer has held
+        uint32_t rxHighWater;
+        uint32_t unknownClass;
+        uint32_t foreignChannel;
+        uint32_t txBytes;
+        uint32_t txPackets;
+        DurationStats yield;
+        DurationStats runTest;
+    };
+
+#if RCPT_STATS
+    // Updated by the library through RCPT_STAT(). Read it with getRuntimeStats().
+    extern RuntimeStats runtimeStats;
+
+    const RuntimeStats& getRuntimeStats();
+    void resetRuntimeStats();
+    void sendRuntimeStats();
+
+    // Sends the counters every intervalMs from yield(). 0 stops streaming.
+    void setRuntimeStatsInterval(uint32_t intervalMs);
+    uint32_t getRuntimeStatsInterval();
+    // Called by yield()
+    void streamRuntimeStats();
+#endif
+} // namespace RCP
+
+#endif // STATS_H
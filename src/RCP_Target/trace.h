@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * An event trace for finding out what the target did in the moments before something went wrong. Build with
+ * RCPT_TRACE defined to 1 (see config.h, or CMake option RCPT_TRACE) to record fixed size events into a RAM ring of
+ * RCPT_TRACE_EVENTS entries (a power of two, 128 by default, 8 bytes each). Without it RCPT_TRACE_EVENT() expands to
+ * nothing.
+ *
+ *   RCP_TRACE_RX                 devclass, packet length    a complete packet was taken from the receive buffer
+ *   RCP_TRACE_DISPATCHED         devclass                   the packet has been handled
+ *   RCP_TRACE_TX                 devclass, packet length    a packet was passed to write()
+ *   RCP_TRACE_PROC_INIT          slot, test number          a test was initialized
+ *   RCP_TRACE_PROC_END           slot, 1 if interrupted     a test ended
+ *   RCP_TRACE_ESTOP                                         the ESTOP procedure was started
+ *   RCP_TRACE_HEARTBEAT                                     a heartbeat was received
+ *   RCP_TRACE_HEARTBEAT_TIMEOUT                             the heartbeat watchdog ESTOPped the target
+ *
+ * Events are timestamped with traceTimestamp(), which defaults to systimeMicros(). Override it to use a cycle counter.
+ * traceHook() is called for every event as it is recorded; override it to toggle a pin or forward events elsewhere.
+ * Recording is not interrupt safe, so only the main loop records events.
+ *
+ * The ring is dumped over RCP with the RCP_DIAG_TRACE diagnostics request (see diagnostics.h), oldest event first.
+ * Recording is paused while the dump is sent. tools/trace2chrome.py turns a captured dump into a Chrome trace.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+
+#if RCPT_TRACE
+#define RCPT_TRACE_EVENT(type, arg, data) ::RCP::traceEvent(type, arg, data)
+#else
+#define RCPT_TRACE_EVENT(type, arg, data) ((void) 0)
+#endif
+
+namespace RCP {
+    typedef enum {
+        RCP_TRACE_RX = 0x01,
+        RCP_TRACE_DISPATCHED = 0x02,
+        RCP_TRACE_TX = 0x03,
+        RCP_TRACE_PROC_INIT = 0x04,
+        RCP_TRACE_PROC_END = 0x05,
+        RCP_TRACE_ESTOP = 0x06,
+        RCP_TRACE_HEARTBEAT = 0x07,
+        RCP_TRACE_HEARTBEAT_TIMEOUT = 0x08,
+    } RCP_TraceEventType;
+
+    struct TraceEvent {
+        uint32_t time;
+        uint8_t type;
+        uint8_t arg;
+        uint16_t data;
+    };
+
+#if RCPT_TRACE
+    constexpr uint16_t TRACE_EVENTS = RCPT_TRACE_EVENTS;
+    static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "RCPT_TRACE_EVENTS must be a power of two");
+
+    // Written only through traceEvent()
+    extern TraceEvent traceRing[TRACE_EVENTS];
+    extern uint32_t traceHead;
+    extern bool traceRecording;
+
+    uint32_t traceTimestamp();
+    void traceHook(RCP_TraceEventType type, uint8_t arg, uint16_t data);
+
+    inline void traceEvent(RCP_TraceEventType type, uint8_t arg, uint16_t data) {
+        if(traceRecording) traceRing[traceHead++ & (TRACE_EVENTS - 1)] = {traceTimestamp(), type, arg, data};
+        traceHook(type, arg, data);
+    }
+
+    uint16_t getTraceCount();
+    // Index 0 is the oldest event in the ring. Returns false if there is no such event.
+    bool getTraceEvent(uint16_t index, TraceEvent& event);
+    void clearTrace();
+    void sendTrace();
+#endif
+} // namespace RCP
+
+#endif // TRACE_H
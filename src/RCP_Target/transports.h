@@ -0,0 +1,88 @@
+#ifndef TRANSPORTS_H
+#define TRANSPORTS_H
+
+/*
+ * Links to more than one host at a time, such as USB to the test stand PC and a radio to the control bunker. The
+ * write(), readAvail() and read() hooks are link 0, and addTransport() adds up to RCPT_TRANSPORTS more (see config.h),
+ * each with its own set of functions. RCPT_TRANSPORTS is 0 by default, which leaves only the hooks.
+ *
+ * Commands are accepted from every link. Each added link has its own receive parser, so bytes from different links
+ * never end up in the same packet. yield() reads up to SERIAL_BYTES_PER_LOOP bytes from each added link and handles
+ * each packet as soon as it is complete, so a zero length header ESTOPs right when it is read. The capture tap and
+ * scanRxBytes() only see link 0.
+ *
+ * Every packet is built once, and sendPacket() writes the same bytes to each link. Control packets (test state,
+ * actuators, prompts, custom data) always go to every link. Telemetry, the sensor device classes from
+ * RCP_DEVCLASS_AM_PRESSURE up, can be thinned per link with a TelemetryPolicy: decimation sends one of every N packets
+ * of each sensor, and bytesPerSecond caps the telemetry bytes the link is given, allowing bursts of up to 100ms worth.
+ * Packets over it are dropped rather than queued, so the link always carries the latest values. For a radio that gets
+ * a tenth of what goes over USB:
+ *
+ *     RCP::addTransport({radioWrite, radioAvailable, radioRead}, {10, 2000});
+ *     RCP::init();
+ *
+ * Decimation counts packets per sensor for up to TELEMETRY_STREAMS sensors; any further sensors share one count.
+ * init() resets the parsers, counts and statistics, but keeps the links. Each link can also be framed on its own (see
+ * framing.h); a packet is then encoded once for all the framed links, and the rate limit counts the framed bytes.
+ * Packets that pass the policy can then be aggregated into larger frames per link (see aggregation.h). One link can
+ * lead to more targets further down a chain (see router.h).
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "framing.h"
+
+namespace RCP {
+#if RCPT_TRANSPORTS
+    constexpr uint8_t TELEMETRY_STREAMS = 32;
+
+    struct Transport {
+        void (*write)(const void* data, uint8_t length);
+        uint8_t (*readAvail)();
+        uint8_t (*read)();
+    };
+
+    struct TelemetryPolicy {
+        // Sends one of every decimation telemetry packets of each sensor. 0 and 1 send all of them.
+        uint8_t decimation;
+        // Telemetry bytes per second the link is given, 0 for no limit
+        uint32_t bytesPerSecond;
+    };
+
+    // Counted since init(). Link 0 only counts what it sent; what it received is in the runtime statistics.
+    struct TransportStats {
+        uint32_t rxBytes;
+        uint32_t rxPackets;
+        uint32_t txBytes;
+        uint32_t txPackets;
+        // Telemetry packets left out by decimation and by the rate limit
+        uint32_t decimated;
+        uint32_t rateLimited;
+    };
+
+    // Adds a link and returns its number, or 0 if RCPT_TRANSPORTS links have been added already
+    uint8_t addTransport(const Transport& transport, const TelemetryPolicy& policy = {});
+    // Removes every link added with addTransport()
+    void removeTransports();
+    // Links including link 0
+    uint8_t getTransportCount();
+    void setTelemetryPolicy(uint8_t link, const TelemetryPolicy& policy);
+    const TransportStats& getTransportStats(uint8_t link);
+
+    // Called by init()
+    void resetTransports();
+    // Called by yield()
+    void pollTransports();
+    // Called by sendPacket()
+    void writeTransports(const void* data, uint8_t length);
+    // Called by the aggregation (see aggregation.h) to send a frame on an added link
+    void writeTransport(uint8_t link, const void* data, uint8_t length);
+    // Called by setFraming(), getFraming() and getFramingStats() for added links
+    void setTransportFraming(uint8_t link, RCP_Framing framing);
+    RCP_Framing getTransportFraming(uint8_t link);
+    FramingStats getTransportFramingStats(uint8_t link);
+#endif
+} // namespace RCP
+
+#endif // TRANSPORTS_H
@@ -0,0 +1,128 @@
+#include "RCP_Target/aggregation.h"
+
+#if RCPT_AGGREGATION_MTU
+
+#include <string.h>
+
+#include "RCP_Target/transports.h"
+
+namespace RCP {
+    constexpr uint8_t LINKS = RCPT_TRANSPORTS + 1;
+
+    // The frame a link is building
+    struct Aggregator {
+        uint8_t mtu;
+        uint32_t maxAgeMicros;
+        uint8_t frame[RCPT_AGGREGATION_MTU];
+        uint8_t length;
+        uint8_t packets;
+        uint32_t startedAt;
+    };
+
+    static Aggregator aggregators[LINKS];
+    static AggregationStats stats[LINKS];
+    // Whether any link has a frame waiting, so yield() can skip looking at each one
+    static bool pending = false;
+
+    static void transmit([[maybe_unused]] uint8_t link, const uint8_t* data, uint8_t length) {
+#if RCPT_TRANSPORTS
+        if(link != 0) {
+            writeTransport(link, data, length);
+            return;
+        }
+#endif
+        write(data, length);
+    }
+
+    // Sends the frame being built, if there is one
+    static void send(uint8_t link, uint32_t& reason) {
+        Aggregator& aggregator = aggregators[link];
+        if(aggregator.length == 0) return;
+        transmit(link, aggregator.frame, aggregator.length);
+        stats[link].frames++;
+        stats[link].packets += aggregator.packets;
+        stats[link].bytes += aggregator.length;
+        reason++;
+        aggregator.length = 0;
+        aggregator.packets = 0;
+    }
+
+    static bool expired(const Aggregator& aggregator, uint32_t now) {
+        return aggregator.length != 0 && now - aggregator.startedAt >= aggregator.maxAgeMicros;
+    }
+
+    void setAggregation(uint8_t mtu, uint32_t maxAgeMicros, uint8_t link) {
+        if(link >= LINKS) return;
+        send(link, stats[link].manualFlushes);
+        aggregators[link].mtu = mtu < RCPT_AGGREGATION_MTU ? mtu : RCPT_AGGREGATION_MTU;
+        aggregators[link].maxAgeMicros = maxAgeMicros;
+        stats[link] = {};
+    }
+
+    void flushAggregation() {
+        for(uint8_t i = 0; i < LINKS; i++) send(i, stats[i].manualFlushes);
+        pending = false;
+    }
+
+    const AggregationStats& getAggregationStats(uint8_t link) { return stats[link < LINKS ? link : 0]; }
+
+    float getFrameFill(uint8_t link) {
+        if(link >= LINKS || stats[link].frames == 0 || aggregators[link].mtu == 0) return 0;
+        float capacity = static_cast<float>(stats[link].frames) * aggregators[link].mtu;
+        return static_cast<float>(stats[link].bytes) / capacity;
+    }
+
+    void aggregate(uint8_t link, const uint8_t* data, uint8_t length, bool control) {
+        Aggregator& aggregator = aggregators[link];
+        if(aggregator.mtu == 0) {
+            transmit(link, data, length);
+            return;
+        }
+
+        uint32_t now = systimeMicros();
+        if(expired(aggregator, now)) send(link, stats[link].ageFlushes);
+
+        if(aggregator.length + length > aggregator.mtu) {
+            send(link, stats[link].sizeFlushes);
+            // Too big for any frame
+            if(length > aggregator.mtu) {
+                transmit(link, data, length);
+                stats[link].frames++;
+                stats[link].packets++;
+                stats[link].bytes += length;
+                stats[link].sizeFlushes++;
+                return;
+            }
+        }
+
+        if(aggregator.length == 0) aggregator.startedAt = now;
+        memcpy(aggregator.frame + aggregator.length, data, length);
+        aggregator.length += length;
+        aggregator.packets++;
+
+        if(control) send(link, stats[link].controlFlushes);
+        else if(aggregator.length == aggregator.mtu) send(link, stats[link].sizeFlushes);
+        else pending = true;
+    }
+
+    void resetAggregation() {
+        for(uint8_t i = 0; i < LINKS; i++) {
+            aggregators[i].length = 0;
+            aggregators[i].packets = 0;
+            stats[i] = {};
+        }
+        pending = false;
+    }
+
+    void flushAgedFrames() {
+        if(!pending) return;
+        uint32_t now = systimeMicros();
+        pending = false;
+        for(uint8_t i = 0; i < LINKS; i++) {
+            if(expired(aggregators[i], now)) send(i, stats[i].ageFlushes);
+            if(aggregators[i].length != 0) pending = true;
+        }
+    }
+} // namespace RCP
+
+#endif
@@ -0,0 +1,425 @@
+#include "RCP_Target/bytecode.h"
+
+#include <string.h>
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/redlines.h"
+
+#if RCPT_PROCEDURES
+
+namespace Test {
+    static BytecodeProcedure programs[BYTECODE_PROGRAMS];
+    static uint8_t uploadSlots[BYTECODE_PROGRAMS];
+    // Whether a begin has been received for the program since its last commit
+    static bool uploading[BYTECODE_PROGRAMS];
+
+#if RCPT_PROMPTS
+    // Only one prompt can be shown at a time, so its owner and answer are shared by all programs
+    static const void* promptOwner = nullptr;
+    static bool promptAnswered;
+    static bool promptGo;
+
+    static void acceptPrompt(const RCP::PromptData& data) {
+        promptAnswered = true;
+        promptGo = data.boolData;
+    }
+#endif
+
+    static uint16_t readU16(const uint8_t* src) { return (src[0] << 8) | src[1]; }
+
+    static uint32_t readU32(const uint8_t* src) {
+        return (static_cast<uint32_t>(src[0]) << 24) | (static_cast<uint32_t>(src[1]) << 16) | (src[2] << 8) | src[3];
+    }
+
+    static bool validateRange(const uint8_t* code, uint16_t pc, uint16_t end, bool allowBlock) {
+        while(pc < end) {
+            uint16_t size = 0;
+
+            switch(code[pc]) {
+            case BC_END:
+                size = 1;
+                break;
+
+            // Instructions for device classes that are compiled out are rejected
+#if RCPT_SIMPLE_ACTUATORS
+            case BC_SIMPLE_ACTUATOR:
+#endif
+#if RCPT_DISCRETE_ACTUATORS
+            case BC_DISCRETE_ACTUATOR:
+#endif
+            case BC_WAIT_BOOL_SENSOR:
+                size = 3;
+                break;
+
+            case BC_WAIT:
+                size = 5;
+                break;
+
+#if RCPT_ANGLED_ACTUATORS
+            case BC_ANGLED_ACTUATOR:
+#endif
+#if RCPT_MOTORS
+            case BC_MOTOR:
+#endif
+#if RCPT_ANGLED_ACTUATORS || RCPT_MOTORS
+                size = 6;
+                break;
+#endif
+
+#if RCPT_STEPPERS
+            case BC_STEPPER:
+                size = 7;
+                break;
+#endif
+
+            case BC_WAIT_SENSOR:
+                size = 9;
+                if(pc + 4 < end && code[pc + 4] > BC_GREATER_EQUAL) return false;
+                break;
+
+#if RCPT_PROMPTS
+            case BC_PROMPT_GONOGO:
+                if(pc + 1 >= end || code[pc + 1] > 62) return false;
+                size = 2 + code[pc + 1];
+                break;
+#endif
+
+            case BC_PARALLEL:
+            case BC_RACE: {
+                if(!allowBlock || pc + 1 >= end) return false;
+                uint8_t count = code[pc + 1];
+                if(count == 0 || count >= BYTECODE_THREADS) return false;
+
+                uint16_t pos = pc + 2;
+                for(uint8_t i = 0; i < count; i++) {
+                    if(pos + 2 > end) return false;
+                    uint16_t branchEnd = pos + 2 + readU16(code + pos);
+                    if(branchEnd > end || !validateRange(code, pos + 2, branchEnd, false)) return false;
+                    pos = branchEnd;
+                }
+
+                size = pos - pc;
+                break;
+            }
+
+            default:
+                return false;
+            }
+
+            if(pc + size > end) return false;
+            pc += size;
+        }
+
+        return true;
+    }
+
+    BytecodeProcedure::BytecodeProcedure() :
+        code{}, length(0), received(0), loaded(false), aborted(false), threads{}, branches(0), race(false),
+        inBlock(false), blockEnd(0) {}
+
+    bool BytecodeProcedure::validate(const uint8_t* program, uint16_t length) {
+        return length <= BYTECODE_PROGRAM_SIZE && validateRange(program, 0, length, true);
+    }
+
+    bool BytecodeProcedure::load(const uint8_t* program, uint16_t length) {
+        loaded = false;
+        if(!validate(program, length)) return false;
+        memcpy(code, program, length);
+        this->length = length;
+        loaded = true;
+        return true;
+    }
+
+    bool BytecodeProcedure::isLoaded() const { return loaded; }
+
+    // Runs one instruction. Returns true if the thread can move on to the next instruction in this tick.
+    bool BytecodeProcedure::step(Thread& thread) {
+        if(thread.done) return false;
+        if(thread.pc >= thread.end) {
+            thread.done = true;
+            return false;
+        }
+
+        const uint8_t* ins = code + thread.pc;
+        switch(ins[0]) {
+#if RCPT_SIMPLE_ACTUATORS
+        case BC_SIMPLE_ACTUATOR:
+            RCP::writeSimpleActuator(ins[1], static_cast<RCP_SimpleActuatorState>(ins[2]));
+            thread.pc += 3;
+            return true;
+#endif
+
+#if RCPT_DISCRETE_ACTUATORS
+        case BC_DISCRETE_ACTUATOR:
+            RCP::writeDiscreteActuator(ins[1], ins[2]);
+            thread.pc += 3;
+            return true;
+#endif
+
+#if RCPT_STEPPERS
+        case BC_STEPPER: {
+            float val;
+            memcpy(&val, ins + 3, 4);
+            RCP::writeStepper(ins[1], static_cast<RCP_StepperControlMode>(ins[2]), val);
+            thread.pc += 7;
+            return true;
+        }
+#endif
+
+#if RCPT_MOTORS
+        case BC_MOTOR: {
+            float val;
+            memcpy(&val, ins + 2, 4);
+            RCP::writeMotor(ins[1], val);
+            thread.pc += 6;
+            return true;
+        }
+#endif
+
+#if RCPT_ANGLED_ACTUATORS
+        case BC_ANGLED_ACTUATOR: {
+            float val;
+            memcpy(&val, ins + 2, 4);
+            RCP::writeAngledActuator(ins[1], val);
+            thread.pc += 6;
+            return true;
+        }
+#endif
+
+        case BC_WAIT: {
+            uint32_t waitTime = readU32(ins + 1);
+            if(!thread.waiting) {
+                thread.waiting = true;
+                thread.waitStart = RCP::millis();
+                RCP::scheduleWakeup(thread.waitStart + waitTime + 1);
+                return false;
+            }
+
+            if(RCP::millis() - thread.waitStart <= waitTime) return false;
+            thread.waiting = false;
+            thread.pc += 5;
+            return true;
+        }
+
+        case BC_WAIT_SENSOR: {
+            float threshold;
+            memcpy(&threshold, ins + 5, 4);
+            float val = RCP::sampleSensor(static_cast<RCP_DeviceClass>(ins[1]), ins[2]).vals[ins[3] & 0x03];
+
+            bool met = false;
+            switch(ins[4]) {
+            case BC_LESS:
+                met = val < threshold;
+                break;
+            case BC_LESS_EQUAL:
+                met = val <= threshold;
+                break;
+            case BC_GREATER:
+                met = val > threshold;
+                break;
+            case BC_GREATER_EQUAL:
+                met = val >= threshold;
+                break;
+            default:
+                break;
+            }
+
+            if(!met) return false;
+            thread.pc += 9;
+            return true;
+        }
+
+        case BC_WAIT_BOOL_SENSOR:
+            if(RCP::sampleBoolSensor(ins[1]) != (ins[2] != 0)) return false;
+            thread.pc += 3;
+            return true;
+
+#if RCPT_PROMPTS
+        case BC_PROMPT_GONOGO: {
+            if(!thread.waiting) {
+                char text[63];
+                memcpy(text, ins + 2, ins[1]);
+                text[ins[1]] = '\0';
+                promptOwner = &thread;
+                promptAnswered = false;
+                thread.waiting = true;
+                RCP::setPrompt(text, RCP_PromptDataType_GONOGO, &acceptPrompt);
+                return false;
+            }
+
+            if(promptOwner != &thread || !promptAnswered) return false;
+            promptOwner = nullptr;
+            thread.waiting = false;
+
+            if(!promptGo) {
+                aborted = true;
+                thread.done = true;
+                return false;
+            }
+
+            thread.pc += 2 + ins[1];
+            return true;
+        }
+#endif
+
+        case BC_PARALLEL:
+        case BC_RACE: {
+            uint16_t pos = thread.pc + 2;
+            branches = ins[1];
+            for(uint8_t i = 1; i <= branches; i++) {
+                uint16_t start = pos + 2;
+                pos = start + readU16(code + pos);
+                threads[i] = {start, pos, 0, false, false};
+            }
+
+            race = ins[0] == BC_RACE;
+            inBlock = true;
+            blockEnd = pos;
+            return false;
+        }
+
+        case BC_END:
+        default:
+            thread.done = true;
+            return false;
+        }
+    }
+
+    void BytecodeProcedure::run(Thread& thread) {
+        for(uint8_t i = 0; i < BYTECODE_STEPS_PER_TICK && !aborted; i++) {
+            if(!step(thread)) return;
+        }
+    }
+
+    bool BytecodeProcedure::blockFinished() const {
+        for(uint8_t i = 1; i <= branches; i++) {
+            if(threads[i].done == race) return race;
+        }
+        return !race;
+    }
+
+    void BytecodeProcedure::endBlock() {
+#if RCPT_PROMPTS
+        // Branches cut short by a race may have left a prompt up
+        for(uint8_t i = 1; i <= branches; i++) {
+            if(promptOwner != &threads[i]) continue;
+            promptOwner = nullptr;
+            RCP::resetPrompt();
+        }
+#endif
+
+        inBlock = false;
+        branches = 0;
+        threads[0].pc = blockEnd;
+    }
+
+    void BytecodeProcedure::initialize() {
+        aborted = false;
+        inBlock = false;
+        branches = 0;
+        threads[0] = {0, length, 0, false, false};
+        if(!loaded) return;
+        run(threads[0]);
+    }
+
+    void BytecodeProcedure::execute() {
+        if(!loaded || aborted) return;
+
+        if(inBlock) {
+            for(uint8_t i = 1; i <= branches && !aborted; i++) run(threads[i]);
+            if(aborted || !blockFinished()) return;
+            endBlock();
+        }
+
+        run(threads[0]);
+    }
+
+    void BytecodeProcedure::end([[maybe_unused]] bool interrupted) {
+#if RCPT_PROMPTS
+        for(const auto& thread : threads) {
+            if(promptOwner != &thread) continue;
+            promptOwner = nullptr;
+            if(interrupted) RCP::resetPrompt();
+        }
+#endif
+    }
+
+    bool BytecodeProcedure::isFinished() { return !loaded || aborted || threads[0].done; }
+
+    BytecodeProcedure& getBytecodeProgram(uint8_t index) { return programs[index % BYTECODE_PROGRAMS]; }
+
+    static bool isRunning(const Procedure* proc) {
+        for(uint8_t i = 0; i < sizeof(Tests::tests) / sizeof(Procedure*); i++) {
+            if(getTests()[i] == proc && RCP::isTestActive(i)) return true;
+        }
+        return false;
+    }
+
+    BytecodeUploadStatus BytecodeProcedure::upload(const uint8_t* bytes, uint8_t length) {
+        uint8_t index = bytes[2];
+        if(index >= BYTECODE_PROGRAMS) return BYTECODE_BAD_PROGRAM;
+        BytecodeProcedure& prog = programs[index];
+        if(isRunning(&prog)) return BYTECODE_SLOT_BUSY;
+
+        switch(bytes[1]) {
+        case BYTECODE_BEGIN: {
+            if(length < 6) return BYTECODE_BAD_COMMAND;
+            uint16_t progLength = (bytes[4] << 8) | bytes[5];
+            if(bytes[3] >= sizeof(Tests::tests) / sizeof(Procedure*)) return BYTECODE_BAD_SLOT;
+            if(progLength > BYTECODE_PROGRAM_SIZE) return BYTECODE_TOO_LONG;
+            if(isRunning(getTests()[bytes[3]])) return BYTECODE_SLOT_BUSY;
+
+            prog.loaded = false;
+            prog.length = progLength;
+            prog.received = 0;
+            uploadSlots[index] = bytes[3];
+            uploading[index] = true;
+            return BYTECODE_OK;
+        }
+
+        case BYTECODE_DATA: {
+            if(length < 5) return BYTECODE_BAD_COMMAND;
+            uint16_t offset = (bytes[3] << 8) | bytes[4];
+            if(prog.loaded) return BYTECODE_BAD_COMMAND;
+            if(offset + length - 5 > prog.length) return BYTECODE_TOO_LONG;
+            // Resending data that already arrived is fine, skipping ahead of it is not
+            if(offset > prog.received) return BYTECODE_GAP;
+            memcpy(prog.code + offset, bytes + 5, length - 5);
+            if(offset + length - 5 > prog.received) prog.received = offset + length - 5;
+            return BYTECODE_OK;
+        }
+
+        case BYTECODE_COMMIT: {
+            // A commit of nothing would install an empty program, or the last one again, over a test
+            if(!uploading[index]) return BYTECODE_BAD_COMMAND;
+            // Otherwise code left over from an earlier upload would fill in for lost data packets
+            if(prog.received != prog.length) return BYTECODE_INCOMPLETE;
+            if(!BytecodeProcedure::validate(prog.code, prog.length)) return BYTECODE_INVALID;
+            if(isRunning(getTests()[uploadSlots[index]])) return BYTECODE_SLOT_BUSY;
+            prog.loaded = true;
+            uploading[index] = false;
+            getTests().tests[uploadSlots[index]] = &prog;
+            return BYTECODE_OK;
+        }
+
+        default:
+            return BYTECODE_BAD_COMMAND;
+        }
+    }
+
+    bool handleBytecodeUpload(const void* data, uint8_t length) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        if(length < 3 || bytes[0] != BYTECODE_UPLOAD_MAGIC) return false;
+
+        uint8_t pkt[5];
+        pkt[0] = RCP::channel | 3;
+        pkt[1] = RCP_DEVCLASS_CUSTOM;
+        pkt[2] = BYTECODE_UPLOAD_MAGIC;
+        pkt[3] = bytes[1];
+        pkt[4] = BytecodeProcedure::upload(bytes, length);
+        RCP::sendPacket(pkt, 5);
+        return true;
+    }
+} // namespace Test
+
+#endif
@@ -0,0 +1,121 @@
+// Only compiled into the library when building as C++20. See coprocedures.h
+
+#include "RCP_Target/coprocedures.h"
+
+#include "RCP_Target/RCP_Target.h"
+
+#ifdef RCPT_COROUTINES
+
+namespace Test {
+    namespace CoroutinePool {
+        alignas(alignof(max_align_t)) static uint8_t frames[COROUTINE_FRAME_COUNT][COROUTINE_FRAME_SIZE];
+        static bool used[COROUTINE_FRAME_COUNT];
+        static uint32_t failed = 0;
+
+        void* allocate(size_t size) noexcept {
+            if(size <= COROUTINE_FRAME_SIZE) {
+                for(size_t i = 0; i < COROUTINE_FRAME_COUNT; i++) {
+                    if(used[i]) continue;
+                    used[i] = true;
+                    return frames[i];
+                }
+            }
+
+            failed++;
+            return nullptr;
+        }
+
+        void deallocate(void* frame) noexcept {
+            for(size_t i = 0; i < COROUTINE_FRAME_COUNT; i++) {
+                if(frame != frames[i]) continue;
+                used[i] = false;
+                return;
+            }
+        }
+
+        size_t available() {
+            size_t count = 0;
+            for(size_t i = 0; i < COROUTINE_FRAME_COUNT; i++)
+                if(!used[i]) count++;
+            return count;
+        }
+
+        uint32_t failures() { return failed; }
+    } // namespace CoroutinePool
+
+    Task::Task() : handle(nullptr), allocationFailed(false) {}
+
+    Task::Task(std::coroutine_handle<promise_type> handle) : handle(handle), allocationFailed(false) {}
+
+    Task::Task(Task&& other) noexcept : handle(other.handle), allocationFailed(other.allocationFailed) {
+        other.handle = nullptr;
+    }
+
+    Task& Task::operator=(Task&& other) noexcept {
+        if(this == &other) return *this;
+        if(handle) handle.destroy();
+        handle = other.handle;
+        allocationFailed = other.allocationFailed;
+        other.handle = nullptr;
+        return *this;
+    }
+
+    Task::~Task() {
+        if(handle) handle.destroy();
+    }
+
+    bool Task::valid() const { return static_cast<bool>(handle); }
+
+    // Runs the coroutine body up to its first co_await, the same way OneShot runs in initialize
+    void Task::initialize() {
+        // Otherwise it would look like a step that finished right away. Not again if this is the ESTOP procedure.
+        if(allocationFailed) {
+            if(RCP::getTestState() != RCP_TEST_ESTOP) RCP::ESTOP();
+            return;
+        }
+
+        if(handle && !handle.done()) handle.resume();
+    }
+
+    void Task::execute() {
+        if(!handle || handle.done()) return;
+
+        Procedure*& awaiting = handle.promise().awaiting;
+        if(awaiting) {
+            awaiting->execute();
+            if(!awaiting->isFinished()) return;
+            awaiting->end(false);
+            awaiting = nullptr;
+        }
+
+        handle.resume();
+    }
+
+    void Task::end(bool interrupted) {
+        if(!handle) return;
+
+        Procedure* awaiting = handle.promise().awaiting;
+        if(interrupted && awaiting && !handle.done()) awaiting->end(true);
+
+        // Return the frame to the pool as soon as possible
+        handle.destroy();
+        handle = nullptr;
+    }
+
+    bool Task::isFinished() { return !handle || handle.done(); }
+
+    CoroutineProcedure::CoroutineProcedure(Body body) : body(body) {}
+
+    void CoroutineProcedure::initialize() {
+        task = body();
+        task.initialize();
+    }
+
+    void CoroutineProcedure::execute() { task.execute(); }
+
+    void CoroutineProcedure::end(bool interrupted) { task.end(interrupted); }
+
+    bool CoroutineProcedure::isFinished() { return task.isFinished(); }
+} // namespace Test
+
+#endif
@@ -0,0 +1,90 @@
+#include "RCP_Target/diagnostics.h"
+
+#include <string.h>
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/executor.h"
+#include "RCP_Target/redlines.h"
+#include "RCP_Target/stats.h"
+#include "RCP_Target/trace.h"
+
+namespace RCP {
+    void sendDiagnostics(RCP_DiagnosticsType type, const uint8_t* payload, uint8_t length) {
+        if(length > 61) return;
+        uint8_t pkt[65];
+        pkt[0] = channel | (length + 2);
+        pkt[1] = RCP_DEVCLASS_CUSTOM;
+        pkt[2] = DIAGNOSTICS_MAGIC;
+        pkt[3] = type;
+        if(length != 0) memcpy(pkt + 4, payload, length);
+        sendPacket(pkt, length + 4);
+    }
+
+    void sendDiagnostics(RCP_DiagnosticsType type, const uint32_t* values, uint8_t count) {
+        uint8_t payload[60];
+        if(count > 15) return;
+        for(uint8_t i = 0; i < count; i++) {
+            payload[i * 4] = values[i] >> 24;
+            payload[i * 4 + 1] = values[i] >> 16;
+            payload[i * 4 + 2] = values[i] >> 8;
+            payload[i * 4 + 3] = values[i];
+        }
+
+        sendDiagnostics(type, payload, count * 4);
+    }
+
+    bool handleDiagnostics(const void* data, uint8_t length) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        if(length < 2 || bytes[0] != DIAGNOSTICS_MAGIC) return false;
+
+        switch(bytes[1]) {
+#if RCPT_PROCEDURES
+        case RCP_DIAG_EXECUTOR:
+        case RCP_DIAG_EXECUTOR_JITTER:
+        case RCP_DIAG_EXECUTOR_MISSED:
+            sendExecutorStats();
+            break;
+#endif
+
+        case RCP_DIAG_REDLINE_TRIP:
+            sendRedlineLog();
+            break;
+
+#if RCPT_STATS
+        case RCP_DIAG_STATS:
+            if(length >= 4) setRuntimeStatsInterval((bytes[2] << 8) | bytes[3]);
+            sendRuntimeStats();
+            break;
+#endif
+
+#if RCPT_TRACE
+        case RCP_DIAG_TRACE:
+            sendTrace();
+            break;
+#endif
+
+        case RCP_DIAG_TEST_SLOTS:
+            sendTestSlots();
+            break;
+
+        case RCP_DIAG_RESET:
+#if RCPT_PROCEDURES
+            resetExecutorStats();
+#endif
+            clearRedlineLog();
+#if RCPT_STATS
+            resetRuntimeStats();
+#endif
+#if RCPT_TRACE
+            clearTrace();
+#endif
+            sendDiagnostics(RCP_DIAG_RESET, static_cast<const uint8_t*>(nullptr), 0);
+            break;
+
+        default:
+            break;
+        }
+
+        return true;
+    }
+} // namespace RCP
@@ -0,0 +1,133 @@
+#include "RCP_Target/executor.h"
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/diagnostics.h"
+
+#if RCPT_PROCEDURES
+
+namespace RCP {
+    static uint32_t period = 0;
+    static RCP_ExecutorPolicy policy;
+    static uint8_t maxCatchUp;
+
+    static bool started;
+    static uint32_t nextTick;
+    static uint32_t lastRun;
+
+    // Written only by fixedRateTimerTick(). The main loop reads them with readTimerTicks() instead of disabling
+    // interrupts.
+    static volatile uint32_t timerTicks = 0;
+    static volatile uint32_t lastTimerTick;
+    static uint32_t consumedTicks = 0;
+    static bool timerMode = false;
+
+    // Reads the tick count and, if wanted, the time of the last tick as a consistent pair. If a tick comes in between
+    // (or tears a 32 bit read on a smaller CPU), the count differs on the second read and it tries again.
+    static uint32_t readTimerTicks(uint32_t* lastTick = nullptr) {
+        uint32_t ticks;
+        do {
+            ticks = timerTicks;
+            if(lastTick != nullptr) *lastTick = lastTimerTick;
+        } while(ticks != timerTicks);
+        return ticks;
+    }
+
+    static ExecutorStats stats;
+
+    void setFixedRate(uint32_t periodMicros, RCP_ExecutorPolicy newPolicy, uint8_t newMaxCatchUp) {
+        period = periodMicros;
+        policy = newPolicy;
+        maxCatchUp = newMaxCatchUp;
+        started = false;
+        timerMode = false;
+        consumedTicks = readTimerTicks();
+    }
+
+    uint32_t getFixedRatePeriod() { return period; }
+
+    void fixedRateTimerTick() {
+        lastTimerTick = systimeMicros();
+        timerTicks = timerTicks + 1;
+    }
+
+    static void recordJitter(uint32_t late) {
+        if(late > stats.maxJitter) stats.maxJitter = late;
+
+        uint8_t bucket = 0;
+        while(late != 0 && bucket < EXECUTOR_JITTER_BUCKETS - 1) {
+            late >>= 1;
+            bucket++;
+        }
+
+        stats.jitter[bucket]++;
+    }
+
+    uint16_t runFixedRate() {
+        // The ESTOP procedure is not held to the schedule
+        if(period == 0 || getTestState() == RCP_TEST_ESTOP) {
+            runTest();
+            return 1;
+        }
+
+        uint32_t now = systimeMicros();
+        uint32_t due = 0;
+        uint32_t late = 0;
+
+        // The first run, in either mode, has no run before it to measure its period and jitter from
+        bool first = !started;
+        uint32_t lastTick;
+        uint32_t ticks = readTimerTicks(&lastTick);
+        if(timerMode || ticks != consumedTicks) {
+            timerMode = true;
+            due = ticks - consumedTicks;
+            if(due == 0) return 0;
+            consumedTicks = ticks;
+            late = now - lastTick;
+        }
+
+        else {
+            if(first) nextTick = now;
+            if(static_cast<int32_t>(now - nextTick) < 0) return 0;
+            due = (now - nextTick) / period + 1;
+            late = (now - nextTick) - (due - 1) * period;
+            nextTick += due * period;
+        }
+
+        uint32_t missed = due - 1;
+        uint32_t runs = 1;
+        if(missed != 0) {
+            stats.missed += missed;
+            stats.missedRuns[missed < EXECUTOR_MISSED_BUCKETS ? missed - 1 : EXECUTOR_MISSED_BUCKETS - 1]++;
+            if(policy == RCP_EXECUTOR_CATCH_UP) runs += missed < maxCatchUp ? missed : maxCatchUp;
+            stats.skipped += due - runs;
+        }
+
+        if(!first) {
+            recordJitter(late);
+            stats.lastPeriod = now - lastRun;
+        }
+        started = true;
+        lastRun = now;
+
+        for(uint32_t i = 0; i < runs; i++) {
+            runTest();
+            stats.ticks++;
+        }
+
+        return runs;
+    }
+
+    const ExecutorStats& getExecutorStats() { return stats; }
+
+    void resetExecutorStats() { stats = {}; }
+
+    void sendExecutorStats() {
+        const uint32_t summary[6] = {stats.ticks,     stats.missed,     stats.skipped,
+                                     stats.maxJitter, stats.lastPeriod, period};
+        sendDiagnostics(RCP_DIAG_EXECUTOR, summary, 6);
+        sendDiagnostics(RCP_DIAG_EXECUTOR_JITTER, stats.jitter, EXECUTOR_JITTER_BUCKETS);
+        sendDiagnostics(RCP_DIAG_EXECUTOR_MISSED, stats.missedRuns, EXECUTOR_MISSED_BUCKETS);
+    }
+} // namespace RCP
+
+#endif
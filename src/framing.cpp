@@ -0,0 +1,27 @@
+#include "RCP_Target/framing.h"
+
+namespace RCP {
+    size_t cobsEncode(const uint8_t* src, size_t length, uint8_t* dst) {
+        // Each code byte stands in for the next zero, or ends a block of 254 bytes without one. RCP packets are short
+        // and usually have a zero every few bytes, where this plain loop beats memchr() and memcpy().
+        uint8_t* code = dst;
+        uint8_t* out = dst + 1;
+        *code = 1;
+        for(size_t i = 0; i < length; i++) {
+            if(src[i] == 0) {
+                code = out++;
+                *code = 1;
+                continue;
+            }
+
+            *out++ = src[i];
+            if(++*code == 0xFF && i + 1 < length) {
+                code = out++;
+                *code = 1;
+            }
+        }
+
+        *out++ = 0;
+        return out - dst;
+    }
+} // namespace RCP
@@ -4,6 +4,8 @@
 
 #include "RCP_Target/RCP_Target.h"
 
+#if RCPT_PROCEDURES
+
 namespace Test {
 
     void Procedure::initialize() {}
@@ -39,7 +41,10 @@ namespace Test {
 
     WaitProcedure::WaitProcedure(const unsigned long& waitTime) : waitTime(waitTime) {}
 
-    void WaitProcedure::initialize() { startTime = RCP::millis(); }
+    void WaitProcedure::initialize() {
+        startTime = RCP::millis();
+        RCP::scheduleWakeup(startTime + waitTime + 1);
+    }
 
     bool WaitProcedure::isFinished() { return RCP::millis() - startTime > waitTime; }
 
@@ -88,14 +93,18 @@ namespace Test {
     }
 
     void ParallelProcedure::initialize() {
+        cursor = 0;
         for(unsigned int i = 0; i < numProcedures; i++) {
             procedures[i]->initialize();
             running[i] = true;
         }
     }
 
-    void ParallelProcedure::execute() {
-        for(unsigned int i = 0; i < numProcedures; i++) {
+    // Executes each running child once, starting at the cursor. If the runTest() budget runs out, the rest of the
+    // children run first on the next call.
+    static void executeChildren(Procedure** procedures, bool* running, unsigned int count, unsigned int& cursor) {
+        for(unsigned int n = 0; n < count; n++) {
+            unsigned int i = (cursor + n) % count;
             if(!running[i]) continue;
             procedures[i]->execute();
 
@@ -103,9 +112,16 @@ namespace Test {
                 procedures[i]->end(false);
                 running[i] = false;
             }
+
+            if(n + 1 < count && RCP::budgetExhausted()) {
+                cursor = (i + 1) % count;
+                return;
+            }
         }
     }
 
+    void ParallelProcedure::execute() { executeChildren(procedures, running, numProcedures, cursor); }
+
     void ParallelProcedure::end(bool interrupted) {
         if(!interrupted) return;
         for(unsigned int i = 0; i < numProcedures; i++) {
@@ -147,38 +163,36 @@ namespace Test {
     }
 
     void ParallelDeadlineProcedure::initialize() {
+        cursor = 0;
         deadline->initialize();
+        deadlineRunning = true;
         for(unsigned int i = 0; i < numProcedures; i++) {
             procedures[i]->initialize();
+            running[i] = true;
         }
     }
 
     void ParallelDeadlineProcedure::execute() {
+        // The deadline always runs, since it decides when this procedure ends
         if(deadlineRunning) {
             deadline->execute();
             if(deadline->isFinished()) {
                 deadline->end(false);
-                deadlineRunning = true;
+                deadlineRunning = false;
             }
         }
 
-        for(unsigned int i = 0; i < numProcedures; i++) {
-            if(!running[i]) continue;
-            procedures[i]->execute();
-
-            if(procedures[i]->isFinished()) {
-                procedures[i]->end(false);
-                running[i] = false;
-            }
-        }
+        executeChildren(procedures, running, numProcedures, cursor);
     }
 
     void ParallelDeadlineProcedure::end([[maybe_unused]] bool interrupted) {
         if(deadlineRunning) deadline->end(true);
+        deadlineRunning = false;
 
         for(unsigned int i = 0; i < numProcedures; i++) {
             if(!running[i]) continue;
             procedures[i]->end(true);
+            running[i] = false;
         }
     }
 
@@ -204,3 +218,5 @@ namespace Test {
     void SelectorProcedure::end(bool interrupted) { (choice ? yes : no)->end(interrupted); }
 
 } // namespace Test
+
+#endif
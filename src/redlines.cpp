@@ -0,0 +1,140 @@
+#include "RCP_Target/redlines.h"
+
+#include <string.h>
+
+#include "RCP_Target/channels.h"
+#include "RCP_Target/diagnostics.h"
+
+namespace RCP {
+    static Redline* redlines = nullptr;
+    static uint16_t numRedlines = 0;
+
+    static LRI::RingBuf<RedlineTrip, REDLINE_LOG_SIZE> tripLog;
+    static uint32_t tripCount = 0;
+
+    void setRedlines(Redline* table, uint16_t count) {
+        redlines = table;
+        numRedlines = table == nullptr ? 0 : count;
+        resetRedlines();
+    }
+
+    void resetRedlines() {
+        for(uint16_t i = 0; i < numRedlines; i++) {
+            redlines[i].count = 0;
+            redlines[i].tripped = false;
+        }
+    }
+
+    // Reported as the rule index, a big endian timestamp, and the value copied as in other RCP packets
+    static void encodeTrip(const RedlineTrip& trip, uint8_t* dst) {
+        dst[0] = trip.rule >> 8;
+        dst[1] = trip.rule;
+        dst[2] = trip.time >> 24;
+        dst[3] = trip.time >> 16;
+        dst[4] = trip.time >> 8;
+        dst[5] = trip.time;
+        memcpy(dst + 6, &trip.value, 4);
+    }
+
+    static void trip(uint16_t index, float value) {
+        const Redline& rule = redlines[index];
+        RedlineTrip entry = {millis(), index, value};
+
+        switch(rule.action) {
+        case RCP_REDLINE_ESTOP:
+            ESTOP();
+            break;
+
+        case RCP_REDLINE_START_PROCEDURE:
+            startProcedure(rule.target);
+            break;
+
+#if RCPT_SIMPLE_ACTUATORS
+        case RCP_REDLINE_SIMPLE_ACTUATOR:
+            writeSimpleActuator(rule.target, rule.state);
+            break;
+#endif
+
+        default:
+            break;
+        }
+
+        // Logged after the action so reporting never delays it
+        tripLog.pushOverwrite(entry);
+        tripCount++;
+
+        uint8_t pkt[10];
+        encodeTrip(entry, pkt);
+        sendDiagnostics(RCP_DIAG_REDLINE_TRIP, pkt, 10);
+    }
+
+    void evaluateRedlines(RCP_DeviceClass devclass, uint8_t id, const float* values, uint8_t numValues) {
+        for(uint16_t i = 0; i < numRedlines; i++) {
+            Redline& rule = redlines[i];
+            if(rule.id != id || rule.devclass != devclass || rule.channel >= numValues) continue;
+
+            float value = values[rule.channel];
+            bool above = rule.comparator == RCP_REDLINE_ABOVE;
+
+            if(rule.tripped) {
+                // Re-arm once back past the threshold by the hysteresis
+                if(above ? value < rule.threshold - rule.hysteresis : value > rule.threshold + rule.hysteresis) {
+                    rule.tripped = false;
+                    rule.count = 0;
+                }
+                continue;
+            }
+
+            if(above ? value <= rule.threshold : value >= rule.threshold) {
+                rule.count = 0;
+                continue;
+            }
+
+            if(++rule.count < rule.persistence) continue;
+            rule.tripped = true;
+            trip(i, value);
+        }
+    }
+
+    Floats4 sampleSensor(RCP_DeviceClass devclass, uint8_t id) {
+        Floats4 vals = RCPT_CALLBACK(readSensor)(devclass, id);
+        evaluateRedlines(devclass, id, vals.vals, 4);
+        return vals;
+    }
+
+    bool sampleBoolSensor(uint8_t id) {
+        bool val = RCPT_CALLBACK(readBoolSensor)(id);
+        float asFloat = val ? 1 : 0;
+        evaluateRedlines(RCP_DEVCLASS_BOOL_SENSOR, id, &asFloat, 1);
+        return val;
+    }
+
+    uint32_t getRedlineTripCount() { return tripCount; }
+
+    bool getRedlineTrip(uint8_t index, RedlineTrip& trip) {
+        if(index >= tripLog.size()) return false;
+        trip = tripLog[tripLog.size() - 1 - index];
+        return true;
+    }
+
+    void clearRedlineLog() {
+        tripLog.clear();
+        tripCount = 0;
+    }
+
+    // Oldest first, six trips per packet
+    void sendRedlineLog() {
+        uint8_t payload[60];
+        uint8_t len = 0;
+        for(uint8_t i = 0; i < tripLog.size(); i++) {
+            encodeTrip(tripLog[i], payload + len);
+            len += 10;
+            if(len == 60) {
+                sendDiagnostics(RCP_DIAG_REDLINE_TRIP, payload, len);
+                len = 0;
+            }
+        }
+
+        if(len != 0 || tripLog.isEmpty()) sendDiagnostics(RCP_DIAG_REDLINE_TRIP, payload, len);
+    }
+} // namespace RCP
@@ -0,0 +1,133 @@
+#include "RCP_Target/router.h"
+
+#if RCPT_ROUTER
+
+#include <string.h>
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/framing.h"
+#include "RCP_Target/transports.h"
+
+namespace RCP {
+    static uint8_t downstream = 0;
+    static RouterStats stats;
+
+    // The link 0 packet going down: how much of it is still to come, and on a framed link what has come so far
+    static uint8_t cutRemaining = 0;
+    static uint8_t cutPacket[65];
+    static uint8_t cutLength = 0;
+
+    // What waits for that packet to be through
+    static uint8_t held[65];
+    static uint8_t heldLength = 0;
+    static bool estopHeld = false;
+
+    static uint8_t channelIndex(uint8_t head) { return (head & RCP_CHANNEL_MASK) >> 6; }
+
+    // Writes a whole packet down, framed if the link is
+    static void sendDown(const uint8_t* packet, uint8_t length) {
+        if(getFraming(downstream) == RCP_FRAMING_COBS) {
+            uint8_t frame[MAX_FRAME];
+            writeTransport(downstream, frame, cobsEncode(packet, length, frame));
+        }
+        else writeTransport(downstream, packet, length);
+    }
+
+    static void sendHeld() {
+        if(estopHeld) {
+            const uint8_t estop = 0;
+            sendDown(&estop, 1);
+            estopHeld = false;
+        }
+
+        if(heldLength != 0) {
+            sendDown(held, heldLength);
+            heldLength = 0;
+        }
+    }
+
+    void setDownstream(uint8_t link) {
+        downstream = link < getTransportCount() ? link : 0;
+        cutRemaining = 0;
+        cutLength = 0;
+        heldLength = 0;
+        estopHeld = false;
+    }
+
+    uint8_t getDownstream() { return downstream; }
+
+    const RouterStats& getRouterStats() { return stats; }
+
+    void cutThrough(const uint8_t* data, uint8_t length, uint8_t remaining) {
+        if(downstream == 0) return;
+        bool first = cutRemaining == 0;
+        cutRemaining = remaining;
+        stats.downBytes[channelIndex(first ? data[0] : cutPacket[0])] += length;
+
+        if(getFraming(downstream) == RCP_FRAMING_COBS) {
+            if(first) cutLength = 0;
+            memcpy(cutPacket + cutLength, data, length);
+            cutLength += length;
+            if(remaining == 0) sendDown(cutPacket, cutLength);
+        }
+        else {
+            // Only the header is needed for the statistics
+            if(first) cutPacket[0] = data[0];
+            writeTransport(downstream, data, length);
+        }
+
+        if(remaining == 0) sendHeld();
+    }
+
+    bool routePacket(const uint8_t* packet) {
+        if(downstream == 0) return false;
+        uint8_t length = (packet[0] & ~RCP_CHANNEL_MASK) + 2;
+        stats.downBytes[channelIndex(packet[0])] += length;
+        if(cutRemaining == 0) {
+            sendDown(packet, length);
+            return true;
+        }
+
+        if(heldLength != 0) {
+            stats.dropped++;
+            return true;
+        }
+
+        memcpy(held, packet, length);
+        heldLength = length;
+        return true;
+    }
+
+    void abortCutThrough() {
+        cutRemaining = 0;
+        cutLength = 0;
+        sendHeld();
+    }
+
+    void routeEstop(uint8_t head) {
+        if(downstream == 0) return;
+        stats.downBytes[channelIndex(head)]++;
+        if(cutRemaining != 0) estopHeld = true;
+        else sendDown(&head, 1);
+    }
+
+    bool isDownstream(uint8_t link) { return link != 0 && link == downstream; }
+
+    void routeUpstream(const uint8_t* packet) {
+        uint8_t pktlen = packet[0] & ~RCP_CHANNEL_MASK;
+        // Targets do not send ESTOPs
+        if(pktlen == 0) return;
+        stats.upBytes[channelIndex(packet[0])] += pktlen + 2;
+        sendPacket(packet, pktlen + 2);
+    }
+
+    void resetRouter() {
+        stats = {};
+        cutRemaining = 0;
+        cutLength = 0;
+        heldLength = 0;
+        estopHeld = false;
+    }
+} // namespace RCP
+
+#endif
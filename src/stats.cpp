@@ -0,0 +1,44 @@
+#include "RCP_Target/stats.h"
+
+#if RCPT_STATS
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/diagnostics.h"
+
+namespace RCP {
+    RuntimeStats runtimeStats = {};
+
+    static uint32_t streamInterval = 0;
+    static uint32_t lastStreamed;
+
+    const RuntimeStats& getRuntimeStats() { return runtimeStats; }
+
+    void resetRuntimeStats() { runtimeStats = {}; }
+
+    void sendRuntimeStats() {
+        const uint32_t values[] = {runtimeStats.rxBytes,     runtimeStats.rxPackets,      runtimeStats.rxDropped,
+                                   runtimeStats.unknownClass, runtimeStats.foreignChannel, runtimeStats.txBytes,
+                                   runtimeStats.txPackets,    runtimeStats.yield.max,      runtimeStats.yield.mean(),
+                                   runtimeStats.runTest.max,  runtimeStats.runTest.mean(), runtimeStats.rxHighWater,
+                                   getRxBudget(),             getLoopMicros()};
+
+        sendDiagnostics(RCP_DIAG_STATS, values, sizeof(values) / sizeof(uint32_t));
+    }
+
+    void setRuntimeStatsInterval(uint32_t intervalMs) {
+        streamInterval = intervalMs;
+        lastStreamed = systime();
+    }
+
+    uint32_t getRuntimeStatsInterval() { return streamInterval; }
+
+    void streamRuntimeStats() {
+        if(streamInterval == 0 || systime() - lastStreamed < streamInterval) return;
+        lastStreamed += streamInterval;
+        // Don't send a burst to catch up after a long stall
+        if(systime() - lastStreamed >= streamInterval) lastStreamed = systime();
+        sendRuntimeStats();
+    }
+} // namespace RCP
+
+#endif
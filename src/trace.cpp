@@ -0,0 +1,65 @@
+#include "RCP_Target/trace.h"
+
+#if RCPT_TRACE
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/diagnostics.h"
+
+namespace RCP {
+    TraceEvent traceRing[TRACE_EVENTS];
+    uint32_t traceHead = 0;
+    bool traceRecording = true;
+
+    // Events per dump packet
+    static constexpr uint8_t EVENTS_PER_PACKET = 7;
+
+    [[gnu::weak]] uint32_t traceTimestamp() { return systimeMicros(); }
+
+    [[gnu::weak]] void traceHook([[maybe_unused]] RCP_TraceEventType type, [[maybe_unused]] uint8_t arg,
+                                 [[maybe_unused]] uint16_t data) {}
+
+    uint16_t getTraceCount() { return traceHead < TRACE_EVENTS ? traceHead : TRACE_EVENTS; }
+
+    bool getTraceEvent(uint16_t index, TraceEvent& event) {
+        uint16_t count = getTraceCount();
+        if(index >= count) return false;
+        event = traceRing[(traceHead - count + index) & (TRACE_EVENTS - 1)];
+        return true;
+    }
+
+    void clearTrace() { traceHead = 0; }
+
+    void sendTrace() {
+        // The dump would otherwise record its own packets over the events being sent
+        traceRecording = false;
+
+        uint16_t count = getTraceCount();
+        uint8_t payload[EVENTS_PER_PACKET * 8];
+        uint8_t len = 0;
+        for(uint16_t i = 0; i < count; i++) {
+            TraceEvent event;
+            getTraceEvent(i, event);
+            payload[len] = event.time >> 24;
+            payload[len + 1] = event.time >> 16;
+            payload[len + 2] = event.time >> 8;
+            payload[len + 3] = event.time;
+            payload[len + 4] = event.type;
+            payload[len + 5] = event.arg;
+            payload[len + 6] = event.data >> 8;
+            payload[len + 7] = event.data;
+            len += 8;
+
+            if(len == sizeof(payload)) {
+                sendDiagnostics(RCP_DIAG_TRACE, payload, len);
+                len = 0;
+            }
+        }
+
+        if(len != 0) sendDiagnostics(RCP_DIAG_TRACE, payload, len);
+        // An empty packet ends the dump
+        sendDiagnostics(RCP_DIAG_TRACE, payload, 0);
+        traceRecording = true;
+    }
+} // namespace RCP
+
+#endif
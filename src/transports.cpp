@@ -0,0 +1,265 @@
+#include "RCP_Target/transports.h"
+
+#if RCPT_TRANSPORTS
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/aggregation.h"
+#include "RCP_Target/router.h"
+#include "RCP_Target/stats.h"
+
+namespace RCP {
+    constexpr uint8_t LINKS = RCPT_TRANSPORTS + 1;
+    // How much unused rate limit a link keeps, in ms of its rate
+    constexpr uint32_t BURST_MILLIS = 100;
+
+    // An added link and the packet its parser is assembling
+    struct Link {
+        Transport transport;
+        RCP_Framing framing;
+        uint8_t packet[65];
+        uint8_t received;
+        CobsDecoder<> decoder;
+    };
+
+    struct LinkPolicy {
+        TelemetryPolicy telemetry;
+        // Rate limit credit in bytes * 1000, refilled at bytesPerSecond per ms
+        uint64_t credit;
+        uint32_t refilledAt;
+    };
+
+    // Decimation counts of one sensor, one per link
+    struct Stream {
+        bool used;
+        // Routed telemetry has other channels
+        uint8_t channel;
+        uint8_t devclass;
+        uint8_t id;
+        uint8_t counts[LINKS];
+    };
+
+    static Link links[RCPT_TRANSPORTS];
+    static uint8_t numLinks = 0;
+    static LinkPolicy policies[LINKS];
+    // Whether any link has a policy, so sendPacket() can skip looking at the packet
+    static bool policed = false;
+    static Stream streams[TELEMETRY_STREAMS];
+    // Shared by the sensors that did not get a stream
+    static uint8_t overflowCounts[LINKS];
+    static TransportStats stats[LINKS];
+
+    static uint64_t burstCredit(const TelemetryPolicy& telemetry) {
+        return static_cast<uint64_t>(telemetry.bytesPerSecond) * BURST_MILLIS;
+    }
+
+    static void updatePoliced() {
+        policed = false;
+        for(uint8_t i = 0; i <= numLinks; i++) {
+            const TelemetryPolicy& telemetry = policies[i].telemetry;
+            if(telemetry.decimation > 1 || telemetry.bytesPerSecond != 0) policed = true;
+        }
+    }
+
+    uint8_t addTransport(const Transport& transport, const TelemetryPolicy& policy) {
+        if(numLinks == RCPT_TRANSPORTS) return 0;
+        links[numLinks] = {};
+        links[numLinks].transport = transport;
+        links[numLinks].framing = RCP_FRAMING_RAW;
+        numLinks++;
+        stats[numLinks] = {};
+        setTelemetryPolicy(numLinks, policy);
+        return numLinks;
+    }
+
+    void removeTransports() {
+#if RCPT_ROUTER
+        setDownstream(0);
+#endif
+        for(uint8_t i = 1; i <= numLinks; i++) {
+            policies[i] = {};
+#if RCPT_AGGREGATION_MTU
+            setAggregation(0, 0, i);
+#endif
+        }
+        numLinks = 0;
+        updatePoliced();
+    }
+
+    uint8_t getTransportCount() { return numLinks + 1; }
+
+    void setTelemetryPolicy(uint8_t link, const TelemetryPolicy& policy) {
+        if(link > numLinks) return;
+        policies[link].telemetry = policy;
+        policies[link].credit = burstCredit(policy);
+        policies[link].refilledAt = systime();
+        for(auto& stream : streams) stream.counts[link] = 0;
+        overflowCounts[link] = 0;
+        updatePoliced();
+    }
+
+    const TransportStats& getTransportStats(uint8_t link) { return stats[link < LINKS ? link : 0]; }
+
+    void writeTransport(uint8_t link, const void* data, uint8_t length) {
+        if(link != 0 && link <= numLinks) links[link - 1].transport.write(data, length);
+    }
+
+    void setTransportFraming(uint8_t link, RCP_Framing framing) {
+        if(link == 0 || link > numLinks) return;
+        links[link - 1].framing = framing;
+        links[link - 1].received = 0;
+        links[link - 1].decoder.reset();
+    }
+
+    RCP_Framing getTransportFraming(uint8_t link) {
+        return link == 0 || link > numLinks ? RCP_FRAMING_RAW : links[link - 1].framing;
+    }
+
+    FramingStats getTransportFramingStats(uint8_t link) {
+        return link == 0 || link > numLinks ? FramingStats{} : links[link - 1].decoder.stats;
+    }
+
+    void resetTransports() {
+        for(uint8_t i = 0; i < numLinks; i++) {
+            links[i].received = 0;
+            links[i].decoder.reset();
+            links[i].decoder.stats = {};
+        }
+        for(uint8_t i = 0; i <= numLinks; i++) {
+            stats[i] = {};
+            policies[i].credit = burstCredit(policies[i].telemetry);
+            policies[i].refilledAt = systime();
+        }
+
+        for(auto& stream : streams) stream = {};
+        for(auto& count : overflowCounts) count = 0;
+    }
+
+    void pollTransports() {
+        for(uint8_t i = 0; i < numLinks; i++) {
+            Link& link = links[i];
+            TransportStats& linkStats = stats[i + 1];
+#if RCPT_ROUTER
+            void (*handle)(const uint8_t* packet) = isDownstream(i + 1) ? routeUpstream : handlePacket;
+#else
+            void (*handle)(const uint8_t* packet) = handlePacket;
+#endif
+            uint8_t received[SERIAL_BYTES_PER_LOOP];
+            uint8_t count = 0;
+            while(count < SERIAL_BYTES_PER_LOOP && link.transport.readAvail()) {
+                received[count++] = link.transport.read();
+            }
+            linkStats.rxBytes += count;
+            RCPT_STAT(rxBytes += count);
+
+            if(link.framing == RCP_FRAMING_COBS) {
+                link.decoder.decode(received, count, [&linkStats, handle](const uint8_t* frame, size_t length) {
+                    if(!isPacketFrame(frame, length)) return false;
+                    linkStats.rxPackets++;
+                    handle(frame);
+                    return true;
+                });
+                continue;
+            }
+
+            for(uint8_t n = 0; n < count; n++) {
+                link.packet[link.received++] = received[n];
+                uint8_t pktlen = link.packet[0] & (~RCP_CHANNEL_MASK);
+                if(pktlen != 0 && link.received < pktlen + 2) continue;
+
+                link.received = 0;
+                linkStats.rxPackets++;
+                handle(link.packet);
+            }
+        }
+    }
+
+    // The decimation counts for the sensor a telemetry packet is from
+    static uint8_t* streamCounts(const uint8_t* packet, uint8_t length) {
+        uint8_t channel = packet[0] & RCP_CHANNEL_MASK;
+        uint8_t devclass = packet[1];
+        uint8_t id = length > 6 ? packet[6] : 0;
+        uint8_t index = (devclass * 31u + id + (channel >> 6)) % TELEMETRY_STREAMS;
+        for(uint8_t probe = 0; probe < TELEMETRY_STREAMS; probe++) {
+            Stream& stream = streams[(index + probe) % TELEMETRY_STREAMS];
+            if(!stream.used) {
+                stream.used = true;
+                stream.channel = channel;
+                stream.devclass = devclass;
+                stream.id = id;
+                return stream.counts;
+            }
+
+            if(stream.channel == channel && stream.devclass == devclass && stream.id == id) return stream.counts;
+        }
+
+        return overflowCounts;
+    }
+
+    // Whether a telemetry packet goes out on link
+    static bool admit(uint8_t link, uint8_t& count, uint8_t length) {
+        LinkPolicy& policy = policies[link];
+        if(policy.telemetry.decimation > 1) {
+            uint8_t seen = count;
+            count = seen + 1 >= policy.telemetry.decimation ? 0 : seen + 1;
+            if(seen != 0) {
+                stats[link].decimated++;
+                return false;
+            }
+        }
+
+        if(policy.telemetry.bytesPerSecond == 0) return true;
+
+        uint32_t now = systime();
+        uint64_t max = burstCredit(policy.telemetry);
+        uint32_t elapsed = now - policy.refilledAt;
+        policy.refilledAt = now;
+        policy.credit += static_cast<uint64_t>(elapsed < BURST_MILLIS ? elapsed : BURST_MILLIS) *
+                         policy.telemetry.bytesPerSecond;
+        if(policy.credit > max) policy.credit = max;
+
+        uint64_t cost = length * 1000u;
+        if(policy.credit < cost) {
+            stats[link].rateLimited++;
+            return false;
+        }
+
+        policy.credit -= cost;
+        return true;
+    }
+
+    void writeTransports(const void* data, uint8_t length) {
+        const auto* packet = static_cast<const uint8_t*>(data);
+        bool control = isControlPacket(packet, length);
+        bool telemetry = policed && !control;
+        uint8_t* counts = telemetry ? streamCounts(packet, length) : nullptr;
+        // Encoded when the first framed link needs it
+        uint8_t frame[MAX_FRAME];
+        uint8_t frameLength = 0;
+
+        for(uint8_t i = 0; i <= numLinks; i++) {
+#if RCPT_ROUTER
+            // Only forwarded packets go down the chain
+            if(isDownstream(i)) continue;
+#endif
+            const uint8_t* out = packet;
+            uint8_t outLength = length;
+            if(getFraming(i) == RCP_FRAMING_COBS) {
+                if(frameLength == 0) frameLength = cobsEncode(packet, length, frame);
+                out = frame;
+                outLength = frameLength;
+            }
+
+            if(telemetry && !admit(i, counts[i], outLength)) continue;
+#if RCPT_AGGREGATION_MTU
+            aggregate(i, out, outLength, control);
+#else
+            if(i == 0) write(out, outLength);
+            else links[i - 1].transport.write(out, outLength);
+#endif
+            stats[i].txPackets++;
+            stats[i].txBytes += outLength;
+        }
+    }
+} // namespace RCP
+
+#endif
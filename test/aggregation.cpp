@@ -0,0 +1,196 @@
+#include <vector>
+
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/aggregation.h"
+#include "RCP_Target/transports.h"
+
+#if RCPT_AGGREGATION_MTU && RCPT_TRANSPORTS
+
+using Bytes = std::vector<uint8_t>;
+
+// Each write() call to the radio, which is one transmission
+static std::vector<Bytes> radioFrames;
+
+static void radioWrite(const void* data, uint8_t length) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    radioFrames.emplace_back(bytes, bytes + length);
+}
+
+static uint8_t radioAvailable() { return 0; }
+
+static uint8_t radioRead() { return 0; }
+
+class RCPAggregation : public RCPSimpleActuators {
+protected:
+    uint8_t radio;
+
+    RCPAggregation() {
+        radioFrames.clear();
+        radio = RCP::addTransport({radioWrite, radioAvailable, radioRead});
+    }
+
+    ~RCPAggregation() override {
+        RCP::setAggregation(0, 0);
+        RCP::setFraming(RCP_FRAMING_RAW, radio);
+        RCP::removeTransports();
+    }
+
+    // An 11 byte telemetry packet
+    static void sendTelemetry(uint8_t id) { RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, id, PI); }
+
+    static Bytes telemetry(uint8_t id) {
+        return {0x09, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00, 0x00, 0x00, 0x00, id, HFLOATARR(HPI)};
+    }
+
+    static Bytes concat(std::initializer_list<Bytes> packets) {
+        Bytes frame;
+        for(const auto& packet : packets) frame.insert(frame.end(), packet.begin(), packet.end());
+        return frame;
+    }
+};
+
+TEST_F(RCPAggregation, OffByDefault) {
+    sendTelemetry(1);
+    sendTelemetry(2);
+    EXPECT_EQ(radioFrames, (std::vector<Bytes>{telemetry(1), telemetry(2)}));
+    EXPECT_EQ(OUT.size(), 22u);
+    EXPECT_EQ(RCP::getAggregationStats(radio).frames, 0u);
+}
+
+TEST_F(RCPAggregation, SizeFlush) {
+    RCP::setAggregation(40, 2000, radio);
+    for(uint8_t id = 1; id <= 3; id++) sendTelemetry(id);
+    EXPECT_TRUE(radioFrames.empty());
+    // Link 0 is not aggregated
+    EXPECT_EQ(OUT.size(), 33u);
+
+    // The fourth does not fit
+    sendTelemetry(4);
+    EXPECT_EQ(radioFrames, (std::vector<Bytes>{concat({telemetry(1), telemetry(2), telemetry(3)})}));
+    const RCP::AggregationStats& stats = RCP::getAggregationStats(radio);
+    EXPECT_EQ(stats.frames, 1u);
+    EXPECT_EQ(stats.packets, 3u);
+    EXPECT_EQ(stats.bytes, 33u);
+    EXPECT_EQ(stats.sizeFlushes, 1u);
+}
+
+TEST_F(RCPAggregation, ExactFit) {
+    RCP::setAggregation(44, 2000, radio);
+    for(uint8_t id = 1; id <= 8; id++) sendTelemetry(id);
+    ASSERT_EQ(radioFrames.size(), 2u);
+    EXPECT_EQ(radioFrames[1], concat({telemetry(5), telemetry(6), telemetry(7), telemetry(8)}));
+    EXPECT_FLOAT_EQ(RCP::getFrameFill(radio), 1.0f);
+}
+
+TEST_F(RCPAggregation, AgeFlush) {
+    RCP::setAggregation(120, 2000, radio);
+    sendTelemetry(1);
+    SYSTIME += 1;
+    RCP::yield();
+    EXPECT_TRUE(radioFrames.empty());
+
+    // Packets are stamped with the time they were sent, so only the first matches telemetry()
+    sendTelemetry(2);
+    SYSTIME += 1;
+    RCP::yield();
+    ASSERT_EQ(radioFrames.size(), 1u);
+    EXPECT_EQ(radioFrames[0].size(), 22u);
+    EXPECT_EQ(Bytes(radioFrames[0].begin(), radioFrames[0].begin() + 11), telemetry(1));
+    EXPECT_EQ(RCP::getAggregationStats(radio).ageFlushes, 1u);
+    EXPECT_NEAR(RCP::getFrameFill(radio), 22.0f / 120, 1e-6);
+
+    // A send notices the deadline too
+    sendTelemetry(3);
+    SYSTIME += 5;
+    sendTelemetry(4);
+    ASSERT_EQ(radioFrames.size(), 2u);
+    EXPECT_EQ(radioFrames[1].size(), 11u);
+    EXPECT_EQ(radioFrames[1][6], 3);
+    EXPECT_EQ(RCP::getAggregationStats(radio).ageFlushes, 2u);
+}
+
+TEST_F(RCPAggregation, ControlSentRightAway) {
+    RCP::setAggregation(120, 2000, radio);
+    sendTelemetry(1);
+    RCP::sendTestState();
+    ASSERT_EQ(radioFrames.size(), 1u);
+    // Sent behind the telemetry before it, in the same frame
+    EXPECT_EQ(Bytes(radioFrames[0].begin(), radioFrames[0].begin() + 11), telemetry(1));
+    EXPECT_EQ(radioFrames[0][12], RCP_DEVCLASS_TEST_STATE);
+    EXPECT_EQ(RCP::getAggregationStats(radio).controlFlushes, 1u);
+    EXPECT_EQ(RCP::getAggregationStats(radio).packets, 2u);
+
+    // Commands answered with actuator states
+    sendTelemetry(2);
+    PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    ASSERT_EQ(radioFrames.size(), 2u);
+    EXPECT_EQ(radioFrames[1][12], RCP_DEVCLASS_SIMPLE_ACTUATOR);
+}
+
+TEST_F(RCPAggregation, Oversized) {
+    RCP::setAggregation(16, 2000, radio);
+    RCP::sendTestState();
+    sendTelemetry(1);
+    RCP::sendFourFloat(RCP_DEVCLASS_GPS, 1, {PI, PI, PI, PI});
+    ASSERT_EQ(radioFrames.size(), 3u);
+    EXPECT_EQ(radioFrames[1], telemetry(1));
+    EXPECT_EQ(radioFrames[2].size(), 23u);
+    EXPECT_EQ(RCP::getAggregationStats(radio).packets, 3u);
+}
+
+TEST_F(RCPAggregation, Framed) {
+    RCP::setFraming(RCP_FRAMING_COBS, radio);
+    RCP::setAggregation(120, 2000, radio);
+    for(uint8_t id = 1; id <= 3; id++) sendTelemetry(id);
+    RCP::flushAggregation();
+    ASSERT_EQ(radioFrames.size(), 1u);
+    EXPECT_EQ(RCP::getAggregationStats(radio).manualFlushes, 1u);
+
+    // One COBS frame per packet
+    RCP::CobsDecoder<> decoder;
+    std::vector<Bytes> packets;
+    decoder.decode(radioFrames[0].data(), radioFrames[0].size(), [&packets](const uint8_t* frame, size_t length) {
+        packets.emplace_back(frame, frame + length);
+        return true;
+    });
+    EXPECT_EQ(packets, (std::vector<Bytes>{telemetry(1), telemetry(2), telemetry(3)}));
+}
+
+TEST_F(RCPAggregation, Link0) {
+    RCP::setAggregation(40, 2000);
+    sendTelemetry(1);
+    EXPECT_EQ(OUT.size(), 0u);
+    EXPECT_EQ(radioFrames.size(), 1u);
+
+    RCP::sendTestState();
+    CHECK_OUTBUF(0x09, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00, 0x00, 0x00, 0x00, 0x01, HFLOATARR(HPI),
+                 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x10);
+}
+
+TEST_F(RCPAggregation, InitKeepsSettings) {
+    RCP::setAggregation(120, 2000, radio);
+    sendTelemetry(1);
+    RCP::init();
+    EXPECT_EQ(RCP::getAggregationStats(radio).frames, 0u);
+    sendTelemetry(2);
+    RCP::flushAggregation();
+    // The frame from before init() was dropped
+    EXPECT_EQ(radioFrames, (std::vector<Bytes>{telemetry(2)}));
+}
+
+TEST_F(RCPAggregation, Removed) {
+    RCP::setAggregation(120, 2000, radio);
+    sendTelemetry(1);
+    RCP::removeTransports();
+    // What was waiting went out before the link went away
+    EXPECT_EQ(radioFrames, (std::vector<Bytes>{telemetry(1)}));
+
+    radio = RCP::addTransport({radioWrite, radioAvailable, radioRead});
+    sendTelemetry(2);
+    EXPECT_EQ(radioFrames.size(), 2u);
+}
+
+#endif
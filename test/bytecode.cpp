@@ -0,0 +1,354 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/bytecode.h"
+
+#define F32(value) HFLOATARR(value)
+
+// Big endian integer operands
+#define U16(value) (uint8_t) (((value) >> 8) & 0xFF), (uint8_t) ((value) & 0xFF)
+#define U32(value) U16(((value) >> 16) & 0xFFFF), U16((value) & 0xFFFF)
+
+class RCPBytecode : public RCPSimpleActuators {
+protected:
+    ::Test::BytecodeProcedure proc;
+
+    RCPBytecode() { SYSTIME = 0; }
+
+    ~RCPBytecode() override = default;
+
+    void tick(int times) {
+        for(int i = 0; i < times && !proc.isFinished(); i++) {
+            SYSTIME++;
+            proc.execute();
+        }
+    }
+};
+
+class RCPBytecodeSensors : public RCPSensors {
+protected:
+    ~RCPBytecodeSensors() override = default;
+};
+
+TEST(RCPBytecodeValidate, Validate) {
+    const uint8_t good[] = {::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_WAIT, U32(100),
+                            ::Test::BC_END};
+    EXPECT_TRUE(::Test::BytecodeProcedure::validate(good, sizeof(good)));
+
+    const uint8_t truncated[] = {::Test::BC_WAIT, U16(100)};
+    EXPECT_FALSE(::Test::BytecodeProcedure::validate(truncated, sizeof(truncated)));
+
+    const uint8_t unknown[] = {0x7F};
+    EXPECT_FALSE(::Test::BytecodeProcedure::validate(unknown, sizeof(unknown)));
+
+    const uint8_t nested[] = {::Test::BC_PARALLEL, 1, U16(5), ::Test::BC_RACE, 1, U16(1), ::Test::BC_END};
+    EXPECT_FALSE(::Test::BytecodeProcedure::validate(nested, sizeof(nested)));
+
+    const uint8_t wide[] = {::Test::BC_PARALLEL, ::Test::BYTECODE_THREADS, U16(0), U16(0), U16(0), U16(0)};
+    EXPECT_FALSE(::Test::BytecodeProcedure::validate(wide, sizeof(wide)));
+
+    const uint8_t overrun[] = {::Test::BC_PARALLEL, 1, U16(10), ::Test::BC_END};
+    EXPECT_FALSE(::Test::BytecodeProcedure::validate(overrun, sizeof(overrun)));
+}
+
+TEST_F(RCPBytecode, Sequence) {
+    const uint8_t program[] = {::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_WAIT, U32(100),
+                               ::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_OFF};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    proc.initialize();
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    tick(100);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_FALSE(proc.isFinished());
+
+    tick(1);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+    tick(1);
+    EXPECT_TRUE(proc.isFinished());
+}
+
+TEST_F(RCPBytecode, Parallel) {
+    const uint8_t program[] = {::Test::BC_PARALLEL,       2, U16(8), ::Test::BC_WAIT, U32(10),
+                               ::Test::BC_SIMPLE_ACTUATOR, 1, RCP_SIMPLE_ACTUATOR_ON, U16(8), ::Test::BC_WAIT,
+                               U32(20),                   ::Test::BC_SIMPLE_ACTUATOR, 2, RCP_SIMPLE_ACTUATOR_ON,
+                               ::Test::BC_SIMPLE_ACTUATOR, 3, RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    proc.initialize();
+    tick(15);
+    EXPECT_EQ(ACTS[1], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[2], RCP_SIMPLE_ACTUATOR_OFF);
+
+    tick(10);
+    EXPECT_EQ(ACTS[2], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[3], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_TRUE(proc.isFinished());
+}
+
+TEST_F(RCPBytecode, Race) {
+    const uint8_t program[] = {::Test::BC_RACE,           2, U16(8), ::Test::BC_WAIT, U32(10),
+                               ::Test::BC_SIMPLE_ACTUATOR, 1, RCP_SIMPLE_ACTUATOR_ON, U16(8), ::Test::BC_WAIT,
+                               U32(20),                   ::Test::BC_SIMPLE_ACTUATOR, 2, RCP_SIMPLE_ACTUATOR_ON,
+                               ::Test::BC_SIMPLE_ACTUATOR, 3, RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    proc.initialize();
+    tick(100);
+    EXPECT_TRUE(proc.isFinished());
+    EXPECT_EQ(ACTS[1], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[2], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(ACTS[3], RCP_SIMPLE_ACTUATOR_ON);
+}
+
+TEST_F(RCPBytecode, BoundedTick) {
+    uint8_t program[::Test::BYTECODE_PROGRAM_SIZE];
+    for(int i = 0; i < 80; i++) {
+        program[i * 3] = ::Test::BC_SIMPLE_ACTUATOR;
+        program[i * 3 + 1] = i;
+        program[i * 3 + 2] = RCP_SIMPLE_ACTUATOR_ON;
+    }
+    ASSERT_TRUE(proc.load(program, 240));
+
+    proc.initialize();
+    EXPECT_EQ(ACTS[::Test::BYTECODE_STEPS_PER_TICK - 1], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[::Test::BYTECODE_STEPS_PER_TICK], RCP_SIMPLE_ACTUATOR_OFF);
+
+    tick(1);
+    EXPECT_EQ(ACTS[2 * ::Test::BYTECODE_STEPS_PER_TICK - 1], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[2 * ::Test::BYTECODE_STEPS_PER_TICK], RCP_SIMPLE_ACTUATOR_OFF);
+}
+
+TEST_F(RCPBytecode, PromptGo) {
+    const uint8_t program[] = {::Test::BC_PROMPT_GONOGO, 3, 'G', 'O', '?', ::Test::BC_SIMPLE_ACTUATOR, 0,
+                               RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    proc.initialize();
+    CHECK_OUTBUF(0x04, RCP_DEVCLASS_PROMPT, RCP_PromptDataType_GONOGO, 'G', 'O', '?');
+    tick(10);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+
+    PUSH(0x01, RCP_DEVCLASS_PROMPT, RCP_GONOGO_GO);
+    RCP::yield();
+    tick(1);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_TRUE(proc.isFinished());
+}
+
+TEST_F(RCPBytecode, PromptNoGo) {
+    const uint8_t program[] = {::Test::BC_PROMPT_GONOGO, 0, ::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    proc.initialize();
+    PUSH(0x01, RCP_DEVCLASS_PROMPT, RCP_GONOGO_NOGO);
+    RCP::yield();
+    tick(1);
+    EXPECT_TRUE(proc.isFinished());
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+}
+
+TEST_F(RCPBytecodeSensors, SensorWait) {
+    ::Test::BytecodeProcedure proc;
+    const uint8_t program[] = {::Test::BC_WAIT_SENSOR, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1, ::Test::BC_GREATER,
+                               F32(HPI)};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+
+    SENSE[1] = 0;
+    proc.initialize();
+    proc.execute();
+    EXPECT_FALSE(proc.isFinished());
+
+    SENSE[1] = PI;
+    proc.execute();
+    EXPECT_FALSE(proc.isFinished());
+
+    SENSE[1] = PI2;
+    proc.execute();
+    EXPECT_TRUE(proc.isFinished());
+}
+
+TEST_F(RCPBytecode, Upload) {
+    const uint8_t program[] = {::Test::BC_SIMPLE_ACTUATOR, 4, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_WAIT, U32(5),
+                               ::Test::BC_SIMPLE_ACTUATOR, 5, RCP_SIMPLE_ACTUATOR_ON};
+    ::Test::Procedure* previous = ::Test::getTests()[3];
+
+    const uint8_t begin[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, 0, 3, 0, sizeof(program)};
+    EXPECT_TRUE(::Test::handleBytecodeUpload(begin, sizeof(begin)));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, ::Test::BYTECODE_OK);
+
+    for(uint8_t offset = 0; offset < sizeof(program); offset += 4) {
+        uint8_t chunk = sizeof(program) - offset < 4 ? sizeof(program) - offset : 4;
+        uint8_t data[9] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, 0, 0, offset};
+        memcpy(data + 5, program + offset, chunk);
+        EXPECT_TRUE(::Test::handleBytecodeUpload(data, 5 + chunk));
+        CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA,
+                     ::Test::BYTECODE_OK);
+    }
+
+    const uint8_t commit[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT, 0};
+    EXPECT_TRUE(::Test::handleBytecodeUpload(commit, sizeof(commit)));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_OK);
+    EXPECT_EQ(::Test::getTests()[3], &::Test::getBytecodeProgram(0));
+
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x03);
+    RCP::yield();
+    for(int i = 0; i < 10; i++) {
+        SYSTIME++;
+        RCP::runTest();
+    }
+
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    ::Test::getTests().tests[3] = previous;
+}
+
+TEST_F(RCPBytecode, UploadRejected) {
+    const uint8_t notUpload[] = {'H', 'I', '!'};
+    EXPECT_FALSE(::Test::handleBytecodeUpload(notUpload, sizeof(notUpload)));
+
+    const uint8_t badProgram[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, ::Test::BYTECODE_PROGRAMS, 3,
+                                  0, 1};
+    EXPECT_TRUE(::Test::handleBytecodeUpload(badProgram, sizeof(badProgram)));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN,
+                 ::Test::BYTECODE_BAD_PROGRAM);
+
+    const uint8_t tooLong[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, 1, 3, 0x10, 0};
+    EXPECT_TRUE(::Test::handleBytecodeUpload(tooLong, sizeof(tooLong)));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN,
+                 ::Test::BYTECODE_TOO_LONG);
+
+    const uint8_t begin[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, 1, 3, 0, 1};
+    const uint8_t data[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, 1, 0, 0, 0x7F};
+    const uint8_t commit[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT, 1};
+    ::Test::handleBytecodeUpload(begin, sizeof(begin));
+    ::Test::handleBytecodeUpload(data, sizeof(data));
+    OUT.clear();
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_INVALID);
+    EXPECT_FALSE(::Test::getBytecodeProgram(1).isLoaded());
+}
+
+TEST_F(RCPBytecode, CommitWithoutBegin) {
+    const uint8_t program[] = {::Test::BC_SIMPLE_ACTUATOR, 4, RCP_SIMPLE_ACTUATOR_ON};
+    ::Test::Procedure* previous = ::Test::getTests()[0];
+    const uint8_t commit[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT, 0};
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_BAD_COMMAND);
+    EXPECT_EQ(::Test::getTests()[0], previous);
+
+    // Nor can a program be committed twice
+    const uint8_t begin[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, 0, 0, 0, sizeof(program)};
+    const uint8_t data[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, 0, 0, 0,
+                            ::Test::BC_SIMPLE_ACTUATOR, 4, RCP_SIMPLE_ACTUATOR_ON};
+    ::Test::handleBytecodeUpload(begin, sizeof(begin));
+    ::Test::handleBytecodeUpload(data, sizeof(data));
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    EXPECT_EQ(::Test::getTests()[0], &::Test::getBytecodeProgram(0));
+    OUT.clear();
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_BAD_COMMAND);
+
+    ::Test::getTests().tests[0] = previous;
+}
+
+TEST_F(RCPBytecode, UploadLostData) {
+    const uint8_t program[] = {::Test::BC_SIMPLE_ACTUATOR, 4, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_WAIT, U32(5),
+                               ::Test::BC_SIMPLE_ACTUATOR, 5, RCP_SIMPLE_ACTUATOR_ON};
+    auto sendData = [&](uint8_t offset) {
+        uint8_t chunk = sizeof(program) - offset < 4 ? sizeof(program) - offset : 4;
+        uint8_t data[9] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, 1, 0, offset};
+        memcpy(data + 5, program + offset, chunk);
+        OUT.clear();
+        ::Test::handleBytecodeUpload(data, 5 + chunk);
+    };
+    ::Test::Procedure* previous = ::Test::getTests()[3];
+
+    const uint8_t begin[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_BEGIN, 1, 3, 0, sizeof(program)};
+    const uint8_t commit[] = {::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT, 1};
+    ::Test::handleBytecodeUpload(begin, sizeof(begin));
+
+    // The packet at offset 4 is lost
+    sendData(0);
+    sendData(8);
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, ::Test::BYTECODE_GAP);
+
+    OUT.clear();
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_INCOMPLETE);
+    EXPECT_FALSE(::Test::getBytecodeProgram(1).isLoaded());
+
+    // Resending from the gap, overlapping bytes already received, completes the upload
+    sendData(0);
+    sendData(4);
+    sendData(8);
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_DATA, ::Test::BYTECODE_OK);
+    OUT.clear();
+    ::Test::handleBytecodeUpload(commit, sizeof(commit));
+    CHECK_OUTBUF(0x03, RCP_DEVCLASS_CUSTOM, ::Test::BYTECODE_UPLOAD_MAGIC, ::Test::BYTECODE_COMMIT,
+                 ::Test::BYTECODE_OK);
+    EXPECT_TRUE(::Test::getBytecodeProgram(1).isLoaded());
+
+    ::Test::getTests().tests[3] = previous;
+}
+
+TEST_F(RCPBytecode, BigEndianOperands) {
+    // 0x0102 ms is 258, the little endian reading would be 513
+    const uint8_t program[] = {::Test::BC_WAIT, U32(0x0102), ::Test::BC_SIMPLE_ACTUATOR, 4, RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_TRUE(proc.load(program, sizeof(program)));
+    proc.initialize();
+    tick(257);
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_OFF);
+    tick(2);
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+}
+
+// Compares the RAM used by a program against the same sequence built from procedure objects. Every object is its
+// own heap allocation, so allocator overhead (assumed 8 bytes per block, typical of newlib) is counted as well.
+TEST(RCPBytecodeRam, BytecodeRam) {
+    constexpr size_t HEAP_OVERHEAD = 8;
+    size_t allocations = 0;
+    size_t treeBytes = 0;
+    auto node = [&](size_t size) {
+        allocations++;
+        treeBytes += size;
+    };
+
+    // SequentialProcedure(OneShot, WaitProcedure, OneShot,
+    //     ParallelProcedure(SequentialProcedure(WaitProcedure, OneShot), SequentialProcedure(WaitProcedure, OneShot)),
+    //     OneShot)
+    node(sizeof(::Test::SequentialProcedure));
+    node(5 * sizeof(::Test::Procedure*));
+    for(int i = 0; i < 3; i++) node(sizeof(::Test::OneShot));
+    node(sizeof(::Test::WaitProcedure));
+    node(sizeof(::Test::ParallelProcedure));
+    node(2 * sizeof(::Test::Procedure*));
+    node(2 * sizeof(bool));
+    for(int i = 0; i < 2; i++) {
+        node(sizeof(::Test::SequentialProcedure));
+        node(2 * sizeof(::Test::Procedure*));
+        node(sizeof(::Test::WaitProcedure));
+        node(sizeof(::Test::OneShot));
+    }
+    treeBytes += allocations * HEAP_OVERHEAD;
+
+    const uint8_t program[] = {::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_WAIT, U32(100),
+                               ::Test::BC_SIMPLE_ACTUATOR, 1, RCP_SIMPLE_ACTUATOR_ON, ::Test::BC_PARALLEL, 2, U16(8),
+                               ::Test::BC_WAIT, U32(10), ::Test::BC_SIMPLE_ACTUATOR, 2, RCP_SIMPLE_ACTUATOR_ON, U16(8),
+                               ::Test::BC_WAIT, U32(20), ::Test::BC_SIMPLE_ACTUATOR, 3, RCP_SIMPLE_ACTUATOR_ON,
+                               ::Test::BC_SIMPLE_ACTUATOR, 0, RCP_SIMPLE_ACTUATOR_OFF};
+    ASSERT_TRUE(::Test::BytecodeProcedure::validate(program, sizeof(program)));
+
+    // The programs are always resident, whether or not anything was uploaded, so the code itself costs nothing more.
+    // With a sequence like this one in every program, they still take less RAM than the trees would.
+    size_t residentBytes = ::Test::BYTECODE_PROGRAMS * sizeof(::Test::BytecodeProcedure);
+    EXPECT_LE(sizeof(program), ::Test::BYTECODE_PROGRAM_SIZE);
+    EXPECT_LT(residentBytes, ::Test::BYTECODE_PROGRAMS * treeBytes);
+}
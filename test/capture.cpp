@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "RCP_Host/capture.h"
+#include "RCP_Host/replay.h"
+#include "RCP_Target/RCP_Target.h"
+
+static std::vector<RCPCapture::Chunk> readAll(const RCPCapture::Reader& reader, uint64_t from = 0) {
+    std::vector<RCPCapture::Chunk> chunks;
+    RCPCapture::Chunk chunk{};
+    RCPCapture::Reader::Cursor cursor = reader.seek(from);
+    while(cursor.next(chunk)) chunks.push_back(chunk);
+    return chunks;
+}
+
+class RCPCaptureTest : public testing::Test {
+protected:
+    std::string path;
+
+    RCPCaptureTest() {
+        path = testing::TempDir() + "rcpt_capture_" + std::to_string(getpid()) + "_" +
+               testing::UnitTest::GetInstance()->current_test_info()->name();
+    }
+
+    ~RCPCaptureTest() override { remove(path.c_str()); }
+};
+
+TEST_F(RCPCaptureTest, WriteRead) {
+    {
+        RCPCapture::Writer writer(path, 4);
+        ASSERT_TRUE(writer.isOpen());
+        for(uint32_t i = 0; i < 20; i++) {
+            std::vector<uint8_t> bytes(i, static_cast<uint8_t>(i));
+            writer.record(i % 2 ? RCPCapture::CAPTURE_TX : RCPCapture::CAPTURE_RX, i * 100, bytes.data(), i);
+        }
+    }
+
+    RCPCapture::Reader reader(path);
+    ASSERT_TRUE(reader.isOpen());
+    EXPECT_TRUE(reader.isIndexed());
+    EXPECT_EQ(reader.chunkCount(), 20u);
+
+    std::vector<RCPCapture::Chunk> chunks = readAll(reader);
+    ASSERT_EQ(chunks.size(), 20u);
+    for(uint32_t i = 0; i < 20; i++) {
+        EXPECT_EQ(chunks[i].time, i * 100);
+        EXPECT_EQ(chunks[i].direction, i % 2 ? RCPCapture::CAPTURE_TX : RCPCapture::CAPTURE_RX);
+        ASSERT_EQ(chunks[i].length, i);
+        for(uint32_t j = 0; j < i; j++) EXPECT_EQ(chunks[i].data[j], i);
+    }
+
+    // Seeking uses the index, then scans to the exact chunk
+    chunks = readAll(reader, 1250);
+    ASSERT_EQ(chunks.size(), 7u);
+    EXPECT_EQ(chunks[0].time, 1300u);
+    EXPECT_TRUE(readAll(reader, 5000).empty());
+}
+
+TEST_F(RCPCaptureTest, Unclosed) {
+    {
+        RCPCapture::Writer writer(path);
+        const uint8_t bytes[] = {1, 2, 3};
+        for(int i = 0; i < 3; i++) writer.record(RCPCapture::CAPTURE_RX, i, bytes, sizeof(bytes));
+    }
+
+    // Cut off the trailer and the end of the last chunk, as if the recording process died
+    FILE* file = fopen(path.c_str(), "r+");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(ftruncate(fileno(file), sizeof(RCPCapture::FileHeader) + 2 * 24 + 18), 0);
+    fclose(file);
+
+    RCPCapture::Reader reader(path);
+    ASSERT_TRUE(reader.isOpen());
+    EXPECT_FALSE(reader.isIndexed());
+    EXPECT_EQ(reader.chunkCount(), 2u);
+    EXPECT_EQ(readAll(reader, 1).size(), 1u);
+}
+
+TEST_F(RCPCaptureTest, NotACapture) {
+    FILE* file = fopen(path.c_str(), "w");
+    fputs("definitely not a capture", file);
+    fclose(file);
+
+    EXPECT_FALSE(RCPCapture::Reader(path).isOpen());
+    EXPECT_FALSE(RCPCapture::Reader(path + "_missing").isOpen());
+}
+
+TEST_F(RCPCaptureTest, Replay) {
+    // A packet split across two chunks, a test state query, and a foreign channel packet
+    {
+        RCPCapture::Writer writer(path);
+        const uint8_t first[] = {0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR};
+        const uint8_t second[] = {0x00, RCP_SIMPLE_ACTUATOR_ON, 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY,
+                                  RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY};
+        const uint8_t sent[7] = {};
+        writer.record(RCPCapture::CAPTURE_RX, 1000, first, sizeof(first));
+        writer.record(RCPCapture::CAPTURE_RX, 2000, second, sizeof(second));
+        writer.record(RCPCapture::CAPTURE_TX, 2100, sent, sizeof(sent));
+    }
+
+    RCPCapture::Reader reader(path);
+    RCPReplay::Result result = RCPReplay::replay(reader);
+    EXPECT_EQ(result.chunks, 3u);
+    EXPECT_EQ(result.rxBytes, 10u);
+    // The actuator state echo and the test state
+    EXPECT_EQ(result.txBytes, 15u);
+    EXPECT_EQ(result.recordedTxBytes, 7u);
+    EXPECT_EQ(RCP::systimeMicros(), 2000u);
+
+    // Replaying from a later time skips the first chunk. The rest of the split packet then reads as two ESTOPs.
+    RCPReplay::Options options;
+    options.from = 1500;
+    result = RCPReplay::replay(reader, options);
+    EXPECT_EQ(result.chunks, 2u);
+    EXPECT_EQ(result.rxBytes, 8u);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+}
+
+TEST_F(RCPCaptureTest, Tap) {
+    std::string source = path + "_source";
+    {
+        RCPCapture::Writer writer(source);
+        const uint8_t query[] = {0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY};
+        for(int i = 0; i < 3; i++) writer.record(RCPCapture::CAPTURE_RX, i * 1000, query, sizeof(query));
+    }
+
+    // Record what the target reads and writes while the source capture is replayed into it
+    {
+        RCPCapture::Reader reader(source);
+        RCPCapture::Writer writer(path);
+        writer.attach();
+        RCPReplay::replay(reader);
+    }
+
+    remove(source.c_str());
+    RCPCapture::Reader reader(path);
+    std::vector<RCPCapture::Chunk> chunks = readAll(reader);
+    ASSERT_EQ(chunks.size(), 6u);
+    for(size_t i = 0; i < chunks.size(); i++) {
+        EXPECT_EQ(chunks[i].direction, i % 2 ? RCPCapture::CAPTURE_TX : RCPCapture::CAPTURE_RX);
+        EXPECT_EQ(chunks[i].length, i % 2 ? 7u : 3u);
+    }
+
+    EXPECT_EQ(chunks[2].time - chunks[0].time, 1000u);
+}
@@ -0,0 +1,197 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/channels.h"
+#include "RCP_Target/stats.h"
+
+#if RCPT_CHANNELS > 1
+
+// The actuators of the ignition controller served on channel one
+static RCP_SimpleActuatorState igniters[256];
+
+static RCP_SimpleActuatorState igniterRead(uint8_t id) { return igniters[id]; }
+
+static RCP_SimpleActuatorState igniterWrite(uint8_t id, RCP_SimpleActuatorState state) {
+    igniters[id] = state;
+    return state;
+}
+
+// The channel each procedure ran on
+static RCP_Channel ranOn;
+static bool igniterRan;
+static bool primaryRan;
+static ::Test::OneShot igniterShot([] {
+    igniterRan = true;
+    ranOn = RCP::channel;
+});
+static ::Test::OneShot primaryShot([] { primaryRan = true; });
+static ::Test::Tests igniterTests = {{nullptr, &igniterShot}};
+
+class RCPChannels : public RCPSimpleActuators {
+protected:
+    RCPChannels() {
+        for(auto& igniter : igniters) igniter = RCP_SIMPLE_ACTUATOR_OFF;
+        igniterRan = false;
+        primaryRan = false;
+        ranOn = RCP_CH_ZERO;
+        RCP::ChannelCallbacks callbacks = {};
+        callbacks.readSimpleActuator = igniterRead;
+        callbacks.simpleActuatorWrite_CLBK = igniterWrite;
+        RCP::addChannel(RCP_CH_ONE, callbacks, &igniterTests);
+    }
+
+    ~RCPChannels() override { RCP::removeChannels(); }
+};
+
+TEST_F(RCPChannels, OwnCallbacks) {
+    EXPECT_EQ(RCP::getChannelCount(), 2);
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(igniters[4], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_OFF);
+    // Answered on the channel it was for
+    CHECK_OUTBUF(RCP_CH_ONE | 0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x04,
+                 RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::channel, RCP_CH_ZERO);
+
+    PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(igniters[5], RCP_SIMPLE_ACTUATOR_OFF);
+    CHECK_OUTBUF(0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+}
+
+TEST_F(RCPChannels, OwnTestState) {
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, 0x21);
+    RCP::yield();
+    // Not ready, unlike the primary channel
+    CHECK_OUTBUF(RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x80);
+    EXPECT_FALSE(RCP::getDataStreaming());
+
+    RCP::channel = RCP_CH_ONE;
+    EXPECT_TRUE(RCP::getDataStreaming());
+    RCP::setReady(true);
+    CHECK_OUTBUF(RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x90);
+    RCP::channel = RCP_CH_ZERO;
+
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x20);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x10);
+}
+
+TEST_F(RCPChannels, OwnProcedures) {
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &primaryShot;
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, 0x01);
+    RCP::yield();
+    OUT.clear();
+    RCP::runTest();
+    EXPECT_TRUE(igniterRan);
+    EXPECT_FALSE(primaryRan);
+    EXPECT_EQ(ranOn, RCP_CH_ONE);
+    EXPECT_EQ(RCP::channel, RCP_CH_ZERO);
+    // Finished, and the state sent on its channel
+    CHECK_OUTBUF(RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED);
+
+    // Both channels can run test 1 at once
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x01);
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, 0x01);
+    RCP::yield();
+    RCP::yield();
+    igniterRan = false;
+    RCP::runTest();
+    EXPECT_TRUE(igniterRan);
+    EXPECT_TRUE(primaryRan);
+    ::Test::getTests().tests[1] = previous;
+}
+
+TEST_F(RCPChannels, OwnHeartbeat) {
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, 0xF5);
+    RCP::yield();
+    CHECK_OUTBUF(RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x05);
+    EXPECT_EQ(RCP::getHeartbeatTimeout(), 0u);
+
+    SYSTIME = 5;
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    // The ESTOP is the whole board's
+    SYSTIME = 6;
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(RCP::getEstopStats().watchdogTrips, 1u);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x06, RCP_TEST_ESTOP | 0x10,
+                 RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x06, RCP_TEST_ESTOP | 0x05);
+}
+
+TEST_F(RCPChannels, RemovedHeartbeat) {
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, 0xF5);
+    RCP::yield();
+    OUT.clear();
+    RCP::removeChannels();
+
+    // A channel no longer served can not ESTOP the board
+    SYSTIME = 100;
+    RCP::checkHeartbeat();
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    EXPECT_EQ(RCP::getEstopStats().watchdogTrips, 0u);
+    EXPECT_TRUE(OUT.isEmpty());
+}
+
+TEST_F(RCPChannels, EstopStopsEveryChannel) {
+    static ::Test::OneShot estop([] { ranOn = RCP::channel; });
+    RCP::ESTOP_PROC = &estop;
+    ranOn = RCP_CH_THREE;
+    PUSH(RCP_CH_ONE);
+    RCP::yield();
+    RCP::ESTOP_PROC = nullptr;
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    // The ESTOP procedure started on the primary channel
+    EXPECT_EQ(ranOn, RCP_CH_ZERO);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_ESTOP | 0x10,
+                 RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_ESTOP);
+
+    // Once it is done, so is every channel's ESTOP
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED | 0x10,
+                 RCP_CH_ONE | 0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, RCP_TEST_STOPPED);
+}
+
+TEST_F(RCPChannels, OthersDropped) {
+    PUSH(RCP_CH_TWO | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_TRUE(OUT.isEmpty());
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(igniters[4], RCP_SIMPLE_ACTUATOR_OFF);
+#if RCPT_STATS
+    EXPECT_EQ(RCP::getRuntimeStats().foreignChannel, 1u);
+#endif
+}
+
+TEST_F(RCPChannels, Added) {
+    RCP::ChannelCallbacks none = {};
+    EXPECT_FALSE(RCP::addChannel(RCP_CH_ZERO, none));
+    EXPECT_FALSE(RCP::addChannel(RCP_CH_ONE, none));
+    EXPECT_TRUE(RCP::addChannel(RCP_CH_TWO, none));
+    EXPECT_EQ(RCP::getChannelCount(), 3);
+
+    // Null callbacks are the global hooks
+    PUSH(RCP_CH_TWO | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+    CHECK_OUTBUF(RCP_CH_TWO | 0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x04,
+                 RCP_SIMPLE_ACTUATOR_ON);
+
+    // Kept through init()
+    RCP::init();
+    EXPECT_EQ(RCP::getChannelCount(), 3);
+    RCP::removeChannels();
+    EXPECT_EQ(RCP::getChannelCount(), 1);
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(igniters[4], RCP_SIMPLE_ACTUATOR_OFF);
+}
+
+#endif
@@ -0,0 +1,99 @@
+// Built against RCP-Target-Minimal: simple actuators and one float sensors only, no prompts or procedures
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/stats.h"
+
+static_assert(!RCPT_PROCEDURES && !RCPT_PROMPTS && !RCPT_STEPPERS && RCPT_SIMPLE_ACTUATORS,
+              "RCPT_ConfigTests must be built against RCP-Target-Minimal");
+static_assert(RCPT_SEND_ONE_FLOAT && !RCPT_SEND_TWO_FLOAT && !RCPT_SEND_FOUR_FLOAT);
+
+static std::vector<uint8_t> in;
+static std::vector<uint8_t> out;
+static RCP_SimpleActuatorState actuator;
+static bool estopped;
+
+namespace RCP {
+    void write(const void* data, uint8_t length) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + length);
+    }
+
+    uint8_t readAvail() { return in.size(); }
+
+    uint8_t read() {
+        uint8_t val = in.front();
+        in.erase(in.begin());
+        return val;
+    }
+
+    RCP_SimpleActuatorState readSimpleActuator([[maybe_unused]] uint8_t id) { return actuator; }
+
+    RCP_SimpleActuatorState simpleActuatorWrite_CLBK([[maybe_unused]] uint8_t id, RCP_SimpleActuatorState state) {
+        actuator = state;
+        return state;
+    }
+
+    Floats4 readSensor([[maybe_unused]] RCP_DeviceClass devclass, [[maybe_unused]] uint8_t id) {
+        return {{1.5f, 0, 0, 0}};
+    }
+} // namespace RCP
+
+class RCPMinimal : public testing::Test {
+protected:
+    RCPMinimal() {
+        in.clear();
+        out.clear();
+        actuator = RCP_SIMPLE_ACTUATOR_OFF;
+        estopped = false;
+        RCP::init();
+    }
+
+    void feed(std::initializer_list<uint8_t> bytes) {
+        in.insert(in.end(), bytes);
+        while(!in.empty() || RCP::rxBuffered() != 0) RCP::yield();
+    }
+};
+
+TEST_F(RCPMinimal, EnabledClasses) {
+    feed({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x03, RCP_SIMPLE_ACTUATOR_ON});
+    EXPECT_EQ(actuator, RCP_SIMPLE_ACTUATOR_ON);
+    ASSERT_EQ(out.size(), 8u);
+    EXPECT_EQ(out[1], RCP_DEVCLASS_SIMPLE_ACTUATOR);
+    EXPECT_EQ(out[7], RCP_SIMPLE_ACTUATOR_ON);
+
+    out.clear();
+    feed({0x01, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00});
+    ASSERT_EQ(out.size(), 11u);
+    EXPECT_EQ(out[1], RCP_DEVCLASS_PRESSURE_TRANSDUCER);
+}
+
+TEST_F(RCPMinimal, DisabledClassesIgnored) {
+    feed({0x01, RCP_DEVCLASS_STEPPER, 0x00});
+    feed({0x01, RCP_DEVCLASS_GPS, 0x00});
+    feed({0x01, RCP_DEVCLASS_PROMPT, 0x01});
+    feed({0x02, RCP_DEVCLASS_CUSTOM, 0xD1, 0x05});
+    EXPECT_TRUE(out.empty());
+#if RCPT_STATS
+    // Custom data is still compiled in, the rest count as unknown
+    EXPECT_EQ(RCP::getRuntimeStats().unknownClass, 3u);
+#endif
+}
+
+TEST_F(RCPMinimal, NoProcedures) {
+    feed({0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_START | 0x02});
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    EXPECT_FALSE(RCP::startProcedure(2));
+
+    RCP::ESTOP_ACTION = [] { estopped = true; };
+    out.clear();
+    feed({0x00});
+    RCP::ESTOP_ACTION = nullptr;
+    EXPECT_TRUE(estopped);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    ASSERT_EQ(out.size(), 7u);
+    EXPECT_EQ(out[6] & RCP_TEST_STATE_MASK, RCP_TEST_ESTOP);
+}
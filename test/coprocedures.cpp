@@ -0,0 +1,157 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/coprocedures.h"
+
+#ifdef RCPT_COROUTINES
+
+static bool flag = false;
+static int steps = 0;
+
+static ::Test::Task sequence() {
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_ON);
+    co_await ::Test::wait(100);
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_OFF);
+    co_await ::Test::until([] { return flag; });
+    RCP::writeSimpleActuator(1, RCP_SIMPLE_ACTUATOR_ON);
+}
+
+static ::Test::Task counter() {
+    for(int i = 0; i < 3; i++) {
+        steps++;
+        co_await ::Test::wait(10);
+    }
+}
+
+static ::Test::Task joined() {
+    co_await ::Test::all(counter(), ::Test::wait(100));
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_ON);
+}
+
+static ::Test::Task raced() {
+    co_await ::Test::race(counter(), ::Test::until([] { return flag; }));
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_ON);
+}
+
+class RCPCoroutines : public RCPSimpleActuators {
+protected:
+    RCPCoroutines() {
+        flag = false;
+        steps = 0;
+        SYSTIME = 0;
+    }
+
+    ~RCPCoroutines() override = default;
+
+    static void tick(::Test::Procedure& proc, int times) {
+        for(int i = 0; i < times && !proc.isFinished(); i++) {
+            SYSTIME++;
+            proc.execute();
+        }
+    }
+};
+
+TEST_F(RCPCoroutines, Sequence) {
+    ::Test::CoroutineProcedure proc(&sequence);
+    proc.initialize();
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+
+    tick(proc, 100);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    tick(proc, 1);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+
+    tick(proc, 50);
+    EXPECT_FALSE(proc.isFinished());
+    EXPECT_EQ(ACTS[1], RCP_SIMPLE_ACTUATOR_OFF);
+
+    flag = true;
+    tick(proc, 1);
+    EXPECT_EQ(ACTS[1], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_TRUE(proc.isFinished());
+    proc.end(false);
+    EXPECT_EQ(::Test::CoroutinePool::available(), ::Test::COROUTINE_FRAME_COUNT);
+}
+
+TEST_F(RCPCoroutines, Restart) {
+    ::Test::CoroutineProcedure proc(&counter);
+    for(int run = 1; run <= 2; run++) {
+        proc.initialize();
+        tick(proc, 1000);
+        EXPECT_TRUE(proc.isFinished());
+        proc.end(false);
+        EXPECT_EQ(steps, run * 3);
+    }
+}
+
+TEST_F(RCPCoroutines, All) {
+    ::Test::CoroutineProcedure proc(&joined);
+    proc.initialize();
+    tick(proc, 50);
+    EXPECT_EQ(steps, 3);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+
+    tick(proc, 1000);
+    EXPECT_TRUE(proc.isFinished());
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    proc.end(false);
+    EXPECT_EQ(::Test::CoroutinePool::available(), ::Test::COROUTINE_FRAME_COUNT);
+}
+
+TEST_F(RCPCoroutines, Race) {
+    ::Test::CoroutineProcedure proc(&raced);
+    proc.initialize();
+    EXPECT_EQ(steps, 1);
+
+    flag = true;
+    tick(proc, 2);
+    EXPECT_TRUE(proc.isFinished());
+    EXPECT_EQ(steps, 1);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    proc.end(false);
+    EXPECT_EQ(::Test::CoroutinePool::available(), ::Test::COROUTINE_FRAME_COUNT);
+}
+
+TEST_F(RCPCoroutines, Interrupt) {
+    ::Test::CoroutineProcedure proc(&joined);
+    proc.initialize();
+    tick(proc, 5);
+    EXPECT_LT(::Test::CoroutinePool::available(), ::Test::COROUTINE_FRAME_COUNT);
+
+    proc.end(true);
+    EXPECT_TRUE(proc.isFinished());
+    EXPECT_EQ(::Test::CoroutinePool::available(), ::Test::COROUTINE_FRAME_COUNT);
+}
+
+TEST_F(RCPCoroutines, PoolExhausted) {
+    ::Test::Task tasks[::Test::COROUTINE_FRAME_COUNT];
+    for(auto& task : tasks) {
+        task = counter();
+        EXPECT_TRUE(task.valid());
+    }
+
+    ::Test::Task task = counter();
+    EXPECT_FALSE(task.valid());
+    EXPECT_TRUE(task.isFinished());
+}
+
+TEST_F(RCPCoroutines, PoolExhaustedEstops) {
+    ::Test::CoroutineProcedure proc(&sequence);
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &proc;
+    uint32_t failures = ::Test::CoroutinePool::failures();
+
+    ::Test::Task tasks[::Test::COROUTINE_FRAME_COUNT];
+    for(auto& task : tasks) task = counter();
+
+    // Rather than the test silently finishing without running a step
+    RCP::startProcedure(1);
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(::Test::CoroutinePool::failures(), failures + 1);
+
+    ::Test::getTests().tests[1] = previous;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/diagnostics.h"
+#include "RCP_Target/executor.h"
+
+#define U32(value) (uint8_t) ((value) >> 24), (uint8_t) ((value) >> 16), (uint8_t) ((value) >> 8), (uint8_t) (value)
+
+// Counts its executions, and never finishes
+class TickCounter : public ::Test::Procedure {
+public:
+    int ticks = 0;
+
+    void execute() override { ticks++; }
+    bool isFinished() override { return false; }
+};
+
+class RCPExecutor : public RCPTest {
+protected:
+    TickCounter counter;
+    ::Test::Procedure* previous;
+
+    RCPExecutor() {
+        previous = ::Test::getTests()[1];
+        ::Test::getTests().tests[1] = &counter;
+        RCP::startProcedure(1);
+        RCP::resetExecutorStats();
+    }
+
+    ~RCPExecutor() override {
+        RCP::setFixedRate(0);
+        RCP::stopProcedure(1);
+        ::Test::getTests().tests[1] = previous;
+    }
+};
+
+TEST_F(RCPExecutor, FreeRunning) {
+    RCP::setFixedRate(0);
+    for(int i = 0; i < 5; i++) EXPECT_EQ(RCP::runFixedRate(), 1);
+    EXPECT_EQ(counter.ticks, 5);
+}
+
+TEST_F(RCPExecutor, FixedRate) {
+    SYSTIME = 100;
+    RCP::setFixedRate(10000);
+
+    // The first tick runs right away, then once every 10ms however often runFixedRate() is called
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    for(int i = 0; i < 30; i++) {
+        SYSTIME++;
+        RCP::runFixedRate();
+    }
+
+    EXPECT_EQ(counter.ticks, 4);
+    EXPECT_EQ(RCP::getExecutorStats().ticks, 4u);
+    EXPECT_EQ(RCP::getExecutorStats().jitter[0], 3u);
+    EXPECT_EQ(RCP::getExecutorStats().lastPeriod, 10000u);
+    EXPECT_EQ(RCP::getExecutorStats().missed, 0u);
+}
+
+TEST_F(RCPExecutor, Jitter) {
+    SYSTIME = 0;
+    RCP::setFixedRate(10000);
+    RCP::runFixedRate();
+
+    // 3ms late. The schedule does not drift, so the next tick is still due at 20ms
+    SYSTIME = 13;
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    SYSTIME = 19;
+    EXPECT_EQ(RCP::runFixedRate(), 0);
+    SYSTIME = 20;
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+
+    EXPECT_EQ(RCP::getExecutorStats().maxJitter, 3000u);
+    EXPECT_EQ(RCP::getExecutorStats().jitter[0], 1u);
+    EXPECT_EQ(RCP::getExecutorStats().jitter[12 - 1], 1u);
+}
+
+TEST_F(RCPExecutor, CatchUp) {
+    SYSTIME = 0;
+    RCP::setFixedRate(1000, RCP::RCP_EXECUTOR_CATCH_UP, 2);
+    RCP::runFixedRate();
+
+    // 4 ticks missed, 2 of them are caught up
+    SYSTIME = 5;
+    EXPECT_EQ(RCP::runFixedRate(), 3);
+    EXPECT_EQ(counter.ticks, 4);
+    EXPECT_EQ(RCP::getExecutorStats().missed, 4u);
+    EXPECT_EQ(RCP::getExecutorStats().skipped, 2u);
+    EXPECT_EQ(RCP::getExecutorStats().missedRuns[3], 1u);
+}
+
+TEST_F(RCPExecutor, CatchUpMax) {
+    SYSTIME = 0;
+    RCP::setFixedRate(1000, RCP::RCP_EXECUTOR_CATCH_UP, 255);
+    RCP::runFixedRate();
+
+    // 255 caught up ticks plus the one due, more than a uint8_t counts
+    SYSTIME = 1000;
+    EXPECT_EQ(RCP::runFixedRate(), 256);
+    EXPECT_EQ(counter.ticks, 257);
+}
+
+TEST_F(RCPExecutor, Skip) {
+    SYSTIME = 0;
+    RCP::setFixedRate(1000, RCP::RCP_EXECUTOR_SKIP);
+    RCP::runFixedRate();
+
+    SYSTIME = 20;
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    EXPECT_EQ(RCP::getExecutorStats().missed, 19u);
+    EXPECT_EQ(RCP::getExecutorStats().skipped, 19u);
+    EXPECT_EQ(RCP::getExecutorStats().missedRuns[RCP::EXECUTOR_MISSED_BUCKETS - 1], 1u);
+
+    SYSTIME = 21;
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+}
+
+TEST_F(RCPExecutor, TimerTick) {
+    SYSTIME = 0;
+    RCP::setFixedRate(1000);
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+
+    RCP::fixedRateTimerTick();
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    EXPECT_EQ(RCP::runFixedRate(), 0);
+
+    // Once the timer drives the executor, systime() no longer schedules ticks
+    SYSTIME = 50;
+    EXPECT_EQ(RCP::runFixedRate(), 0);
+
+    RCP::fixedRateTimerTick();
+    RCP::fixedRateTimerTick();
+    EXPECT_EQ(RCP::runFixedRate(), 2);
+    EXPECT_EQ(RCP::getExecutorStats().missed, 1u);
+    EXPECT_EQ(counter.ticks, 4);
+}
+
+TEST_F(RCPExecutor, TimerFirstTick) {
+    SYSTIME = 7;
+    RCP::setFixedRate(1000);
+
+    // Driven by the timer from the start, so the first run has no period or jitter to record
+    RCP::fixedRateTimerTick();
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    EXPECT_EQ(RCP::getExecutorStats().lastPeriod, 0u);
+    EXPECT_EQ(RCP::getExecutorStats().jitter[0], 0u);
+
+    SYSTIME = 8;
+    RCP::fixedRateTimerTick();
+    EXPECT_EQ(RCP::runFixedRate(), 1);
+    EXPECT_EQ(RCP::getExecutorStats().lastPeriod, 1000u);
+    EXPECT_EQ(RCP::getExecutorStats().jitter[0], 1u);
+}
+
+TEST_F(RCPExecutor, Diagnostics) {
+    SYSTIME = 0;
+    RCP::setFixedRate(1000);
+    RCP::runFixedRate();
+    SYSTIME = 3;
+    RCP::runFixedRate();
+
+    const uint8_t notDiagnostics[] = {'H', 'I'};
+    EXPECT_FALSE(RCP::handleDiagnostics(notDiagnostics, sizeof(notDiagnostics)));
+
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_EXECUTOR};
+    EXPECT_TRUE(RCP::handleDiagnostics(request, sizeof(request)));
+    CHECK_OUTBUF(0x1A, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_EXECUTOR, U32(4), U32(2), U32(0),
+                 U32(0), U32(3000), U32(1000));
+    CHECK_OUTBUF(0x32, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_EXECUTOR_JITTER, U32(1));
+    OUT.clear();
+
+    const uint8_t reset[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_RESET};
+    EXPECT_TRUE(RCP::handleDiagnostics(reset, sizeof(reset)));
+    CHECK_OUTBUF(0x02, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_RESET);
+    EXPECT_EQ(RCP::getExecutorStats().ticks, 0u);
+}
@@ -0,0 +1,198 @@
+#include <random>
+#include <vector>
+
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/framing.h"
+
+using Bytes = std::vector<uint8_t>;
+
+static Bytes encode(const Bytes& data) {
+    Bytes frame(RCP::cobsEncodedSize(data.size()));
+    frame.resize(RCP::cobsEncode(data.data(), data.size(), frame.data()));
+    return frame;
+}
+
+// Decodes stream in chunks of random size up to maxChunk
+static std::vector<Bytes> decode(const Bytes& stream, std::mt19937& rng, size_t maxChunk,
+                                 RCP::FramingStats* stats = nullptr) {
+    static RCP::CobsDecoder<1024> decoder;
+    decoder.reset();
+    decoder.stats = {};
+    std::vector<Bytes> frames;
+    for(size_t i = 0; i < stream.size();) {
+        size_t chunk = std::min<size_t>(stream.size() - i, 1 + rng() % maxChunk);
+        decoder.decode(stream.data() + i, chunk, [&](const uint8_t* frame, size_t length) {
+            frames.emplace_back(frame, frame + length);
+            return true;
+        });
+        i += chunk;
+    }
+
+    if(stats != nullptr) *stats = decoder.stats;
+    return frames;
+}
+
+TEST(RCPFraming, Encode) {
+    EXPECT_EQ(encode({}), (Bytes{0x01, 0x00}));
+    EXPECT_EQ(encode({0x00}), (Bytes{0x01, 0x01, 0x00}));
+    EXPECT_EQ(encode({0x00, 0x00}), (Bytes{0x01, 0x01, 0x01, 0x00}));
+    EXPECT_EQ(encode({0x11, 0x22, 0x00, 0x33}), (Bytes{0x03, 0x11, 0x22, 0x02, 0x33, 0x00}));
+    EXPECT_EQ(encode({0x11, 0x22, 0x33, 0x44}), (Bytes{0x05, 0x11, 0x22, 0x33, 0x44, 0x00}));
+    EXPECT_EQ(encode({0x11, 0x00, 0x00, 0x00}), (Bytes{0x02, 0x11, 0x01, 0x01, 0x01, 0x00}));
+
+    // Runs of 254 non-zero bytes take a code byte without an implied zero
+    Bytes run(254);
+    for(size_t i = 0; i < run.size(); i++) run[i] = i + 1;
+    Bytes frame = encode(run);
+    ASSERT_EQ(frame.size(), 256u);
+    EXPECT_EQ(frame[0], 0xFF);
+    EXPECT_EQ(frame[255], 0x00);
+
+    run.push_back(0xFF);
+    frame = encode(run);
+    ASSERT_EQ(frame.size(), 258u);
+    EXPECT_EQ(frame[255], 0x02);
+    EXPECT_EQ(frame[256], 0xFF);
+    EXPECT_LE(frame.size(), RCP::cobsEncodedSize(run.size()));
+}
+
+TEST(RCPFraming, RoundTrip) {
+    std::mt19937 rng(1);
+    Bytes stream;
+    std::vector<Bytes> packets;
+    for(int i = 0; i < 300; i++) {
+        // Lengths around the block size, and byte values with plenty of zeros
+        Bytes packet(rng() % 600);
+        for(auto& byte : packet) byte = rng() % 4 == 0 ? 0 : rng();
+        Bytes frame = encode(packet);
+        ASSERT_LE(frame.size(), RCP::cobsEncodedSize(packet.size()));
+        for(size_t j = 0; j + 1 < frame.size(); j++) ASSERT_NE(frame[j], 0) << "zero inside frame " << i;
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        packets.push_back(packet);
+    }
+
+    // Delimiters in a row are not empty frames
+    stream.insert(stream.end(), 3, 0x00);
+
+    RCP::FramingStats stats;
+    EXPECT_EQ(decode(stream, rng, 1), packets);
+    EXPECT_EQ(decode(stream, rng, 97, &stats), packets);
+    EXPECT_EQ(stats.badFrames, 0u);
+}
+
+TEST(RCPFraming, TooLong) {
+    std::mt19937 rng(2);
+    Bytes stream = encode(Bytes(1025, 0x55));
+    Bytes next = encode({0x01, 0x02});
+    stream.insert(stream.end(), next.begin(), next.end());
+
+    RCP::FramingStats stats;
+    EXPECT_EQ(decode(stream, rng, 64, &stats), (std::vector<Bytes>{{0x01, 0x02}}));
+    EXPECT_EQ(stats.frames, 2u);
+    EXPECT_EQ(stats.badFrames, 1u);
+}
+
+// Every frame before the corrupted one and every frame from the second after it is decoded intact
+TEST(RCPFraming, CorruptedStreams) {
+    std::mt19937 rng(3);
+    for(int trial = 0; trial < 500; trial++) {
+        std::vector<Bytes> packets;
+        std::vector<size_t> starts;
+        Bytes stream;
+        for(int i = 0; i < 20; i++) {
+            Bytes packet(1 + rng() % 64);
+            for(auto& byte : packet) byte = rng() % 8 == 0 ? 0 : rng();
+            packets.push_back(packet);
+            starts.push_back(stream.size());
+            Bytes frame = encode(packet);
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+        starts.push_back(stream.size());
+
+        // Flip, drop or add one byte, delimiters included
+        size_t victim = rng() % packets.size();
+        size_t at = starts[victim] + rng() % (starts[victim + 1] - starts[victim]);
+        switch(rng() % 3) {
+        case 0:
+            stream[at] ^= 1 + rng() % 255;
+            break;
+        case 1:
+            stream.erase(stream.begin() + at);
+            break;
+        default:
+            stream.insert(stream.begin() + at, rng());
+            break;
+        }
+
+        std::vector<Bytes> frames = decode(stream, rng, 32);
+        size_t intactAfter = packets.size() - std::min(victim + 2, packets.size());
+        ASSERT_GE(frames.size(), victim + intactAfter) << "trial " << trial;
+        ASSERT_LE(frames.size(), packets.size() + 1) << "trial " << trial;
+        for(size_t i = 0; i < victim; i++) EXPECT_EQ(frames[i], packets[i]) << "trial " << trial << " frame " << i;
+        for(size_t i = 1; i <= intactAfter; i++) {
+            EXPECT_EQ(frames[frames.size() - i], packets[packets.size() - i]) << "trial " << trial;
+        }
+    }
+}
+
+class RCPFramedLink : public RCPSimpleActuators {
+protected:
+    RCPFramedLink() { RCP::setFraming(RCP_FRAMING_COBS); }
+
+    ~RCPFramedLink() override { RCP::setFraming(RCP_FRAMING_RAW); }
+
+public:
+    static void pushFrame(const Bytes& packet) {
+        for(uint8_t byte : encode(packet)) IN.push(byte);
+    }
+
+    // Decodes everything written so far
+    static std::vector<Bytes> sent() {
+        Bytes stream;
+        uint8_t byte;
+        while(OUT.pop(byte)) stream.push_back(byte);
+        std::mt19937 rng(0);
+        return decode(stream, rng, 64);
+    }
+};
+
+TEST_F(RCPFramedLink, Commands) {
+    EXPECT_EQ(RCP::getFraming(), RCP_FRAMING_COBS);
+    pushFrame({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON});
+    RCP::yield();
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+    Bytes state = {0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x04, RCP_SIMPLE_ACTUATOR_ON};
+    EXPECT_EQ(sent(), std::vector<Bytes>{state});
+    EXPECT_EQ(RCP::getFramingStats().frames, 1u);
+}
+
+TEST_F(RCPFramedLink, BadFramesDropped) {
+    // A frame that is cut short runs into the next one, and both are lost as one bad frame
+    Bytes frame = encode({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON});
+    for(size_t i = 0; i < 3; i++) IN.push(frame[i]);
+    pushFrame({0x03, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON});
+    pushFrame({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x06, RCP_SIMPLE_ACTUATOR_ON});
+    for(int i = 0; i < 3; i++) RCP::yield();
+
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(ACTS[6], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::getFramingStats().frames, 2u);
+    EXPECT_EQ(RCP::getFramingStats().badFrames, 1u);
+    EXPECT_EQ(RCP::rxBuffered(), 0u);
+}
+
+TEST_F(RCPFramedLink, Estop) {
+    pushFrame({0x00});
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(RCP::getEstopStats().detected, 1u);
+
+    // Raw scanning would see COBS bytes, not headers
+    const uint8_t zero = 0;
+    RCP::scanRxBytes(&zero, 1);
+    RCP::yield();
+    EXPECT_EQ(RCP::getEstopStats().detected, 1u);
+}
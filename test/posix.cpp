@@ -0,0 +1,387 @@
+// Built against RCPT_Posix, which provides the read/write/systime hooks
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "RCP_Host/posix.h"
+#include "RCP_Target/RCP_Target.h"
+
+using Clock = std::chrono::steady_clock;
+
+static RCP_SimpleActuatorState actuators[256];
+
+namespace RCP {
+    RCP_SimpleActuatorState readSimpleActuator(uint8_t id) { return actuators[id]; }
+
+    RCP_SimpleActuatorState simpleActuatorWrite_CLBK(uint8_t id, RCP_SimpleActuatorState state) {
+        actuators[id] = state;
+        return state;
+    }
+} // namespace RCP
+
+class RCPPosixTest : public testing::Test {
+protected:
+    int targetFd = -1;
+    int hostFd = -1;
+    RCPShm::Link targetLink;
+    RCPShm::Link hostLink;
+    std::vector<uint8_t> received;
+
+    ~RCPPosixTest() override {
+        RCP::setReady(false);
+        RCPPosix::stop();
+        if(targetFd >= 0) close(targetFd);
+        if(hostFd >= 0) close(hostFd);
+    }
+
+    void socketPair() {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        hostFd = fds[0];
+        targetFd = fds[1];
+    }
+
+    void start(bool ioThread) {
+        RCPPosix::Options options;
+        options.ioThread = ioThread;
+        ASSERT_TRUE(RCPPosix::start(targetFd, options));
+        RCP::init();
+        RCP::setReady(true);
+        // Discard the test state packet setReady() sends
+        RCPPosix::flush();
+        ASSERT_TRUE(receive(7));
+        received.clear();
+    }
+
+    void startShm(size_t ringSize = 4096, uint32_t txTimeoutMs = 1000) {
+        ASSERT_TRUE(targetLink.create(nullptr, ringSize));
+        ASSERT_TRUE(hostLink.attach(targetLink.fd()));
+        RCPPosix::Options options;
+        options.txTimeoutMs = txTimeoutMs;
+        ASSERT_TRUE(RCPPosix::start(targetLink, options));
+        RCP::init();
+        RCP::setReady(true);
+        ASSERT_TRUE(receiveShm(7));
+        received.clear();
+    }
+
+    // Like receive(), from the host end of the shared memory link
+    bool receiveShm(size_t count, bool runTarget = false) {
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while(received.size() < count && Clock::now() < deadline) {
+            if(runTarget) RCP::yield();
+            else hostLink.waitReadable(10);
+
+            uint8_t chunk[4096];
+            size_t len = hostLink.receive(chunk, sizeof(chunk));
+            received.insert(received.end(), chunk, chunk + len);
+        }
+
+        return received.size() >= count;
+    }
+
+    void hostSend(std::initializer_list<uint8_t> bytes) {
+        std::vector<uint8_t> pkt(bytes);
+        ASSERT_EQ(::write(hostFd, pkt.data(), pkt.size()), static_cast<ssize_t>(pkt.size()));
+    }
+
+    // Reads from the host end until at least count bytes have arrived, running the target loop meanwhile
+    bool receive(size_t count, bool runTarget = false) {
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while(received.size() < count && Clock::now() < deadline) {
+            if(runTarget) RCP::yield();
+            pollfd pfd = {hostFd, POLLIN, 0};
+            if(poll(&pfd, 1, runTarget ? 0 : 10) <= 0) continue;
+
+            uint8_t chunk[4096];
+            ssize_t len = ::read(hostFd, chunk, sizeof(chunk));
+            if(len > 0) received.insert(received.end(), chunk, chunk + len);
+        }
+
+        return received.size() >= count;
+    }
+};
+
+TEST_F(RCPPosixTest, PtyRoundTrip) {
+    std::string peer;
+    targetFd = RCPPosix::openPty(peer);
+    ASSERT_GE(targetFd, 0);
+    // openPty() made the line discipline raw, so bytes like CR and ^C pass through untouched
+    hostFd = open(peer.c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_GE(hostFd, 0);
+    start(false);
+
+    hostSend({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x0D, RCP_SIMPLE_ACTUATOR_ON});
+    hostSend({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x03, RCP_SIMPLE_ACTUATOR_ON});
+    ASSERT_TRUE(receive(16, true));
+    EXPECT_EQ(actuators[0x0D], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(actuators[0x03], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(received[6], 0x0D);
+    EXPECT_EQ(received[14], 0x03);
+}
+
+TEST_F(RCPPosixTest, Tty) {
+    std::string peer;
+    targetFd = RCPPosix::openPty(peer);
+    ASSERT_GE(targetFd, 0);
+    EXPECT_EQ(RCPPosix::openTty(peer.c_str(), 12345), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // A pty peer is a tty, so it stands in for a serial port
+    hostFd = RCPPosix::openTty(peer.c_str(), 115200);
+    ASSERT_GE(hostFd, 0);
+    start(true);
+
+    hostSend({0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY});
+    ASSERT_TRUE(receive(7, true));
+    EXPECT_EQ(received[1], RCP_DEVCLASS_TEST_STATE);
+}
+
+TEST_F(RCPPosixTest, UnixSocket) {
+    std::string path = testing::TempDir() + "rcpt_posix_" + std::to_string(getpid());
+    unlink(path.c_str());
+
+    std::thread host([&] {
+        while(hostFd < 0) {
+            hostFd = RCPPosix::connectUnix(path.c_str());
+            if(hostFd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    targetFd = RCPPosix::acceptUnix(path.c_str());
+    host.join();
+    ASSERT_GE(targetFd, 0);
+    fcntl(hostFd, F_SETFL, fcntl(hostFd, F_GETFL) & ~O_NONBLOCK);
+    start(true);
+
+    hostSend({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x07, RCP_SIMPLE_ACTUATOR_ON});
+    EXPECT_TRUE(RCPPosix::wait(1000));
+    ASSERT_TRUE(receive(8, true));
+    EXPECT_EQ(actuators[0x07], RCP_SIMPLE_ACTUATOR_ON);
+}
+
+TEST_F(RCPPosixTest, BatchedWrites) {
+    socketPair();
+    start(false);
+    RCPPosix::Stats before = RCPPosix::getStats();
+
+    for(int i = 0; i < 20; i++) RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, i, 1.0f);
+    EXPECT_EQ(RCPPosix::getStats().writes, before.writes);
+
+    // The next yield() sends all of them at once
+    RCP::yield();
+    RCPPosix::Stats after = RCPPosix::getStats();
+    EXPECT_EQ(after.writes, before.writes + 1);
+    EXPECT_EQ(after.txBytes, before.txBytes + 20 * 11);
+    ASSERT_TRUE(receive(20 * 11));
+}
+
+TEST_F(RCPPosixTest, DropsOnClosedLink) {
+    socketPair();
+    start(false);
+    close(hostFd);
+    hostFd = -1;
+
+    RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+    RCPPosix::flush();
+    EXPECT_EQ(RCPPosix::getStats().txDropped, 11u);
+}
+
+// Streams telemetry faster than the link drains it, so write() has to wait for the I/O thread
+TEST_F(RCPPosixTest, Throughput) {
+    std::string peer;
+    targetFd = RCPPosix::openPty(peer);
+    ASSERT_GE(targetFd, 0);
+    hostFd = open(peer.c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_GE(hostFd, 0);
+    start(true);
+
+    constexpr size_t PACKETS = 50000;
+    std::atomic<size_t> hostBytes{0};
+    std::thread host([&] {
+        // The peer is raw with VMIN 0, so read() returns 0 rather than blocking when nothing has arrived yet
+        uint8_t chunk[65536];
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+        while(hostBytes < PACKETS * 11 && Clock::now() < deadline) {
+            pollfd pfd = {hostFd, POLLIN, 0};
+            if(poll(&pfd, 1, 100) <= 0) continue;
+            ssize_t len = ::read(hostFd, chunk, sizeof(chunk));
+            if(len > 0) hostBytes += len;
+            else if(len < 0 && errno != EAGAIN && errno != EINTR) break;
+        }
+    });
+
+    for(size_t i = 0; i < PACKETS; i++) RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, i, 1.0f);
+    RCPPosix::flush();
+    host.join();
+
+    RCPPosix::Stats stats = RCPPosix::getStats();
+    EXPECT_EQ(hostBytes, PACKETS * 11);
+    EXPECT_EQ(stats.txDropped, 0u);
+    EXPECT_LT(stats.writes, PACKETS);
+}
+
+// A peer that stops reading makes write() drop output after txTimeoutMs instead of blocking forever
+TEST_F(RCPPosixTest, StalledLink) {
+    socketPair();
+    RCPPosix::Options options;
+    options.ioThread = true;
+    options.txBufferSize = 1024;
+    options.txTimeoutMs = 50;
+    ASSERT_TRUE(RCPPosix::start(targetFd, options));
+    RCP::init();
+
+    for(int i = 0; i < 100000; i++) RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+    RCPPosix::flush();
+
+    RCPPosix::Stats stats = RCPPosix::getStats();
+    EXPECT_GT(stats.txStalls, 0u);
+    EXPECT_GT(stats.txDropped, 0u);
+    EXPECT_EQ(stats.txBytes + stats.txDropped, 100000u * 11);
+}
+
+// Command to echo round trips with the target loop on its own thread
+TEST_F(RCPPosixTest, Latency) {
+    socketPair();
+    start(false);
+    fcntl(hostFd, F_SETFL, fcntl(hostFd, F_GETFL) | O_NONBLOCK);
+
+    std::atomic<bool> running{true};
+    std::thread target([&] {
+        while(running) {
+            RCPPosix::wait(1);
+            RCP::yield();
+        }
+    });
+
+    std::vector<double> latencies;
+    for(int i = 0; i < 500; i++) {
+        received.clear();
+        Clock::time_point sent = Clock::now();
+        hostSend({0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x01,
+                  static_cast<uint8_t>(i % 2 ? RCP_SIMPLE_ACTUATOR_OFF : RCP_SIMPLE_ACTUATOR_ON)});
+        // The echo is written at the start of the following loop, which wait() does right away
+        if(!receive(8)) break;
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+    }
+
+    running = false;
+    target.join();
+    ASSERT_EQ(latencies.size(), 500u);
+
+    std::sort(latencies.begin(), latencies.end());
+    // Far below anything a sleep or timeout in the path would cause
+    EXPECT_LT(latencies[250], 10000);
+}
+
+TEST_F(RCPPosixTest, SharedMemoryRoundTrip) {
+    startShm();
+
+    const uint8_t pkt[] = {0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON};
+    ASSERT_EQ(hostLink.send(pkt, sizeof(pkt)), sizeof(pkt));
+    EXPECT_TRUE(RCPPosix::wait(1000));
+    ASSERT_TRUE(receiveShm(8, true));
+    EXPECT_EQ(actuators[0x05], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(received[6], 0x05);
+
+    RCPPosix::Stats stats = RCPPosix::getStats();
+    EXPECT_EQ(stats.reads + stats.writes, 0u);
+}
+
+TEST_F(RCPPosixTest, SharedMemoryNamed) {
+    std::string name = "/rcpt_shm_" + std::to_string(getpid());
+    ASSERT_TRUE(targetLink.create(name.c_str(), 1024));
+    ASSERT_TRUE(hostLink.open(name.c_str()));
+    // The name is taken until the creator closes the link
+    RCPShm::Link other;
+    EXPECT_FALSE(other.create(name.c_str()));
+
+    EXPECT_EQ(targetLink.send("RCP", 3), 3u);
+    char buf[4] = {};
+    EXPECT_EQ(hostLink.receive(buf, sizeof(buf)), 3u);
+    EXPECT_STREQ(buf, "RCP");
+
+    targetLink.close();
+    EXPECT_TRUE(hostLink.peerClosed());
+    EXPECT_TRUE(other.create(name.c_str()));
+}
+
+// A host that keeps up never makes either side sleep, so nothing makes a system call
+TEST_F(RCPPosixTest, SharedMemoryNoSystemCalls) {
+    startShm();
+    for(int i = 0; i < 10000; i++) {
+        RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+        uint8_t pkt[11];
+        ASSERT_EQ(hostLink.receive(pkt, sizeof(pkt)), sizeof(pkt));
+    }
+
+    RCPShm::Stats target = targetLink.getStats();
+    RCPShm::Stats host = hostLink.getStats();
+    EXPECT_EQ(target.sent, 7u + 10000 * 11);
+    EXPECT_EQ(target.sleeps + target.wakeups + host.sleeps + host.wakeups, 0u);
+}
+
+TEST_F(RCPPosixTest, SharedMemoryWakesSleepingHost) {
+    startShm();
+
+    RCPShm::Stats host = hostLink.getStats();
+    RCPShm::Stats target = targetLink.getStats();
+
+    // The host waits long enough to still be asleep when the packet is sent once it counts the sleep
+    bool readable = false;
+    std::thread waiter([&] { readable = hostLink.waitReadable(5000); });
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while(hostLink.getStats().sleeps == host.sleeps && Clock::now() < deadline) std::this_thread::yield();
+    RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+    waiter.join();
+
+    EXPECT_TRUE(readable);
+    EXPECT_TRUE(receiveShm(11));
+    EXPECT_GT(hostLink.getStats().sleeps, host.sleeps);
+    EXPECT_GT(targetLink.getStats().wakeups, target.wakeups);
+}
+
+// Streams through a small ring while the host drains it on another thread
+TEST_F(RCPPosixTest, SharedMemoryThroughput) {
+    startShm(1024);
+
+    constexpr size_t PACKETS = 100000;
+    std::thread host([&] { receiveShm(PACKETS * 11); });
+    for(size_t i = 0; i < PACKETS; i++) RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, i, 1.0f);
+    RCPPosix::flush();
+    host.join();
+
+    EXPECT_EQ(received.size(), PACKETS * 11);
+    EXPECT_EQ(RCPPosix::getStats().txDropped, 0u);
+    // In order, nothing lost or torn
+    for(size_t i = 0; i < PACKETS; i++) ASSERT_EQ(received[i * 11 + 6], static_cast<uint8_t>(i));
+}
+
+// Packets that do not fit are dropped whole once the host stops reading, so the stream stays parseable
+TEST_F(RCPPosixTest, SharedMemoryStalledHost) {
+    startShm(1024, 20);
+    RCPPosix::Stats before = RCPPosix::getStats();
+
+    for(int i = 0; i < 1000; i++) RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+    RCPPosix::Stats stats = RCPPosix::getStats();
+    EXPECT_EQ(stats.txBytes - before.txBytes + stats.txDropped, 1000u * 11);
+    EXPECT_EQ((stats.txBytes - before.txBytes) % 11, 0u);
+    EXPECT_GT(stats.txDropped, 0u);
+
+    hostLink.close();
+    EXPECT_TRUE(targetLink.peerClosed());
+    RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 1.0f);
+    EXPECT_EQ(RCPPosix::getStats().txDropped, stats.txDropped + 11);
+}
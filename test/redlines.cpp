@@ -0,0 +1,180 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/diagnostics.h"
+#include "RCP_Target/redlines.h"
+
+class RCPRedlines : public RCPSensors {
+protected:
+    RCPRedlines() { RCP::clearRedlineLog(); }
+
+    ~RCPRedlines() override { RCP::setRedlines(nullptr, 0); }
+};
+
+class RCPRedlineActions : public RCPSimpleActuators {
+protected:
+    RCPRedlineActions() { RCP::clearRedlineLog(); }
+
+    ~RCPRedlineActions() override { RCP::setRedlines(nullptr, 0); }
+};
+
+TEST_F(RCPRedlines, Persistence) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2, 1, RCP_REDLINE_ABOVE, 800, 50, 3, RCP_REDLINE_ESTOP},
+    };
+    RCP::setRedlines(redlines, 1);
+
+    // Other sensors and channels are not checked against the rule
+    SENSE[0] = 1000;
+    for(int i = 0; i < 5; i++) RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    for(int i = 0; i < 5; i++) RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 2);
+    SENSE[1] = 1000;
+    for(int i = 0; i < 5; i++) RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 1);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    // A sample back under the threshold restarts the count
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    SENSE[1] = 700;
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    SENSE[1] = 1000;
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    SYSTIME = 0x1234;
+    OUT.clear();
+    RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x12, 0x34, 0x70);
+    CHECK_OUTBUF(0x0C, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_REDLINE_TRIP, 0x00, 0x00, 0x00,
+                 0x00, 0x12, 0x34, 0x00, 0x00, 0x7A, 0x44);
+}
+
+static bool estopRan;
+
+TEST_F(RCPRedlines, TripInsideProcedure) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2, 1, RCP_REDLINE_ABOVE, 800, 50, 1, RCP_REDLINE_ESTOP},
+    };
+    RCP::setRedlines(redlines, 1);
+
+    // Waits for the tank to pressurize, sampling it through the redlines like a bytecode sensor wait does
+    ::Test::BoolWaiter pressurize([] { return RCP::sampleSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 2).vals[1] > 700; });
+    ::Test::OneShot estop([] { estopRan = true; });
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &pressurize;
+    RCP::ESTOP_PROC = &estop;
+    estopRan = false;
+
+    SENSE[1] = 500;
+    RCP::startProcedure(1);
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_RUNNING);
+
+    // Overshooting trips the redline on the same sample that finishes the wait. The ESTOP wins.
+    SENSE[1] = 1000;
+    RCP::runTest();
+    EXPECT_EQ(RCP::getRedlineTripCount(), 1u);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_TRUE(estopRan);
+    EXPECT_FALSE(RCP::isTestActive(1));
+
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    RCP::ESTOP_PROC = nullptr;
+    ::Test::getTests().tests[1] = previous;
+}
+
+TEST_F(RCPRedlines, Hysteresis) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_TEMPERATURE, 0, 0, RCP_REDLINE_BELOW, 10, 5, 1, RCP_REDLINE_START_PROCEDURE, 4},
+    };
+    RCP::setRedlines(redlines, 1);
+
+    SENSE[0] = 5;
+    RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 0);
+    EXPECT_EQ(RCP::getRedlineTripCount(), 1u);
+    EXPECT_TRUE(RCP::isTestActive(4));
+    RCP::stopProcedure(4);
+
+    // Still tripped until the value has recovered past 15
+    SENSE[0] = 12;
+    RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 0);
+    SENSE[0] = 5;
+    RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 0);
+    EXPECT_EQ(RCP::getRedlineTripCount(), 1u);
+
+    SENSE[0] = 16;
+    RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 0);
+    SYSTIME = 50;
+    SENSE[0] = 5;
+    RCP::sampleSensor(RCP_DEVCLASS_TEMPERATURE, 0);
+    EXPECT_EQ(RCP::getRedlineTripCount(), 2u);
+
+    RCP::RedlineTrip trip{};
+    ASSERT_TRUE(RCP::getRedlineTrip(0, trip));
+    EXPECT_EQ(trip.time, 50u);
+    EXPECT_EQ(trip.rule, 0);
+    EXPECT_EQ(trip.value, 5);
+    EXPECT_FALSE(RCP::getRedlineTrip(2, trip));
+    RCP::stopProcedure(4);
+}
+
+TEST_F(RCPRedlines, ReadPacket) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, 0, RCP_REDLINE_ABOVE, 1, 0, 1, RCP_REDLINE_ESTOP},
+    };
+    RCP::setRedlines(redlines, 1);
+
+    // Sensor reads requested by the host are sampled through the redlines too
+    SENSE[0] = PI;
+    PUSH(0x01, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00);
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+}
+
+TEST_F(RCPRedlineActions, ActuatorAction) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_BOOL_SENSOR, 3, 0, RCP_REDLINE_ABOVE, 0.5f, 0, 1, RCP_REDLINE_SIMPLE_ACTUATOR, 7,
+         RCP_SIMPLE_ACTUATOR_ON},
+    };
+    RCP::setRedlines(redlines, 1);
+
+    float closed = 0;
+    float open = 1;
+    RCP::evaluateRedlines(RCP_DEVCLASS_BOOL_SENSOR, 3, &closed, 1);
+    EXPECT_EQ(ACTS[7], RCP_SIMPLE_ACTUATOR_OFF);
+    RCP::evaluateRedlines(RCP_DEVCLASS_BOOL_SENSOR, 3, &open, 1);
+    EXPECT_EQ(ACTS[7], RCP_SIMPLE_ACTUATOR_ON);
+}
+
+TEST_F(RCPRedlines, TripLog) {
+    RCP::Redline redlines[] = {
+        {RCP_DEVCLASS_LOAD_CELL, 0, 0, RCP_REDLINE_ABOVE, 100, 0, 1, RCP_REDLINE_SIMPLE_ACTUATOR, 0},
+    };
+    RCP::setRedlines(redlines, 1);
+    redlines[0].action = static_cast<RCP_RedlineAction>(0xFF);
+
+    for(uint32_t i = 0; i < RCP::REDLINE_LOG_SIZE + 4; i++) {
+        float high = 200 + i;
+        float low = 0;
+        SYSTIME = i;
+        RCP::evaluateRedlines(RCP_DEVCLASS_LOAD_CELL, 0, &high, 1);
+        RCP::evaluateRedlines(RCP_DEVCLASS_LOAD_CELL, 0, &low, 1);
+    }
+
+    // Only the newest trips are kept
+    RCP::RedlineTrip trip{};
+    ASSERT_TRUE(RCP::getRedlineTrip(RCP::REDLINE_LOG_SIZE - 1, trip));
+    EXPECT_EQ(trip.time, 4u);
+    EXPECT_FALSE(RCP::getRedlineTrip(RCP::REDLINE_LOG_SIZE, trip));
+    EXPECT_EQ(RCP::getRedlineTripCount(), RCP::REDLINE_LOG_SIZE + 4u);
+
+    OUT.clear();
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_REDLINE_TRIP};
+    EXPECT_TRUE(RCP::handleDiagnostics(request, sizeof(request)));
+    CHECK_OUTBUF(0x3E, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_REDLINE_TRIP, 0x00, 0x00, 0x00,
+                 0x00, 0x00, 0x04);
+}
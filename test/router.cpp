@@ -0,0 +1,174 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/router.h"
+#include "RCP_Target/stats.h"
+#include "RCP_Target/transports.h"
+
+#if RCPT_ROUTER
+
+// The link to the next target down the chain, and a second upstream link
+static LRI::RingBuf<uint8_t, 65> downIn;
+static LRI::RingBuf<uint8_t, 65> downOut;
+static LRI::RingBuf<uint8_t, 65> radioIn;
+
+static void downWrite(const void* data, uint8_t length) {
+    for(uint8_t i = 0; i < length; i++) downOut.push(static_cast<const uint8_t*>(data)[i]);
+}
+
+static uint8_t downAvailable() { return downIn.size(); }
+
+static uint8_t downRead() {
+    uint8_t val = 0;
+    downIn.pop(val);
+    return val;
+}
+
+static void radioWrite([[maybe_unused]] const void* data, [[maybe_unused]] uint8_t length) {}
+
+static uint8_t radioAvailable() { return radioIn.size(); }
+
+static uint8_t radioRead() {
+    uint8_t val = 0;
+    radioIn.pop(val);
+    return val;
+}
+
+#define DOWN_PUSH(...)                                                                                                 \
+    do {                                                                                                               \
+        uint8_t vals[] = {__VA_ARGS__};                                                                                \
+        for(size_t i = 0; i < sizeof(vals); i++) downIn.push(vals[i]);                                                 \
+    }                                                                                                                  \
+    while(0)
+
+#define CHECK_DOWNOUT(...)                                                                                             \
+    do {                                                                                                               \
+        uint8_t vals[] = {__VA_ARGS__};                                                                                \
+        ASSERT_EQ(downOut.size(), sizeof(vals));                                                                       \
+        for(size_t i = 0; i < sizeof(vals); i++) {                                                                     \
+            uint8_t val = 0;                                                                                           \
+            downOut.pop(val);                                                                                          \
+            EXPECT_EQ(val, vals[i]) << "Incorrect value at index " << i;                                               \
+        }                                                                                                              \
+    }                                                                                                                  \
+    while(0)
+
+class RCPRouter : public RCPSimpleActuators {
+protected:
+    uint8_t down;
+
+    RCPRouter() {
+        downIn.clear();
+        downOut.clear();
+        radioIn.clear();
+        down = RCP::addTransport({downWrite, downAvailable, downRead});
+        RCP::setDownstream(down);
+    }
+
+    ~RCPRouter() override {
+        RCP::setFraming(RCP_FRAMING_RAW, down);
+        RCP::removeTransports();
+    }
+};
+
+TEST_F(RCPRouter, ForwardsOtherChannels) {
+    EXPECT_EQ(RCP::getDownstream(), down);
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    CHECK_DOWNOUT(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_TRUE(OUT.isEmpty());
+    EXPECT_EQ(RCP::getRouterStats().downBytes[1], 4u);
+    EXPECT_EQ(RCP::getRouterStats().downBytes[0], 0u);
+}
+
+TEST_F(RCPRouter, OwnChannel) {
+    PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+    CHECK_OUTBUF(0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    // Only forwarded packets go down
+    EXPECT_TRUE(downOut.isEmpty());
+    EXPECT_EQ(RCP::getTransportStats(down).txPackets, 0u);
+}
+
+TEST_F(RCPRouter, CutThrough) {
+    PUSH(RCP_CH_TWO | 0x06, RCP_DEVCLASS_STEPPER, 0x01);
+    RCP::yield();
+    // Passed on before the rest arrives
+    CHECK_DOWNOUT(RCP_CH_TWO | 0x06, RCP_DEVCLASS_STEPPER, 0x01);
+
+    PUSH(RCP_STEPPER_ABSOLUTE_POS_CONTROL, 0x00, 0x00, 0x48, 0x42);
+    PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    CHECK_DOWNOUT(RCP_STEPPER_ABSOLUTE_POS_CONTROL, 0x00, 0x00, 0x48, 0x42);
+    RCP::yield();
+    EXPECT_EQ(ACTS[4], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::getRouterStats().downBytes[2], 8u);
+}
+
+TEST_F(RCPRouter, MergesUpstream) {
+    DOWN_PUSH(RCP_CH_ONE | 0x09, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00, 0x00, 0x00, 0x01, 0x03, HFLOATARR(HPI));
+    RCP::yield();
+    CHECK_OUTBUF(RCP_CH_ONE | 0x09, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00, 0x00, 0x00, 0x01, 0x03, HFLOATARR(HPI));
+    // Not sent back down, nor handled here
+    EXPECT_TRUE(downOut.isEmpty());
+    EXPECT_EQ(RCP::getRouterStats().upBytes[1], 11u);
+}
+
+TEST_F(RCPRouter, Estop) {
+    PUSH(RCP_CH_THREE);
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    CHECK_DOWNOUT(RCP_CH_THREE);
+    EXPECT_EQ(RCP::getRouterStats().downBytes[3], 1u);
+}
+
+TEST_F(RCPRouter, AddedLinkWaits) {
+    RCP::addTransport({radioWrite, radioAvailable, radioRead});
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR);
+    RCP::yield();
+
+    // Whole packets from the radio wait for the link 0 packet to be through; there is room for one
+    for(uint8_t id = 0x05; id <= 0x06; id++) {
+        const uint8_t packet[] = {RCP_CH_TWO | 0x01, RCP_DEVCLASS_SIMPLE_ACTUATOR, id};
+        for(uint8_t byte : packet) radioIn.push(byte);
+    }
+    radioIn.push(uint8_t{0x00});
+    RCP::yield();
+    CHECK_DOWNOUT(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(RCP::getRouterStats().dropped, 1u);
+
+    PUSH(0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    CHECK_DOWNOUT(0x04, RCP_SIMPLE_ACTUATOR_ON, 0x00, RCP_CH_TWO | 0x01, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05);
+}
+
+TEST_F(RCPRouter, FramedDownstream) {
+    RCP::setFraming(RCP_FRAMING_COBS, down);
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR);
+    RCP::yield();
+    EXPECT_TRUE(downOut.isEmpty());
+
+    PUSH(0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    CHECK_DOWNOUT(0x05, RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON, 0x00);
+}
+
+TEST_F(RCPRouter, Stopped) {
+    RCP::setDownstream(0);
+    PUSH(RCP_CH_ONE | 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_TRUE(downOut.isEmpty());
+#if RCPT_STATS
+    EXPECT_EQ(RCP::getRuntimeStats().foreignChannel, 1u);
+#endif
+
+    // Nor is anything merged from it
+    DOWN_PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x04);
+    RCP::yield();
+    EXPECT_TRUE(OUT.isEmpty());
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/stats.h"
+
+constexpr uint8_t BASE = RCP::SERIAL_BYTES_PER_LOOP;
+// Enough yields to fill the receive buffer reading at least BASE bytes and parsing 3 per yield
+constexpr int FILL_YIELDS = RCP::RCP_SERIAL_BUFFER_SIZE / (BASE > 3 ? BASE - 3 : 1) + 10;
+
+// Tops up the input with foreign channel test queries, which are parsed without a reply
+static void fillInput() {
+    while(IN.size() + 3 <= 65) PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+}
+
+class RCPRxBudget : public RCPTest {
+protected:
+    RCPRxBudget() {
+        // Start the loop timing from here
+        RCP::yield();
+    }
+
+    ~RCPRxBudget() override { RCP::setAdaptiveRxBudget(0, 0, 0); }
+};
+
+TEST_F(RCPRxBudget, Fixed) {
+    fillInput();
+    RCP::yield();
+    EXPECT_EQ(RCP::getRxBudget(), BASE);
+    EXPECT_EQ(IN.size(), 63u - BASE);
+}
+
+TEST_F(RCPRxBudget, LoopTime) {
+    // BASE bytes per 1ms of loop time, up to three times that
+    RCP::setAdaptiveRxBudget(1, 3 * BASE, 1000);
+    SYSTIME++;
+    RCP::yield();
+    EXPECT_EQ(RCP::getRxBudget(), BASE);
+
+    // Slower loops read more, up to the maximum
+    for(int i = 0; i < 40; i++) {
+        SYSTIME += 2;
+        RCP::yield();
+    }
+    EXPECT_GE(RCP::getRxBudget(), 2 * BASE - 2);
+    EXPECT_LE(RCP::getRxBudget(), 2 * BASE);
+
+    for(int i = 0; i < 40; i++) {
+        SYSTIME += 10;
+        RCP::yield();
+    }
+    EXPECT_EQ(RCP::getRxBudget(), 3 * BASE);
+
+    // Back to back calls read the minimum
+    for(int i = 0; i < 40; i++) RCP::yield();
+    EXPECT_EQ(RCP::getRxBudget(), 1u);
+    EXPECT_LT(RCP::getLoopMicros(), 1000u);
+}
+
+TEST_F(RCPRxBudget, KeepsUp) {
+    // Parsing as many bytes as are read, the buffer does not fill up however long the input keeps coming
+    RCP::setAdaptiveRxBudget(BASE, 3 * BASE, 1000);
+    for(int i = 0; i < FILL_YIELDS; i++) {
+        fillInput();
+        SYSTIME += 10;
+        RCP::yield();
+        EXPECT_LT(RCP::rxBuffered(), 3u * BASE);
+    }
+
+    EXPECT_EQ(RCP::getRxBudget(), 3 * BASE);
+#if RCPT_STATS
+    EXPECT_EQ(RCP::getRuntimeStats().rxDropped, 0u);
+    // Up to the budget in 3 byte packets per yield(), once it has grown. One packet per yield() was the old limit.
+    EXPECT_GE(RCP::getRuntimeStats().rxPackets, static_cast<uint32_t>(FILL_YIELDS * BASE / 2));
+#endif
+}
+
+TEST_F(RCPRxBudget, DrainsBacklog) {
+    // A fixed budget that parses one 3 byte packet per yield() builds up a backlog. Only as much is sent as fits, so
+    // nothing is dropped.
+    for(int i = 0; i < FILL_YIELDS; i++) {
+        while(IN.size() + 3 <= 65 && RCP::rxBuffered() + IN.size() + 3 <= RCP::RCP_SERIAL_BUFFER_SIZE) {
+            PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+        }
+        RCP::yield();
+    }
+    ASSERT_GE(RCP::rxBuffered(), RCP::RCP_SERIAL_BUFFER_SIZE / 2);
+
+    // Once the input slows down, parsing by the budget empties it in a few yields rather than one per packet. Reads
+    // stay capped to the space left meanwhile.
+    RCP::setAdaptiveRxBudget(BASE, 3 * BASE, 1000);
+    for(int i = 0; i < (RCP::RCP_SERIAL_BUFFER_SIZE + 65) / (3 * BASE) + 6; i++) {
+        SYSTIME += 10;
+        RCP::yield();
+        EXPECT_LE(RCP::rxBuffered(), RCP::RCP_SERIAL_BUFFER_SIZE);
+    }
+
+    EXPECT_TRUE(IN.isEmpty());
+    EXPECT_EQ(RCP::rxBuffered(), 0u);
+#if RCPT_STATS
+    EXPECT_EQ(RCP::getRuntimeStats().rxDropped, 0u);
+#endif
+}
+
+TEST_F(RCPRxBudget, FillRaisesParsing) {
+    // Build up a backlog with the fixed budget, then stop the input
+    for(int i = 0; i < FILL_YIELDS; i++) {
+        while(IN.size() + 3 <= 65 && RCP::rxBuffered() + IN.size() + 3 <= RCP::RCP_SERIAL_BUFFER_SIZE) {
+            PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+        }
+        RCP::yield();
+    }
+    IN.clear();
+    uint16_t buffered = RCP::rxBuffered();
+    ASSERT_GE(buffered, RCP::RCP_SERIAL_BUFFER_SIZE / 2);
+
+    // The loop time alone allows BASE bytes; the backlog raises that by its share of the buffer
+    RCP::setAdaptiveRxBudget(BASE, BASE, 1000);
+    SYSTIME += 1;
+    RCP::yield();
+    EXPECT_GE(buffered - RCP::rxBuffered(), BASE + BASE * buffered / RCP::RCP_SERIAL_BUFFER_SIZE);
+
+    // With little buffered, about the budget is parsed
+    while(RCP::rxBuffered() > 2u * BASE) {
+        SYSTIME += 1;
+        RCP::yield();
+    }
+    buffered = RCP::rxBuffered();
+    SYSTIME += 1;
+    RCP::yield();
+    EXPECT_LT(buffered - RCP::rxBuffered(), BASE + 3 + BASE / 2);
+}
+
+TEST_F(RCPRxBudget, FixedOverflows) {
+    for(int i = 0; i < FILL_YIELDS; i++) {
+        fillInput();
+        RCP::yield();
+    }
+
+    EXPECT_EQ(RCP::rxBuffered(), RCP::RCP_SERIAL_BUFFER_SIZE - 3);
+#if RCPT_STATS
+    EXPECT_GT(RCP::getRuntimeStats().rxDropped, 0u);
+    EXPECT_EQ(RCP::getRuntimeStats().rxHighWater, static_cast<uint32_t>(RCP::RCP_SERIAL_BUFFER_SIZE));
+#endif
+}
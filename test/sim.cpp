@@ -0,0 +1,146 @@
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+#include "RCP_Host/sim.h"
+#include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/procedures.h"
+
+namespace Test {
+    Tests& getTests() {
+        static Tests tests = {};
+        return tests;
+    }
+} // namespace Test
+
+static void open0() { RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_ON); }
+static void close0() { RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_OFF); }
+static bool isOpen0() { return RCP::readSimpleActuator(0) == RCP_SIMPLE_ACTUATOR_ON; }
+static void moveStepper() { RCP::writeStepper(1, RCP_STEPPER_ABSOLUTE_POS_CONTROL, 100); }
+static bool stepperArrived() { return RCP::readStepper(1).vals[0] == 100; }
+
+static bool accepted = false;
+static void accept(const RCP::PromptData& data) { accepted = data.boolData; }
+static void prompt() { RCP::setPrompt("Arm igniter?", RCP_PromptDataType_GONOGO, &accept); }
+static bool isAccepted() { return accepted; }
+
+class RCPSimulation : public testing::Test {
+protected:
+    ::Test::Procedure* proc = nullptr;
+
+    ~RCPSimulation() override {
+        ::Test::getTests().tests[0] = nullptr;
+        delete proc;
+    }
+
+    void install(::Test::Procedure* procedure) {
+        delete proc;
+        proc = procedure;
+        ::Test::getTests().tests[0] = proc;
+    }
+
+    // Time of the nth timeline entry containing text
+    static uint32_t timeOf(const RCPSim::Simulator& sim, const std::string& text, int nth = 0) {
+        for(const auto& event : sim.getTimeline()) {
+            if(event.text.find(text) != std::string::npos && nth-- == 0) return event.time;
+        }
+        return RCPSim::NO_EVENT;
+    }
+};
+
+TEST_F(RCPSimulation, LongSequence) {
+    RCPSim::Simulator sim;
+    install(new ::Test::SequentialProcedure(new ::Test::OneShot(&open0), new ::Test::WaitProcedure(600000),
+                                            new ::Test::OneShot(&close0)));
+
+    auto start = std::chrono::steady_clock::now();
+    RCPSim::Result result = sim.runTest(0, 700000);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_TRUE(result.finished);
+    EXPECT_EQ(result.finalState, RCP_TEST_STOPPED);
+    EXPECT_LT(result.steps, 20u);
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+
+    uint32_t opened = timeOf(sim, "simple actuator 0 ON");
+    uint32_t closed = timeOf(sim, "simple actuator 0 OFF");
+    EXPECT_GE(closed - opened, 600000u);
+    EXPECT_LE(closed - opened, 600002u);
+    sim.printTimeline();
+}
+
+TEST_F(RCPSimulation, Variants) {
+    RCPSim::Simulator sim;
+    auto start = std::chrono::steady_clock::now();
+
+    for(uint32_t variant = 0; variant < 500; variant++) {
+        uint32_t wait = 1000 + variant * 1000;
+        install(new ::Test::SequentialProcedure(new ::Test::OneShot(&open0), new ::Test::WaitProcedure(wait),
+                                                new ::Test::OneShot(&close0), new ::Test::WaitProcedure(wait / 2),
+                                                new ::Test::OneShot(&open0), new ::Test::WaitProcedure(10),
+                                                new ::Test::OneShot(&close0)));
+        sim.reset();
+        RCPSim::Result result = sim.runTest(0, 2 * wait + 1000);
+        ASSERT_TRUE(result.finished) << "variant " << variant;
+
+        uint32_t firstClose = timeOf(sim, "simple actuator 0 OFF");
+        uint32_t secondOpen = timeOf(sim, "simple actuator 0 ON", 1);
+        EXPECT_GT(firstClose - timeOf(sim, "simple actuator 0 ON"), wait);
+        EXPECT_GT(secondOpen - firstClose, wait / 2);
+    }
+
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST_F(RCPSimulation, ActuatorTravel) {
+    RCPSim::SimpleActuatorPlant valves(50);
+    RCPSim::Simulator sim({&valves});
+    install(new ::Test::SequentialProcedure(new ::Test::OneShot(&open0), new ::Test::BoolWaiter(&isOpen0),
+                                            new ::Test::OneShot(&close0)));
+
+    RCPSim::Result result = sim.runTest(0, 1000);
+    EXPECT_TRUE(result.finished);
+    uint32_t travel = timeOf(sim, "simple actuator 0 OFF") - timeOf(sim, "simple actuator 0 ON");
+    EXPECT_GE(travel, 50u);
+    EXPECT_LE(travel, 52u);
+}
+
+TEST_F(RCPSimulation, StepperMotion) {
+    RCPSim::StepperPlant steppers(200);
+    RCPSim::Plants plants;
+    plants.steppers = &steppers;
+    RCPSim::Simulator sim(plants);
+    install(new ::Test::SequentialProcedure(new ::Test::OneShot(&moveStepper), new ::Test::BoolWaiter(&stepperArrived),
+                                            new ::Test::OneShot(&close0)));
+
+    RCPSim::Result result = sim.runTest(0, 5000);
+    EXPECT_TRUE(result.finished);
+    uint32_t motion = timeOf(sim, "simple actuator 0 OFF") - timeOf(sim, "stepper 1");
+    EXPECT_GE(motion, 500u);
+    EXPECT_LE(motion, 502u);
+}
+
+TEST_F(RCPSimulation, AutoPrompt) {
+    RCPSim::Simulator sim;
+    accepted = false;
+    RCP::PromptData go{};
+    go.boolData = true;
+    sim.setAutoPrompt(go, 3000);
+    install(new ::Test::SequentialProcedure(new ::Test::OneShot(&prompt), new ::Test::BoolWaiter(&isAccepted),
+                                            new ::Test::OneShot(&open0)));
+
+    RCPSim::Result result = sim.runTest(0, 10000);
+    EXPECT_TRUE(result.finished);
+    EXPECT_TRUE(accepted);
+    EXPECT_GE(timeOf(sim, "simple actuator 0 ON") - timeOf(sim, "prompt: Arm igniter?"), 3000u);
+}
+
+TEST_F(RCPSimulation, Timeout) {
+    RCPSim::Simulator sim;
+    install(new ::Test::BoolWaiter(&isAccepted));
+    accepted = false;
+
+    RCPSim::Result result = sim.runTest(0, 1000);
+    EXPECT_FALSE(result.finished);
+    EXPECT_EQ(result.finalState, RCP_TEST_RUNNING);
+}
@@ -0,0 +1,140 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/diagnostics.h"
+#include "RCP_Target/stats.h"
+
+#if RCPT_STATS
+
+#define U32(value) (uint8_t) ((value) >> 24), (uint8_t) ((value) >> 16), (uint8_t) ((value) >> 8), (uint8_t) (value)
+
+// Takes two ms of systime every tick
+class SlowProcedure : public ::Test::Procedure {
+public:
+    void execute() override { SYSTIME += 2; }
+    bool isFinished() override { return false; }
+};
+
+class RCPStats : public RCPTest {
+protected:
+    RCPStats() {
+        // The ready state sent by RCPTest
+        EXPECT_EQ(RCP::getRuntimeStats().txPackets, 1u);
+        EXPECT_EQ(RCP::getRuntimeStats().txBytes, 7u);
+        RCP::resetRuntimeStats();
+    }
+
+    ~RCPStats() override { RCP::setRuntimeStatsInterval(0); }
+};
+
+TEST_F(RCPStats, Counters) {
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    RCP::yield();
+    EXPECT_EQ(OUT.size(), 7u);
+    OUT.clear();
+
+    PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    RCP::yield();
+    PUSH(0x01, 0x70, 0x00);
+    RCP::yield();
+    EXPECT_TRUE(OUT.isEmpty());
+
+    const RCP::RuntimeStats& stats = RCP::getRuntimeStats();
+    EXPECT_EQ(stats.rxBytes, 9u);
+    EXPECT_EQ(stats.rxPackets, 3u);
+    EXPECT_EQ(stats.rxDropped, 0u);
+    EXPECT_EQ(stats.foreignChannel, 1u);
+    EXPECT_EQ(stats.unknownClass, 1u);
+    EXPECT_EQ(stats.txPackets, 1u);
+    EXPECT_EQ(stats.txBytes, 7u);
+    EXPECT_EQ(stats.yield.count, 3u);
+}
+
+TEST_F(RCPStats, Overflow) {
+    // Each yield() reads 20 bytes but parses only one 3 byte packet, so the receive buffer eventually fills
+    for(int i = 0; i < 20; i++) {
+        for(int j = 0; j < 7; j++) PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+        RCP::yield();
+        IN.clear();
+    }
+
+    EXPECT_EQ(RCP::getRuntimeStats().rxBytes, 400u);
+    EXPECT_GT(RCP::getRuntimeStats().rxDropped, 0u);
+    EXPECT_LT(RCP::getRuntimeStats().rxDropped, 400u - RCP::RCP_SERIAL_BUFFER_SIZE);
+}
+
+TEST_F(RCPStats, Durations) {
+    SlowProcedure slow;
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &slow;
+    RCP::startProcedure(1);
+    OUT.clear();
+
+    RCP::runTest();
+    RCP::runTest();
+    RCP::runTest();
+
+    const RCP::DurationStats& runTest = RCP::getRuntimeStats().runTest;
+    EXPECT_EQ(runTest.count, 3u);
+    EXPECT_EQ(runTest.max, 2000u);
+    EXPECT_EQ(runTest.mean(), 2000u);
+
+    RCP::stopProcedure(1);
+    ::Test::getTests().tests[1] = previous;
+}
+
+TEST_F(RCPStats, Report) {
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    RCP::yield();
+    OUT.clear();
+
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_STATS};
+    EXPECT_TRUE(RCP::handleDiagnostics(request, sizeof(request)));
+    CHECK_OUTBUF(0x3A, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_STATS, U32(3), U32(1), U32(0), U32(0),
+                 U32(0), U32(7), U32(1), U32(0), U32(0), U32(0), U32(0), U32(3), U32(RCP::SERIAL_BYTES_PER_LOOP),
+                 U32(0));
+
+    // The report itself was counted
+    EXPECT_EQ(RCP::getRuntimeStats().txPackets, 2u);
+    EXPECT_EQ(RCP::getRuntimeStats().txBytes, 7u + 60u);
+}
+
+TEST_F(RCPStats, Stream) {
+    SYSTIME = 100;
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_STATS, 0x00, 0x0A};
+    EXPECT_TRUE(RCP::handleDiagnostics(request, sizeof(request)));
+    EXPECT_EQ(RCP::getRuntimeStatsInterval(), 10u);
+    EXPECT_EQ(OUT.size(), 60u);
+    OUT.clear();
+
+    // One report every 10ms
+    for(int i = 0; i < 25; i++) {
+        SYSTIME++;
+        RCP::yield();
+        if(OUT.isEmpty()) continue;
+        EXPECT_TRUE(SYSTIME == 110 || SYSTIME == 120) << SYSTIME;
+        OUT.clear();
+    }
+
+    EXPECT_EQ(RCP::getRuntimeStats().txPackets, 3u);
+
+    const uint8_t stop[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_STATS, 0x00, 0x00};
+    RCP::handleDiagnostics(stop, sizeof(stop));
+    OUT.clear();
+    SYSTIME += 100;
+    RCP::yield();
+    EXPECT_TRUE(OUT.isEmpty());
+}
+
+TEST_F(RCPStats, Reset) {
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    RCP::yield();
+    OUT.clear();
+
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_RESET};
+    RCP::handleDiagnostics(request, sizeof(request));
+    EXPECT_EQ(RCP::getRuntimeStats().rxBytes, 0u);
+    EXPECT_EQ(RCP::getRuntimeStats().yield.count, 0u);
+}
+
+#endif
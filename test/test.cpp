@@ -2,6 +2,7 @@
 #include "gtest/gtest.h"
 
 #include "RCP_Target/RCP_Target.h"
+#include "RCP_Target/diagnostics.h"
 #include "RCP_Target/procedures.h"
 
 RCPRawTest* context;
@@ -132,6 +133,9 @@ TEST(RCPConstants, Constants) {
     EXPECT_EQ(RCP_DATA_STREAM_STOP, 0x20);
     EXPECT_EQ(RCP_DATA_STREAM_START, 0x21);
     EXPECT_EQ(RCP_TEST_QUERY, 0x30);
+    EXPECT_EQ(RCP_TEST_START_CONCURRENT, 0x40);
+    EXPECT_EQ(RCP_TEST_STOP_ONE, 0x50);
+    EXPECT_EQ(RCP_TEST_PAUSE_ONE, 0x60);
     EXPECT_EQ(RCP_HEARTBEATS_CONTROL, 0xF0);
 
     EXPECT_EQ(RCP_DATA_STREAM_MASK, 0x80);
@@ -282,6 +286,180 @@ TEST_F(RCPTest, TestPause) {
     CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
 }
 
+TEST_F(RCPTest, TestConcurrent) {
+    ::Test::WaitProcedure first(10);
+    ::Test::WaitProcedure second(20);
+    ::Test::Procedure* previous[2] = {::Test::getTests()[1], ::Test::getTests()[2]};
+    ::Test::getTests().tests[1] = &first;
+    ::Test::getTests().tests[2] = &second;
+
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x01);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x42);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x41);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
+    CHECK_OUTBUF(0x04, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TEST_SLOTS, 0x01, 0x02);
+
+    // Starting a test that is already running does nothing
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
+    CHECK_OUTBUF(0x04, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TEST_SLOTS, 0x01, 0x02);
+
+    // Pausing one test leaves the other running
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x61);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
+    CHECK_OUTBUF(0x04, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TEST_SLOTS, 0x41, 0x02);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x61);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x10);
+    CHECK_OUTBUF(0x04, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TEST_SLOTS, 0x01, 0x02);
+
+    for(int i = 0; i < 12; i++) RCP::runTest();
+    SYSTIME = 11;
+    RCP::runTest();
+    EXPECT_FALSE(RCP::isTestActive(1));
+    EXPECT_TRUE(RCP::isTestActive(2));
+    EXPECT_EQ(RCP::getTestNum(), 2);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_RUNNING);
+    EXPECT_EQ(RCP::getTestSlot(0).runs, 13u);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x0B, 0x10);
+
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x52);
+    RCP::yield();
+    EXPECT_FALSE(RCP::isTestActive(2));
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    ::Test::getTests().tests[1] = previous[0];
+    ::Test::getTests().tests[2] = previous[1];
+}
+
+TEST_F(RCPTest, TestConcurrentESTOP) {
+    ::Test::WaitProcedure first(10);
+    ::Test::WaitProcedure second(10);
+    ::Test::Procedure* previous[2] = {::Test::getTests()[1], ::Test::getTests()[2]};
+    ::Test::getTests().tests[1] = &first;
+    ::Test::getTests().tests[2] = &second;
+
+    EXPECT_TRUE(RCP::startProcedure(1));
+    EXPECT_TRUE(RCP::startProcedure(2));
+    EXPECT_FALSE(RCP::startProcedure(2));
+    RCP::runTest();
+
+    RCP::ESTOP();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x70);
+    EXPECT_FALSE(RCP::isTestActive(1));
+    EXPECT_FALSE(RCP::isTestActive(2));
+    EXPECT_FALSE(RCP::startProcedure(1));
+
+    ::Test::getTests().tests[1] = previous[0];
+    ::Test::getTests().tests[2] = previous[1];
+}
+
+TEST_F(RCPTest, FastESTOP) {
+    // An ESTOP queued behind other packets is acted on by the first yield() that reads it
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x30);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x30);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x30);
+    PUSH(0x00);
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x70);
+
+    // The queued packets are still handled, and the ESTOP header itself does not ESTOP again
+    for(int i = 0; i < 4; i++) RCP::yield();
+    EXPECT_EQ(OUT.size(), 3 * 7);
+    EXPECT_EQ(RCP::getEstopStats().detected, 1u);
+    EXPECT_EQ(RCP::getEstopStats().handled, 1u);
+}
+
+TEST_F(RCPTest, FastESTOPLatency) {
+    // Worst case without a receive ISR: the ESTOP is read SERIAL_BYTES_PER_LOOP bytes per yield()
+    for(int i = 0; i < 14; i++) PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x30);
+    PUSH(0x00);
+    int yields = 0;
+    while(RCP::getTestState() != RCP_TEST_ESTOP && yields < 10) {
+        RCP::yield();
+        yields++;
+    }
+
+    EXPECT_LE(yields, (14 * 3 + 1 + RCP::SERIAL_BYTES_PER_LOOP - 1) / RCP::SERIAL_BYTES_PER_LOOP);
+}
+
+TEST_F(RCPTest, FastESTOPScan) {
+    // Only the last zero is at a packet boundary, the first one is a test start payload
+    const uint8_t bytes[] = {0x01, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00};
+    RCP::scanRxBytes(bytes, sizeof(bytes));
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    SYSTIME = 2;
+
+    // runTest() acts on the latch without yield() ever running
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(RCP::getEstopStats().handled, 1u);
+    EXPECT_EQ(RCP::getEstopStats().maxLatencyMicros, 2000u);
+
+    // When the same bytes come out of read(), the ESTOP header does not ESTOP a second time
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00);
+    OUT.clear();
+    RCP::yield();
+    RCP::yield();
+    EXPECT_EQ(OUT.size(), 7);
+    EXPECT_EQ(RCP::getEstopStats().handled, 1u);
+}
+
+// Never finishes, and takes 1ms of SYSTIME per execute()
+class BusyProcedure : public ::Test::Procedure {
+    int& count;
+
+public:
+    explicit BusyProcedure(int& count) : count(count) {}
+
+    void execute() override {
+        count++;
+        SYSTIME++;
+    }
+
+    bool isFinished() override { return false; }
+};
+
+TEST_F(RCPTest, TestBudget) {
+    int counts[4] = {0};
+    ::Test::ParallelProcedure parallel(new BusyProcedure(counts[0]), new BusyProcedure(counts[1]),
+                                       new BusyProcedure(counts[2]), new BusyProcedure(counts[3]));
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &parallel;
+    RCP::startProcedure(1);
+
+    EXPECT_TRUE(RCP::runTest(1500));
+    EXPECT_EQ(counts[0], 1);
+    EXPECT_EQ(counts[1], 1);
+    EXPECT_EQ(counts[2], 0);
+
+    EXPECT_TRUE(RCP::runTest(1500));
+    EXPECT_EQ(counts[2], 1);
+    EXPECT_EQ(counts[3], 1);
+    EXPECT_EQ(RCP::getTestSlot(0).deferrals, 2u);
+
+    // A budget too small for even one child still makes progress
+    EXPECT_TRUE(RCP::runTest(1));
+    EXPECT_EQ(counts[0], 2);
+    EXPECT_EQ(counts[1], 1);
+
+    // Resumes at the second child, then wraps around
+    EXPECT_FALSE(RCP::runTest(10000));
+    EXPECT_EQ(counts[0], 3);
+    EXPECT_EQ(counts[1], 2);
+    EXPECT_EQ(counts[2], 2);
+    EXPECT_EQ(counts[3], 2);
+    EXPECT_EQ(RCP::getTestSlot(0).deferrals, 3u);
+
+    RCP::stopProcedure(1);
+    ::Test::getTests().tests[1] = previous;
+}
+
 TEST_F(RCPTest, SysReset) {
     PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0x12);
 
@@ -311,6 +489,81 @@ TEST_F(RCPTest, DataStreaming) {
 //     EXPECT_EXIT(RCP::yield(), testing::ExitedWithCode(8675309), "");
 // }
 
+TEST_F(RCPTest, HeartbeatTimeout) {
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0xF5);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x35);
+    EXPECT_EQ(RCP::getHeartbeatTimeout(), 5u);
+
+    PUSH(0x03, RCP_DEVCLASS_TEST_STATE, 0xF0, 0x01, 0xF4);
+    RCP::yield();
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x3F);
+    EXPECT_EQ(RCP::getHeartbeatTimeout(), 500u);
+}
+
+TEST_F(RCPTest, HeartbeatEcho) {
+    PUSH(0x03, RCP_DEVCLASS_TEST_STATE, 0xF0, 0x01, 0xF4);
+    RCP::yield();
+    OUT.clear();
+
+    RCP::setHeartbeatEcho(RCP_HEARTBEAT_ECHO_NEVER);
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0xFF);
+    RCP::yield();
+    EXPECT_EQ(OUT.size(), 0);
+
+    RCP::setHeartbeatEcho(RCP_HEARTBEAT_ECHO_RATE_LIMITED, 100);
+    for(int i = 0; i < 4; i++) {
+        PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0xFF);
+        RCP::yield();
+        SYSTIME += 40;
+    }
+
+    // Echoed at 0 and 120ms
+    EXPECT_EQ(OUT.size(), 2 * 7);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+}
+
+TEST_F(RCPSimpleActuators, HeartbeatWatchdog) {
+    static int actionCalls;
+    actionCalls = 0;
+    RCP::ESTOP_ISR_ACTION = [] { ACTS[0] = RCP_SIMPLE_ACTUATOR_OFF; };
+    RCP::ESTOP_ACTION = [] { actionCalls++; };
+    ACTS[0] = RCP_SIMPLE_ACTUATOR_ON;
+
+    PUSH(0x03, RCP_DEVCLASS_TEST_STATE, 0xF0, 0x00, 0xFA);
+    RCP::yield();
+    SYSTIME = 200;
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, 0xFF);
+    RCP::yield();
+    OUT.clear();
+
+    // The main loop is stuck, but a timer still calls checkHeartbeat()
+    SYSTIME = 450;
+    RCP::checkHeartbeat();
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_ON);
+    SYSTIME = 451;
+    RCP::checkHeartbeat();
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    // Nothing is sent and ESTOP_ACTION does not run from the interrupt
+    EXPECT_TRUE(OUT.isEmpty());
+    EXPECT_EQ(actionCalls, 0);
+
+    // Once the loop runs again, the rest of ESTOP happens, only once
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(actionCalls, 1);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x01, 0xC3, 0x7F);
+    SYSTIME = 1000;
+    RCP::checkHeartbeat();
+    RCP::yield();
+    EXPECT_EQ(RCP::getEstopStats().watchdogTrips, 1u);
+    EXPECT_EQ(actionCalls, 1);
+
+    RCP::ESTOP_ACTION = nullptr;
+    RCP::ESTOP_ISR_ACTION = nullptr;
+}
+
 TEST_F(RCPPromptTest, PromptString) {
     RCP::setPrompt("HELLO", RCP_PromptDataType_GONOGO, &pacceptor);
     CHECK_OUTBUF(0x06, RCP_DEVCLASS_PROMPT, 0x00, HELLOHEX);
@@ -409,6 +662,147 @@ TEST_F(RCPSimpleActuators, ActuatorWritePaused) {
     EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
 }
 
+static bool valveClosedAtEnd;
+
+// Records whether actuator 0 was already closed when the running test was ended by ESTOP
+class EndRecorder : public ::Test::Procedure {
+public:
+    void end(bool interrupted) override { valveClosedAtEnd = ACTS[0] == RCP_SIMPLE_ACTUATOR_OFF; }
+    bool isFinished() override { return false; }
+};
+
+TEST_F(RCPSimpleActuators, EstopAction) {
+    EndRecorder recorder;
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &recorder;
+    ACTS[0] = RCP_SIMPLE_ACTUATOR_ON;
+    valveClosedAtEnd = false;
+
+    RCP::ESTOP_ACTION = [] { RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_OFF); };
+    RCP::startProcedure(1);
+    RCP::runTest();
+    SYSTIME = 7;
+    RCP::ESTOP();
+
+    EXPECT_TRUE(valveClosedAtEnd);
+    EXPECT_EQ(RCP::getEstopStats().lastActuationMicros, 0u);
+
+    RCP::ESTOP_ACTION = nullptr;
+    ::Test::getTests().tests[1] = previous;
+}
+
+static void closeValve() { RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_OFF); }
+static void openValve() { RCP::writeSimpleActuator(1, RCP_SIMPLE_ACTUATOR_ON); }
+
+TEST_F(RCPSimpleActuators, EstopProcedure) {
+    // The sequence specific ESTOP procedure is used even though ending the wrapper restores the default one
+    ::Test::OneShot sequenceEstop(&closeValve);
+    ::Test::OneShot defaultEstop(&openValve);
+    ::Test::EStopSetterWrapper wrapper(new EndRecorder(), &sequenceEstop, &defaultEstop);
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &wrapper;
+    RCP::ESTOP_PROC = &defaultEstop;
+    ACTS[0] = RCP_SIMPLE_ACTUATOR_ON;
+    ACTS[1] = RCP_SIMPLE_ACTUATOR_OFF;
+
+    RCP::startProcedure(1);
+    RCP::runTest();
+    SYSTIME = 3;
+    RCP::ESTOP();
+
+    // Initialized inside ESTOP(), without waiting for runTest()
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(ACTS[1], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(RCP::ESTOP_PROC, &defaultEstop);
+    EXPECT_EQ(RCP::getEstopStats().maxActuationMicros, 0u);
+
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    RCP::ESTOP_PROC = nullptr;
+    ::Test::getTests().tests[1] = previous;
+}
+
+// Calls ESTOP() from inside execute(), like a redline tripped by a sensor read would
+class EstopFromExecute : public ::Test::Procedure {
+public:
+    int ends = 0;
+
+    void execute() override { RCP::ESTOP(); }
+    void end(bool interrupted) override { ends++; }
+    bool isFinished() override { return true; }
+};
+
+TEST_F(RCPSimpleActuators, EstopFromProcedure) {
+    EstopFromExecute proc;
+    ::Test::OneShot estop(&closeValve);
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &proc;
+    RCP::ESTOP_PROC = &estop;
+    ACTS[0] = RCP_SIMPLE_ACTUATOR_ON;
+
+    RCP::startProcedure(1);
+    RCP::runTest();
+    // Ended once by the ESTOP, not again as finished, and the ESTOP state is what the host last saw
+    EXPECT_EQ(proc.ends, 1);
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(ACTS[0], RCP_SIMPLE_ACTUATOR_OFF);
+    CHECK_OUTBUF(0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x00, RCP_SIMPLE_ACTUATOR_OFF);
+    CHECK_OUTBUF(0x05, RCP_DEVCLASS_TEST_STATE, 0x00, 0x00, 0x00, 0x00, 0x70);
+    EXPECT_TRUE(OUT.isEmpty());
+
+    // The ESTOP sequence then finishes normally
+    RCP::runTest();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+
+    RCP::ESTOP_PROC = nullptr;
+    ::Test::getTests().tests[1] = previous;
+}
+
+TEST_F(RCPSimpleActuators, EstopLatency) {
+    ::Test::SequentialProcedure estop(new ::Test::WaitProcedure(5), new ::Test::OneShot(&closeValve));
+    RCP::ESTOP_PROC = &estop;
+
+    SYSTIME = 10;
+    RCP::ESTOP();
+    while(RCP::getTestState() == RCP_TEST_ESTOP && SYSTIME < 100) {
+        SYSTIME++;
+        RCP::runTest();
+    }
+
+    EXPECT_EQ(RCP::getEstopStats().lastActuationMicros, 6000u);
+    EXPECT_EQ(RCP::getEstopStats().maxActuationMicros, 6000u);
+
+    RCP::ESTOP_PROC = nullptr;
+}
+
+TEST_F(RCPSimpleActuators, EstopWithoutWrite) {
+    // No ESTOP_ACTION nor ESTOP_PROC
+    SYSTIME = 10;
+    RCP::ESTOP();
+    SYSTIME = 5000;
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::getEstopStats().lastActuationMicros, 0u);
+    EXPECT_EQ(RCP::getEstopStats().maxActuationMicros, 0u);
+
+    // An ESTOP_PROC that writes nothing
+    RCP::init();
+    ::Test::WaitProcedure estop(5);
+    RCP::ESTOP_PROC = &estop;
+    RCP::ESTOP();
+    while(RCP::getTestState() == RCP_TEST_ESTOP && SYSTIME < 6000) {
+        SYSTIME++;
+        RCP::runTest();
+    }
+
+    SYSTIME = 9000;
+    RCP::writeSimpleActuator(0, RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_EQ(RCP::getEstopStats().lastActuationMicros, 0u);
+    EXPECT_EQ(RCP::getEstopStats().maxActuationMicros, 0u);
+
+    RCP::ESTOP_PROC = nullptr;
+}
+
 TEST_F(RCPSteppers, StepperRead) {
     STEPS[0][0] = PI;
     STEPS[0][1] = PI2;
@@ -0,0 +1,127 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/diagnostics.h"
+#include "RCP_Target/trace.h"
+
+#if RCPT_TRACE
+
+static int hookCalls = 0;
+
+namespace RCP {
+    void traceHook([[maybe_unused]] RCP_TraceEventType type, [[maybe_unused]] uint8_t arg,
+                   [[maybe_unused]] uint16_t data) {
+        hookCalls++;
+    }
+} // namespace RCP
+
+// Runs until it is stopped
+class Forever : public ::Test::Procedure {
+public:
+    bool isFinished() override { return false; }
+};
+
+class RCPTrace : public RCPTest {
+protected:
+    RCPTrace() {
+        RCP::clearTrace();
+        hookCalls = 0;
+    }
+};
+
+#define EXPECT_EVENT(index, etype, earg, edata)                                                                        \
+    do {                                                                                                               \
+        RCP::TraceEvent event{};                                                                                       \
+        EXPECT_TRUE(RCP::getTraceEvent(index, event));                                                                 \
+        EXPECT_EQ(event.type, etype);                                                                                  \
+        EXPECT_EQ(event.arg, earg);                                                                                    \
+        EXPECT_EQ(event.data, edata);                                                                                  \
+    }                                                                                                                  \
+    while(0)
+
+TEST_F(RCPTrace, Packets) {
+    SYSTIME = 5;
+    PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    RCP::yield();
+
+    EXPECT_EQ(RCP::getTraceCount(), 3);
+    EXPECT_EVENT(0, RCP::RCP_TRACE_RX, RCP_DEVCLASS_TEST_STATE, 1);
+    EXPECT_EVENT(1, RCP::RCP_TRACE_TX, RCP_DEVCLASS_TEST_STATE, 7);
+    EXPECT_EVENT(2, RCP::RCP_TRACE_DISPATCHED, RCP_DEVCLASS_TEST_STATE, 0);
+    EXPECT_EQ(hookCalls, 3);
+
+    RCP::TraceEvent event{};
+    RCP::getTraceEvent(0, event);
+    EXPECT_EQ(event.time, 5000u);
+    EXPECT_FALSE(RCP::getTraceEvent(3, event));
+}
+
+TEST_F(RCPTrace, Procedures) {
+    Forever forever;
+    ::Test::Procedure* previous = ::Test::getTests()[1];
+    ::Test::getTests().tests[1] = &forever;
+
+    RCP::startProcedure(1);
+    RCP::runTest();
+    RCP::stopProcedure(1);
+    ::Test::getTests().tests[1] = previous;
+    PUSH(0x00);
+    RCP::yield();
+
+    EXPECT_EVENT(0, RCP::RCP_TRACE_PROC_INIT, 0, 1);
+    EXPECT_EVENT(1, RCP::RCP_TRACE_PROC_END, 0, 1);
+    EXPECT_EVENT(2, RCP::RCP_TRACE_TX, RCP_DEVCLASS_TEST_STATE, 7);
+    EXPECT_EVENT(3, RCP::RCP_TRACE_ESTOP, 0, 0);
+}
+
+TEST_F(RCPTrace, Wraps) {
+    for(int i = 0; i < RCP::TRACE_EVENTS + 5; i++) RCP::sendOneFloat(RCP_DEVCLASS_TEMPERATURE, 0, i);
+    OUT.clear();
+
+    EXPECT_EQ(RCP::getTraceCount(), RCP::TRACE_EVENTS);
+    RCP::TraceEvent first{};
+    RCP::TraceEvent last{};
+    RCP::getTraceEvent(0, first);
+    RCP::getTraceEvent(RCP::TRACE_EVENTS - 1, last);
+    EXPECT_EQ(first.type, RCP::RCP_TRACE_TX);
+    EXPECT_EQ(last.type, RCP::RCP_TRACE_TX);
+}
+
+TEST_F(RCPTrace, Dump) {
+    SYSTIME = 1;
+    for(int i = 0; i < 7; i++) RCP::sendOneFloat(RCP_DEVCLASS_TEMPERATURE, 0, i);
+    OUT.clear();
+
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE};
+    EXPECT_TRUE(RCP::handleDiagnostics(request, sizeof(request)));
+
+    // Seven events fill a packet, then an empty packet ends the dump
+    EXPECT_EQ(OUT.size(), 64);
+    CHECK_OUTBUF(58, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE, 0x00, 0x00, 0x03, 0xE8,
+                 RCP::RCP_TRACE_TX, RCP_DEVCLASS_TEMPERATURE, 0x00, 11);
+    uint8_t skipped;
+    for(int i = 0; i < 6 * 8; i++) OUT.pop(skipped);
+    CHECK_OUTBUF(2, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE);
+
+    // The dump itself was not recorded
+    EXPECT_EQ(RCP::getTraceCount(), 7);
+}
+
+TEST_F(RCPTrace, PartialDump) {
+    SYSTIME = 2;
+    RCP::sendOneFloat(RCP_DEVCLASS_TEMPERATURE, 3, 0);
+    OUT.clear();
+
+    const uint8_t request[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE};
+    RCP::handleDiagnostics(request, sizeof(request));
+    CHECK_OUTBUF(10, RCP_DEVCLASS_CUSTOM, RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE, 0x00, 0x00, 0x07, 0xD0,
+                 RCP::RCP_TRACE_TX, RCP_DEVCLASS_TEMPERATURE, 0x00, 11, 2, RCP_DEVCLASS_CUSTOM,
+                 RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_TRACE);
+
+    // Reset clears the trace
+    const uint8_t reset[] = {RCP::DIAGNOSTICS_MAGIC, RCP::RCP_DIAG_RESET};
+    RCP::handleDiagnostics(reset, sizeof(reset));
+    EXPECT_EQ(RCP::getTraceCount(), 1);
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/transports.h"
+
+#if RCPT_TRANSPORTS
+
+// A second link next to the IN/OUT hooks
+static LRI::RingBuf<uint8_t, 65> radioIn;
+static LRI::RingBuf<uint8_t, 256> radioOut;
+
+static void radioWrite(const void* data, uint8_t length) {
+    for(uint8_t i = 0; i < length; i++) radioOut.push(static_cast<const uint8_t*>(data)[i]);
+}
+
+static uint8_t radioAvailable() { return radioIn.size(); }
+
+static uint8_t radioRead() {
+    uint8_t val = 0;
+    radioIn.pop(val);
+    return val;
+}
+
+#define RADIO_PUSH(...)                                                                                                \
+    do {                                                                                                               \
+        uint8_t vals[] = {__VA_ARGS__};                                                                                \
+        for(size_t i = 0; i < sizeof(vals); i++) radioIn.push(vals[i]);                                                \
+    }                                                                                                                  \
+    while(0)
+
+class RCPTransports : public RCPSimpleActuators {
+protected:
+    uint8_t radio;
+
+    RCPTransports() {
+        radioIn.clear();
+        radioOut.clear();
+        radio = RCP::addTransport({radioWrite, radioAvailable, radioRead});
+    }
+
+    ~RCPTransports() override {
+        RCP::setTelemetryPolicy(0, {});
+        RCP::removeTransports();
+    }
+
+    // Pops a whole packet from the radio output and returns its device class
+    static uint8_t popRadioPacket() {
+        uint8_t head = 0;
+        uint8_t devclass = 0;
+        uint8_t payload = 0;
+        radioOut.pop(head);
+        radioOut.pop(devclass);
+        for(int i = 0; i < (head & ~RCP_CHANNEL_MASK); i++) radioOut.pop(payload);
+        return devclass;
+    }
+};
+
+TEST_F(RCPTransports, Added) {
+    EXPECT_EQ(radio, 1);
+    EXPECT_EQ(RCP::getTransportCount(), 2);
+    EXPECT_EQ(RCP::addTransport({radioWrite, radioAvailable, radioRead}), 2);
+    // Only RCPT_TRANSPORTS fit
+    for(int i = 2; i < RCPT_TRANSPORTS; i++) RCP::addTransport({radioWrite, radioAvailable, radioRead});
+    EXPECT_EQ(RCP::addTransport({radioWrite, radioAvailable, radioRead}), 0);
+    EXPECT_EQ(RCP::getTransportCount(), RCPT_TRANSPORTS + 1);
+}
+
+TEST_F(RCPTransports, FanOut) {
+    uint32_t before = RCP::getTransportStats(0).txPackets;
+    RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 3, PI);
+    CHECK_OUTBUF(0x09, RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0x00, 0x00, 0x00, 0x00, 0x03, HFLOATARR(HPI));
+    ASSERT_EQ(radioOut.size(), 11u);
+    EXPECT_EQ(popRadioPacket(), RCP_DEVCLASS_PRESSURE_TRANSDUCER);
+
+    EXPECT_EQ(RCP::getTransportStats(0).txPackets - before, 1u);
+    EXPECT_EQ(RCP::getTransportStats(radio).txPackets, 1u);
+    EXPECT_EQ(RCP::getTransportStats(radio).txBytes, 11u);
+}
+
+TEST_F(RCPTransports, CommandFromAddedLink) {
+    RADIO_PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_ON);
+
+    // The new state goes to every host
+    CHECK_OUTBUF(0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(radioOut.size(), 8u);
+    EXPECT_EQ(RCP::getTransportStats(radio).rxPackets, 1u);
+    EXPECT_EQ(RCP::getTransportStats(radio).rxBytes, 4u);
+}
+
+TEST_F(RCPTransports, SeparateParsers) {
+    // Both links have half a packet pending at the same time
+    PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR);
+    RADIO_PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x07);
+    RCP::yield();
+    PUSH(0x06, RCP_SIMPLE_ACTUATOR_ON);
+    RADIO_PUSH(RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    RCP::yield();
+
+    EXPECT_EQ(ACTS[6], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(ACTS[7], RCP_SIMPLE_ACTUATOR_ON);
+}
+
+TEST_F(RCPTransports, EstopFromAddedLink) {
+    RADIO_PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON, 0x00);
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+    EXPECT_EQ(RCP::getTransportStats(radio).rxPackets, 2u);
+}
+
+TEST_F(RCPTransports, HeartbeatFromAddedLink) {
+    PUSH(0x03, RCP_DEVCLASS_TEST_STATE, RCP_HEARTBEATS_CONTROL, 0x00, 0xFA);
+    RCP::yield();
+    SYSTIME = 200;
+    RADIO_PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_HEARTBEATS_CONTROL | 0x0F);
+    RCP::yield();
+    SYSTIME = 400;
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_STOPPED);
+    SYSTIME = 451;
+    RCP::yield();
+    EXPECT_EQ(RCP::getTestState(), RCP_TEST_ESTOP);
+}
+
+TEST_F(RCPTransports, Decimation) {
+    RCP::setTelemetryPolicy(radio, {3, 0});
+    uint32_t before = RCP::getTransportStats(0).txPackets;
+    // Two sensors interleaved, so a shared count would always drop the same one
+    for(int i = 0; i < 6; i++) {
+        RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 1, PI);
+        RCP::sendOneFloat(RCP_DEVCLASS_TEMPERATURE, 2, PI);
+    }
+
+    EXPECT_EQ(RCP::getTransportStats(0).txPackets - before, 12u);
+    ASSERT_EQ(radioOut.size(), 4u * 11);
+    EXPECT_EQ(popRadioPacket(), RCP_DEVCLASS_PRESSURE_TRANSDUCER);
+    EXPECT_EQ(popRadioPacket(), RCP_DEVCLASS_TEMPERATURE);
+    EXPECT_EQ(popRadioPacket(), RCP_DEVCLASS_PRESSURE_TRANSDUCER);
+    EXPECT_EQ(popRadioPacket(), RCP_DEVCLASS_TEMPERATURE);
+    EXPECT_EQ(RCP::getTransportStats(radio).decimated, 8u);
+    EXPECT_EQ(RCP::getTransportStats(0).decimated, 0u);
+}
+
+TEST_F(RCPTransports, ControlNotDecimated) {
+    RCP::setTelemetryPolicy(radio, {4, 100});
+    for(int i = 0; i < 4; i++) RCP::writeSimpleActuator(1, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::sendTestState();
+    EXPECT_EQ(radioOut.size(), 4u * 8 + 7);
+    EXPECT_EQ(RCP::getTransportStats(radio).decimated, 0u);
+    EXPECT_EQ(RCP::getTransportStats(radio).rateLimited, 0u);
+}
+
+TEST_F(RCPTransports, RateLimit) {
+    // 100 bytes of credit, refilled at one byte per ms
+    RCP::setTelemetryPolicy(radio, {0, 1000});
+    uint32_t before = RCP::getTransportStats(0).txPackets;
+    for(int i = 0; i < 20; i++) RCP::sendOneFloat(RCP_DEVCLASS_LOAD_CELL, 1, PI);
+    EXPECT_EQ(radioOut.size(), 9u * 11);
+    EXPECT_EQ(RCP::getTransportStats(radio).rateLimited, 11u);
+    EXPECT_EQ(RCP::getTransportStats(0).txPackets - before, 20u);
+    radioOut.clear();
+
+    SYSTIME += 50;
+    for(int i = 0; i < 20; i++) RCP::sendOneFloat(RCP_DEVCLASS_LOAD_CELL, 1, PI);
+    EXPECT_EQ(radioOut.size(), 4u * 11);
+    radioOut.clear();
+
+    // Idle time only refills up to the burst
+    SYSTIME += 10000;
+    for(int i = 0; i < 20; i++) RCP::sendOneFloat(RCP_DEVCLASS_LOAD_CELL, 1, PI);
+    EXPECT_EQ(radioOut.size(), 9u * 11);
+}
+
+TEST_F(RCPTransports, Framed) {
+    RCP::setFraming(RCP_FRAMING_COBS, radio);
+    EXPECT_EQ(RCP::getFraming(radio), RCP_FRAMING_COBS);
+    EXPECT_EQ(RCP::getFraming(0), RCP_FRAMING_RAW);
+
+    // A stray byte before the frame only costs that frame
+    RADIO_PUSH(0x42, 0x00, 0x05, 0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON, 0x00);
+    RCP::yield();
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_ON);
+    EXPECT_EQ(RCP::getFramingStats(radio).frames, 2u);
+    EXPECT_EQ(RCP::getFramingStats(radio).badFrames, 1u);
+
+    // Raw on link 0, COBS on the radio
+    CHECK_OUTBUF(0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x00, 0x00, 0x00, 0x00, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+    const uint8_t frame[] = {0x03, 0x06, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x01, 0x01, 0x01, 0x03, 0x05,
+                             RCP_SIMPLE_ACTUATOR_ON, 0x00};
+    ASSERT_EQ(radioOut.size(), sizeof(frame));
+    for(uint8_t expected : frame) {
+        uint8_t byte = 0;
+        radioOut.pop(byte);
+        EXPECT_EQ(byte, expected);
+    }
+
+    RCP::setFraming(RCP_FRAMING_RAW, radio);
+}
+
+TEST_F(RCPTransports, Removed) {
+    RCP::removeTransports();
+    EXPECT_EQ(RCP::getTransportCount(), 1);
+    RADIO_PUSH(0x02, RCP_DEVCLASS_SIMPLE_ACTUATOR, 0x05, RCP_SIMPLE_ACTUATOR_ON);
+    RCP::yield();
+    RCP::sendTestState();
+    EXPECT_EQ(ACTS[5], RCP_SIMPLE_ACTUATOR_OFF);
+    EXPECT_TRUE(radioOut.isEmpty());
+    EXPECT_EQ(OUT.size(), 7u);
+}
+
+#endif
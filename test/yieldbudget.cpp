@@ -0,0 +1,55 @@
+#include "fixtures.h"
+#include "gtest/gtest.h"
+
+#include "RCP_Target/stats.h"
+
+// Queries for this target's test state, each answered with a 7 byte packet
+static void pushQueries(int count) {
+    for(int i = 0; i < count; i++) PUSH(0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+}
+
+class RCPYieldBudget : public RCPTest {
+protected:
+    ~RCPYieldBudget() override { RCP::setCaptureTap(nullptr); }
+};
+
+TEST_F(RCPYieldBudget, DrainsInput) {
+    pushQueries(5);
+    EXPECT_FALSE(RCP::yield(1000));
+    EXPECT_EQ(OUT.size(), 35u);
+    EXPECT_TRUE(IN.isEmpty());
+    EXPECT_EQ(RCP::rxBuffered(), 0u);
+}
+
+TEST_F(RCPYieldBudget, StopsAtBudget) {
+    // Every packet sent takes a millisecond
+    RCP::setCaptureTap([](bool transmit, const void*, uint8_t) {
+        if(transmit) SYSTIME++;
+    });
+
+    pushQueries(5);
+    EXPECT_TRUE(RCP::yield(2500));
+    EXPECT_EQ(OUT.size(), 21u);
+
+    EXPECT_FALSE(RCP::yield(2500));
+    EXPECT_EQ(OUT.size(), 35u);
+}
+
+TEST_F(RCPYieldBudget, ZeroBudget) {
+    pushQueries(3);
+    RCP::yield(0);
+    EXPECT_EQ(OUT.size(), 7u);
+}
+
+TEST_F(RCPYieldBudget, MoreThanOneRead) {
+    // More packets than one read of SERIAL_BYTES_PER_LOOP holds, for other channels so nothing is sent
+    while(IN.size() + 3 <= 65) PUSH(RCP_CH_ONE | 0x01, RCP_DEVCLASS_TEST_STATE, RCP_TEST_QUERY);
+    EXPECT_FALSE(RCP::yield(1000));
+    EXPECT_TRUE(IN.isEmpty());
+    EXPECT_EQ(RCP::rxBuffered(), 0u);
+    EXPECT_TRUE(OUT.isEmpty());
+#if RCPT_STATS
+    EXPECT_EQ(RCP::getRuntimeStats().rxPackets, 21u);
+    EXPECT_EQ(RCP::getRuntimeStats().rxDropped, 0u);
+#endif
+}
@@ -0,0 +1,60 @@
+/*
+ * Reference firmware for the RCPT_Footprint target (see cmake/footprint.cmake). It is a stand-in for a typical board:
+ * hooks backed by memory mapped registers so nothing is optimized away, a main loop of yield() and runTest(), and
+ * telemetry for whichever sensor classes are enabled. Only the library's own size should change between
+ * configurations, so keep this small.
+ */
+#include "RCP_Target/RCP_Target.h"
+
+static volatile uint8_t* const UART_DATA = reinterpret_cast<volatile uint8_t*>(0x40000000);
+static volatile uint8_t* const UART_AVAIL = reinterpret_cast<volatile uint8_t*>(0x40000004);
+static volatile uint32_t* const TIMER = reinterpret_cast<volatile uint32_t*>(0x40000008);
+static volatile uint8_t* const GPIO = reinterpret_cast<volatile uint8_t*>(0x40000010);
+
+namespace RCP {
+    void write(const void* data, uint8_t length) {
+        for(uint8_t i = 0; i < length; i++) *UART_DATA = static_cast<const uint8_t*>(data)[i];
+    }
+
+    uint8_t readAvail() { return *UART_AVAIL; }
+    uint8_t read() { return *UART_DATA; }
+    uint32_t systime() { return *TIMER; }
+
+#if RCPT_SIMPLE_ACTUATORS
+    RCP_SimpleActuatorState readSimpleActuator(uint8_t id) {
+        return GPIO[id] ? RCP_SIMPLE_ACTUATOR_ON : RCP_SIMPLE_ACTUATOR_OFF;
+    }
+
+    RCP_SimpleActuatorState simpleActuatorWrite_CLBK(uint8_t id, RCP_SimpleActuatorState state) {
+        GPIO[id] = state == RCP_SIMPLE_ACTUATOR_ON;
+        return state;
+    }
+#endif
+
+    Floats4 readSensor([[maybe_unused]] RCP_DeviceClass devclass, uint8_t id) {
+        return {{static_cast<float>(GPIO[id]), 0, 0, 0}};
+    }
+} // namespace RCP
+
+int main() {
+    RCP::init();
+    RCP::setReady(true);
+    uint32_t lastSend = 0;
+
+    while(true) {
+        RCP::yield();
+#if RCPT_PROCEDURES
+        RCP::runTest();
+#endif
+
+        if(!RCP::getDataStreaming() || RCP::millis() - lastSend < 10) continue;
+        lastSend = RCP::millis();
+#if RCPT_SEND_ONE_FLOAT
+        float pressure = RCP::readSensor(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0).vals[0];
+        RCP::sendOneFloat(RCP_DEVCLASS_PRESSURE_TRANSDUCER, 0, pressure);
+#endif
+#if RCPT_SEND_FOUR_FLOAT
+        RCP::sendFourFloat(RCP_DEVCLASS_GPS, 0, RCP::readSensor(RCP_DEVCLASS_GPS, 0));
+#endif
+    }
+}
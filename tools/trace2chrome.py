@@ -0,0 +1,134 @@
+"""
+Converts an RCP event trace dump into Chrome trace JSON, for chrome://tracing or https://ui.perfetto.dev.
+
+The input is the raw byte stream received from the target while it answered an RCP_DIAG_TRACE diagnostics request
+(see src/RCP_Target/trace.h). Other packets in the stream are skipped. If it contains several dumps, the last complete
+one is used.
+
+    python3 tools/trace2chrome.py capture.bin trace.json [--ticks-per-us N]
+
+Use --ticks-per-us when the target's traceTimestamp() counts cycles instead of microseconds.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+DEVCLASS_CUSTOM = 0x80
+DIAGNOSTICS_MAGIC = 0xD1
+DIAG_TRACE = 0x06
+
+TRACE_RX = 0x01
+TRACE_DISPATCHED = 0x02
+TRACE_TX = 0x03
+TRACE_PROC_INIT = 0x04
+TRACE_PROC_END = 0x05
+TRACE_ESTOP = 0x06
+TRACE_HEARTBEAT = 0x07
+TRACE_HEARTBEAT_TIMEOUT = 0x08
+
+DEVCLASSES = {
+    0x00: "TEST_STATE", 0x01: "SIMPLE_ACTUATOR", 0x02: "STEPPER", 0x03: "PROMPT", 0x04: "ANGLED_ACTUATOR",
+    0x05: "MOTOR", 0x06: "DISCRETE_ACTUATOR", 0x80: "CUSTOM", 0x90: "AM_PRESSURE", 0x91: "TEMPERATURE",
+    0x92: "PRESSURE_TRANSDUCER", 0x93: "RELATIVE_HYGROMETER", 0x94: "LOAD_CELL", 0x95: "BOOL_SENSOR",
+    0x96: "FLOW_METER", 0x97: "ALTITUDE", 0x98: "RADIO_STRENGTH", 0xA0: "POWERMON", 0xB0: "ACCELEROMETER",
+    0xB1: "GYROSCOPE", 0xB2: "MAGNETOMETER", 0xB3: "RPY", 0xC0: "GPS", 0xC1: "QUATERNION",
+}
+
+
+def packets(stream):
+    pos = 0
+    while pos < len(stream):
+        length = stream[pos] & 0x3F
+        # ESTOP packets are a lone header
+        if length == 0:
+            pos += 1
+            continue
+
+        if pos + length + 2 > len(stream):
+            return
+        yield stream[pos + 1], stream[pos + 2:pos + length + 2]
+        pos += length + 2
+
+
+def read_dump(stream):
+    dump = None
+    current = []
+    for devclass, payload in packets(stream):
+        if devclass != DEVCLASS_CUSTOM or len(payload) < 2:
+            continue
+        if payload[0] != DIAGNOSTICS_MAGIC or payload[1] != DIAG_TRACE:
+            continue
+
+        if len(payload) == 2:
+            dump = current
+            current = []
+            continue
+
+        for i in range(2, len(payload) - 7, 8):
+            current.append(struct.unpack(">IBBH", payload[i:i + 8]))
+
+    return dump
+
+
+def devclass_name(devclass):
+    return DEVCLASSES.get(devclass, "0x%02X" % devclass)
+
+
+def to_chrome(events, ticks_per_us):
+    out = []
+    base = events[0][0] if events else 0
+    time = 0
+    last = base
+    for stamp, kind, arg, data in events:
+        # Timestamps are 32 bits and may wrap during the trace
+        time += (stamp - last) & 0xFFFFFFFF
+        last = stamp
+        event = {"ts": time / ticks_per_us, "pid": 0}
+
+        if kind == TRACE_RX:
+            event.update(name="rx " + devclass_name(arg), ph="B", tid="packets", args={"length": data})
+        elif kind == TRACE_DISPATCHED:
+            event.update(name="rx " + devclass_name(arg), ph="E", tid="packets")
+        elif kind == TRACE_TX:
+            event.update(name="tx " + devclass_name(arg), ph="i", s="t", tid="tx", args={"length": data})
+        elif kind == TRACE_PROC_INIT:
+            event.update(name="test %d" % data, ph="B", tid="slot %d" % arg)
+        elif kind == TRACE_PROC_END:
+            event.update(ph="E", tid="slot %d" % arg, args={"interrupted": bool(data)})
+        elif kind == TRACE_ESTOP:
+            event.update(name="ESTOP", ph="i", s="g")
+        elif kind == TRACE_HEARTBEAT:
+            event.update(name="heartbeat", ph="i", s="t", tid="heartbeat")
+        elif kind == TRACE_HEARTBEAT_TIMEOUT:
+            event.update(name="heartbeat timeout", ph="i", s="g")
+        else:
+            event.update(name="unknown 0x%02X" % kind, ph="i", s="t", tid="unknown", args={"arg": arg, "data": data})
+
+        out.append(event)
+
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert an RCP trace dump to Chrome trace JSON")
+    parser.add_argument("input", help="raw bytes received from the target")
+    parser.add_argument("output", help="Chrome trace JSON file to write")
+    parser.add_argument("--ticks-per-us", type=float, default=1.0, help="traceTimestamp() ticks per microsecond")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as file:
+        dump = read_dump(file.read())
+
+    if dump is None:
+        sys.exit("No complete trace dump found in " + args.input)
+
+    with open(args.output, "w") as file:
+        json.dump(to_chrome(dump, args.ticks_per_us), file, indent=1)
+
+    print("Converted %d events" % len(dump))
+
+
+if __name__ == "__main__":
+    main()